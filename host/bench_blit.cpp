@@ -0,0 +1,127 @@
+/****************************************************************
+ * Times drawing whole frames with the blits against drawing the same
+ * frames a pixel at a time, on the host. The absolute times say little
+ * about the ESP32, the ratio is what the blits are for
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "PxMatrix.h"
+#include "sim.h"
+
+// Frames drawn for every timing
+#define FRAMES 200
+
+struct layout {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+   scan_patterns scan;
+};
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static PxMatrix *start(const layout &l)
+{
+   sim_reset();
+   PxMatrix *matrix = new PxMatrix(l.width, l.height, 26, 21, 27, 17, 25, 5, 15);
+   matrix->setScanPattern(l.scan);
+   matrix->begin(l.row_pattern, BCM);
+   matrix->swapBuffer();
+   return matrix;
+}
+
+// Nanoseconds a pixel takes, best of three runs of FRAMES frames
+static double time_frames(PxMatrix *matrix, void (*draw)(PxMatrix *matrix, const void *data), const void *data)
+{
+   uint64_t best = UINT64_MAX;
+
+   for (uint8_t run = 0; run < 3; run++)
+   {
+      uint64_t start = now_ns();
+      for (uint16_t frame = 0; frame < FRAMES; frame++)
+         draw(matrix, data);
+      uint64_t took = now_ns() - start;
+      if (took < best)
+         best = took;
+   }
+   return (double)best / ((double)FRAMES * matrix->width() * matrix->height());
+}
+
+static void blit_rgb888(PxMatrix *matrix, const void *data)
+{
+   matrix->drawFrameRGB888((const uint8_t *)data, matrix->width());
+}
+
+static void pixels_rgb888(PxMatrix *matrix, const void *data)
+{
+   const uint8_t *rgb = (const uint8_t *)data;
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++, rgb += 3)
+         matrix->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+   }
+}
+
+static void blit_rgb565(PxMatrix *matrix, const void *data)
+{
+   matrix->drawFrameRGB565((const uint16_t *)data, matrix->width());
+}
+
+static void pixels_rgb565(PxMatrix *matrix, const void *data)
+{
+   const uint16_t *color = (const uint16_t *)data;
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++, color++)
+         matrix->drawPixelRGB565(x, y, *color);
+   }
+}
+
+int main()
+{
+   static const layout layouts[] = {
+      {"32x16 8 ZAGGIZ", 32, 16, 8, ZAGGIZ},
+      {"64x32 16 LINE", 64, 32, 16, LINE},
+      {"64x64 32 LINE", 64, 64, 32, LINE},
+   };
+
+   printf("%-16s %-7s %12s %12s %8s\n", "layout", "format", "pixel ns/px", "blit ns/px", "speedup");
+   for (const layout &l : layouts)
+   {
+      uint32_t pixels = (uint32_t)l.width * l.height;
+      uint8_t *rgb888 = (uint8_t *)malloc(pixels * 3);
+      uint16_t *rgb565 = (uint16_t *)malloc(pixels * sizeof(uint16_t));
+
+      srand(1);
+      for (uint32_t idx = 0; idx < pixels * 3; idx++)
+         rgb888[idx] = rand();
+      for (uint32_t idx = 0; idx < pixels; idx++)
+         rgb565[idx] = rand();
+
+      PxMatrix *matrix = start(l);
+      double pixel = time_frames(matrix, pixels_rgb888, rgb888);
+      double blit = time_frames(matrix, blit_rgb888, rgb888);
+      printf("%-16s %-7s %12.1f %12.1f %7.2fx\n", l.name, "RGB888", pixel, blit, pixel / blit);
+
+      pixel = time_frames(matrix, pixels_rgb565, rgb565);
+      blit = time_frames(matrix, blit_rgb565, rgb565);
+      printf("%-16s %-7s %12.1f %12.1f %7.2fx\n", l.name, "RGB565", pixel, blit, pixel / blit);
+
+      delete matrix;
+      free(rgb888);
+      free(rgb565);
+   }
+
+   return 0;
+}
@@ -0,0 +1,119 @@
+/****************************************************************
+ * Times encoding frames with PxMatrixT against PxMatrix set up the same
+ * way, on the host, by pixel and by blit. The absolute times say little
+ * about the ESP32, the ratio is what the fixed geometry is for
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "PxMatrix.h"
+#include "PxMatrixT.h"
+#include "sim.h"
+
+// Frames drawn for every timing
+#define FRAMES 200
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// Nanoseconds a pixel takes, best of three runs of FRAMES frames
+static double time_frames(PxMatrix *matrix, void (*draw)(PxMatrix *matrix, const void *data), const void *data)
+{
+   uint64_t best = UINT64_MAX;
+
+   for (uint8_t run = 0; run < 3; run++)
+   {
+      uint64_t start = now_ns();
+      for (uint16_t frame = 0; frame < FRAMES; frame++)
+         draw(matrix, data);
+      uint64_t took = now_ns() - start;
+      if (took < best)
+         best = took;
+   }
+   return (double)best / ((double)FRAMES * matrix->width() * matrix->height());
+}
+
+static void pixels_rgb888(PxMatrix *matrix, const void *data)
+{
+   const uint8_t *rgb = (const uint8_t *)data;
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++, rgb += 3)
+         matrix->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+   }
+}
+
+static void blit_rgb888(PxMatrix *matrix, const void *data)
+{
+   matrix->drawFrameRGB888((const uint8_t *)data, matrix->width());
+}
+
+static void blit_rgb565(PxMatrix *matrix, const void *data)
+{
+   matrix->drawFrameRGB565((const uint16_t *)data, matrix->width());
+}
+
+template <uint16_t W, uint16_t H, uint8_t RowPattern, scan_patterns Scan>
+static void bench(const char *name)
+{
+   static const struct {
+      const char *name;
+      void (*draw)(PxMatrix *matrix, const void *data);
+      bool rgb565;
+   } routes[] = {
+      {"pixels", pixels_rgb888, false},
+      {"RGB888", blit_rgb888, false},
+      {"RGB565", blit_rgb565, true},
+   };
+
+   uint32_t pixels = (uint32_t)W * H;
+   uint8_t *rgb888 = (uint8_t *)malloc(pixels * 3);
+   uint16_t *rgb565 = (uint16_t *)malloc(pixels * sizeof(uint16_t));
+
+   srand(1);
+   for (uint32_t idx = 0; idx < pixels * 3; idx++)
+      rgb888[idx] = rand();
+   for (uint32_t idx = 0; idx < pixels; idx++)
+      rgb565[idx] = rand();
+
+   sim_reset();
+   PxMatrix *plain = new PxMatrix(W, H, 26, 21, 27, 17, 25, 5, 15);
+   plain->begin(RowPattern, BCM);
+   plain->setScanPattern(Scan);
+   PxMatrixT<W, H, RowPattern, Scan> *fixed = new PxMatrixT<W, H, RowPattern, Scan>(26, 21, 27, 17, 25, 5, 15);
+   fixed->begin(BCM);
+
+   for (const auto &route : routes)
+   {
+      const void *data = route.rgb565 ? (const void *)rgb565 : (const void *)rgb888;
+      double compiled = time_frames(fixed, route.draw, data);
+      double runtime = time_frames(plain, route.draw, data);
+      printf("%-16s %-7s %12.1f %12.1f %7.2fx\n", name, route.name, runtime, compiled, runtime / compiled);
+   }
+
+   delete plain;
+   delete fixed;
+   free(rgb888);
+   free(rgb565);
+}
+
+int main()
+{
+   printf("%-16s %-7s %12s %12s %8s\n", "layout", "route", "PxMatrix", "PxMatrixT", "speedup");
+   bench<32, 16, 8, LINE>("32x16 8 LINE");
+   bench<32, 16, 8, ZAGGIZ>("32x16 8 ZAGGIZ");
+   bench<32, 16, 4, ZIGZAG>("32x16 4 ZIGZAG");
+   bench<64, 32, 16, LINE>("64x32 16 LINE");
+   bench<64, 32, 16, ZIGZAG>("64x32 16 ZIGZAG");
+   bench<64, 64, 32, LINE>("64x64 32 LINE");
+
+   return 0;
+}
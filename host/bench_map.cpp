@@ -0,0 +1,119 @@
+/****************************************************************
+ * Times finding where pixels land with the pixel map against working it
+ * out with compute_pixel, on the host, and prints what the map costs in
+ * memory for every geometry. The absolute times say little about the
+ * ESP32, the ratio is what the map is for
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "PxMatrix.h"
+#include "sim.h"
+
+// Passes over the canvas for every timing
+#define PASSES 200
+
+struct layout {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+   scan_patterns scan;
+   bool rotate;
+   uint8_t tiles_x;
+};
+
+// Opens up both ways of finding a pixel
+class MapProbe : public PxMatrix {
+public:
+   using PxMatrix::PxMatrix;
+
+   uint32_t mapped(int16_t x, int16_t y)
+   {
+      return _pixel_map[(y * width()) + x];
+   }
+
+   uint32_t computed(int16_t x, int16_t y)
+   {
+      return compute_pixel(x, y);
+   }
+};
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static MapProbe *start(const layout &l)
+{
+   sim_reset();
+   MapProbe *matrix = new MapProbe(l.width, l.height, 26, 21, 27, 17, 25, 5, 15);
+   matrix->setScanPattern(l.scan);
+   matrix->begin(l.row_pattern, BCM);
+   if (l.tiles_x)
+   {
+      matrix->setTileLayout(l.tiles_x, 1, TILE_ROW_MAJOR);
+      matrix->setTileRotation(1, TILE_180);
+   }
+   matrix->setRotate(l.rotate);
+   return matrix;
+}
+
+// Whatever the entries add up to, so nothing is optimised away
+static volatile uint32_t sink;
+
+// Nanoseconds a pixel takes, best of three runs of PASSES passes
+static double time_passes(MapProbe *matrix, bool map)
+{
+   uint64_t best = UINT64_MAX;
+
+   for (uint8_t run = 0; run < 3; run++)
+   {
+      uint32_t sum = 0;
+      uint64_t start = now_ns();
+      for (uint16_t pass = 0; pass < PASSES; pass++)
+      {
+         for (int16_t y = 0; y < matrix->height(); y++)
+         {
+            for (int16_t x = 0; x < matrix->width(); x++)
+               sum += map ? matrix->mapped(x, y) : matrix->computed(x, y);
+         }
+      }
+      uint64_t took = now_ns() - start;
+      sink = sum;
+      if (took < best)
+         best = took;
+   }
+   return (double)best / ((double)PASSES * matrix->width() * matrix->height());
+}
+
+int main()
+{
+   static const layout layouts[] = {
+      {"32x16 8 ZAGGIZ", 32, 16, 8, ZAGGIZ},
+      {"32x16 4 ZIGZAG", 32, 16, 4, ZIGZAG},
+      {"64x32 16 LINE", 64, 32, 16, LINE},
+      {"64x32 16 rotated", 64, 32, 16, LINE, true},
+      {"128x32 16 2 tiles", 128, 32, 16, ZIGZAG, false, 2},
+      {"64x64 32 LINE", 64, 64, 32, LINE},
+   };
+
+   printf("%-18s %10s %14s %10s %8s\n", "layout", "map bytes", "compute ns/px", "map ns/px", "speedup");
+   for (const layout &l : layouts)
+   {
+      MapProbe *matrix = start(l);
+      double computed = time_passes(matrix, false);
+      double mapped = time_passes(matrix, true);
+      uint32_t bytes = (uint32_t)l.width * l.height * sizeof(uint32_t);
+      printf("%-18s %10u %14.2f %10.2f %7.2fx\n", l.name, bytes, computed, mapped, computed / mapped);
+      delete matrix;
+   }
+
+   return 0;
+}
@@ -0,0 +1,72 @@
+/****************************************************************
+ * Measures on the simulated clock how much of a colour cycle the task
+ * calling display() keeps the CPU busy, sending rows blocking against
+ * pipelined. Time blocked on the SPI driver or a task notification is left
+ * to other tasks, ets_delay_us and cycle counting are not
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include "PxMatrix.h"
+#include "sim.h"
+
+// Colour cycles measured, after one to settle
+#define CYCLES 20
+
+struct layout {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+   scan_patterns scan;
+};
+
+static void measure(const layout &l, output_modes output_mode, uint16_t show_time)
+{
+   sim_reset();
+   PxMatrix *matrix = new PxMatrix(l.width, l.height, 26, 21, 27, 17, 25, 5, 15);
+   matrix->setScanPattern(l.scan);
+   matrix->setOutputMode(output_mode);
+   matrix->begin(l.row_pattern, BCM);
+   matrix->fillScreen(255, 255, 255);
+
+   for (uint8_t plane = 0; plane < matrix->getColorDepth(); plane++)
+      matrix->display(show_time);
+
+   uint64_t started = sim_time_ns();
+   uint64_t blocked = sim_blocked_ns();
+   uint64_t spun = sim_spun_ns();
+   for (uint16_t plane = 0; plane < CYCLES * matrix->getColorDepth(); plane++)
+      matrix->display(show_time);
+   uint64_t elapsed = sim_time_ns() - started;
+   blocked = sim_blocked_ns() - blocked;
+   spun = sim_spun_ns() - spun;
+
+   printf("%-14s %-10s %6u %10.1f %8.1f%% %10.1f\n", l.name, (SPI_PIPELINED == output_mode) ? "pipelined" : "blocking", show_time,
+          (double)elapsed / CYCLES / 1000, 100.0 * (elapsed - blocked) / elapsed, (double)spun / CYCLES / 1000);
+   delete matrix;
+}
+
+int main()
+{
+   static const layout layouts[] = {
+      {"32x16 8", 32, 16, 8, ZAGGIZ},
+      {"64x32 16", 64, 32, 16, LINE},
+      {"64x64 32", 64, 64, 32, LINE},
+   };
+   static const uint16_t show_times[] = {10, 50, 255};
+
+   printf("%-14s %-10s %6s %10s %9s %10s\n", "layout", "output", "us", "cycle us", "busy", "spun us");
+   for (const layout &l : layouts)
+   {
+      for (uint16_t show_time : show_times)
+      {
+         measure(l, SPI_BLOCKING, show_time);
+         measure(l, SPI_PIPELINED, show_time);
+      }
+   }
+
+   return 0;
+}
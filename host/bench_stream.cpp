@@ -0,0 +1,155 @@
+/****************************************************************
+ * Prints what begin allocates for encoded buffers against streamed
+ * RGB565 frames, double and triple buffered, and times encoding a streamed
+ * row on the host against the time the row takes to shift out at 20MHz.
+ * The memory is what the ESP32 allocates, the absolute encode times say
+ * little about it
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "PxMatrix.h"
+#include "sim.h"
+
+// Colour cycles encoded for every timing
+#define CYCLES 20
+
+// Nanoseconds a bit takes to shift out on one lane
+#define SHIFT_NS_PER_BIT 50
+
+struct layout {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+};
+
+// Opens up the row encoder
+class StreamProbe : public PxMatrix {
+public:
+   using PxMatrix::PxMatrix;
+
+   void stream_row(uint8_t plane, uint8_t row, uint8_t *out)
+   {
+      encode_stream_row(plane, row, out);
+   }
+
+   size_t row_size()
+   {
+      return _send_buffer_size;
+   }
+};
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static StreamProbe *start(const layout &l, bool streaming, bool triple_buffer)
+{
+   sim_reset();
+   StreamProbe *matrix = new StreamProbe(l.width, l.height, 26, 21, 27, 17, 25, 5, 15);
+   matrix->setStreaming(streaming);
+   matrix->setTripleBuffer(triple_buffer);
+   if (!matrix->begin(l.row_pattern, BCM))
+   {
+      delete matrix;
+      return NULL;
+   }
+   return matrix;
+}
+
+static void memory(const layout &l, bool streaming, bool triple_buffer)
+{
+   pxmatrix_memory used;
+   StreamProbe *matrix = start(l, streaming, triple_buffer);
+   if (NULL == matrix)
+   {
+      printf("%-10s %-10s %-6s begin failed\n", l.name, streaming ? "streaming" : "encoded", triple_buffer ? "triple" : "double");
+      return;
+   }
+
+   matrix->getMemoryUsage(&used);
+   printf("%-10s %-10s %-6s %8u %8u %8u\n", l.name, streaming ? "streaming" : "encoded", triple_buffer ? "triple" : "double",
+          used.dma, used.other, used.dma + used.other + used.psram);
+   delete matrix;
+}
+
+// Microseconds a streamed row takes to encode, best of three runs
+static double encode_us(StreamProbe *matrix, uint8_t row_pattern)
+{
+   uint8_t *out = (uint8_t *)malloc(matrix->row_size());
+   uint8_t depth = matrix->getColorDepth();
+   uint64_t best = UINT64_MAX;
+
+   for (uint8_t run = 0; run < 3; run++)
+   {
+      uint64_t start_time = now_ns();
+      for (uint16_t cycle = 0; cycle < CYCLES; cycle++)
+      {
+         for (uint8_t plane = 0; plane < depth; plane++)
+         {
+            for (uint8_t row = 0; row < row_pattern; row++)
+               matrix->stream_row(plane, row, out);
+         }
+      }
+      uint64_t took = now_ns() - start_time;
+      if (took < best)
+         best = took;
+   }
+
+   free(out);
+   return (double)best / ((double)CYCLES * depth * row_pattern * 1000);
+}
+
+static void timing(const layout &l)
+{
+   StreamProbe *matrix = start(l, true, false);
+   if (NULL == matrix)
+      return;
+
+   srand(1);
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+         matrix->drawPixelRGB888(x, y, rand(), rand(), rand());
+   }
+
+   uint32_t row_bits = (uint32_t)l.width * l.height * 3 / l.row_pattern;
+   double shift_us = (double)row_bits * SHIFT_NS_PER_BIT / 1000;
+   double encode = encode_us(matrix, l.row_pattern);
+   double cycles = 1000000.0 / (shift_us * l.row_pattern * matrix->getColorDepth());
+   printf("%-10s %8u %10.1f %10.2f %10.0f\n", l.name, row_bits, shift_us, encode, cycles);
+   delete matrix;
+}
+
+int main()
+{
+   static const layout layouts[] = {
+      {"32x16/8", 32, 16, 8},
+      {"64x32/16", 64, 32, 16},
+      {"128x64/32", 128, 64, 32},
+      {"256x64/32", 256, 64, 32},
+   };
+
+   printf("%-10s %-10s %-6s %8s %8s %8s\n", "layout", "frames", "bufs", "dma", "other", "total");
+   for (const layout &l : layouts)
+   {
+      memory(l, false, false);
+      memory(l, true, false);
+      memory(l, false, true);
+      memory(l, true, true);
+   }
+
+   printf("\n%-10s %8s %10s %10s %10s\n", "layout", "row bits", "shift us", "encode us", "cycles/s");
+   for (const layout &l : layouts)
+      timing(l);
+
+   return 0;
+}
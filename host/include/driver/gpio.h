@@ -0,0 +1,42 @@
+/****************************************************************
+ * Host stand-in for driver/gpio.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_DRIVER_GPIO_H__
+#define HOST_DRIVER_GPIO_H__
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+#include "esp32/rom/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+   GPIO_NUM_NC = -1,
+   GPIO_NUM_MAX = 40
+} gpio_num_t;
+
+typedef enum {
+   GPIO_MODE_DISABLE = 0,
+   GPIO_MODE_INPUT = 1,
+   GPIO_MODE_OUTPUT = 2,
+   GPIO_MODE_INPUT_OUTPUT = 3
+} gpio_mode_t;
+
+void gpio_pad_select_gpio(uint8_t gpio_num);
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+
+// Levels go to the panel model, which acts on latch, OE and address pins
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+/****************************************************************
+ * Host stand-in for driver/periph_ctrl.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_DRIVER_PERIPH_CTRL_H__
+#define HOST_DRIVER_PERIPH_CTRL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+   PERIPH_I2S0_MODULE,
+   PERIPH_I2S1_MODULE,
+   PERIPH_HSPI_MODULE,
+   PERIPH_VSPI_MODULE,
+   PERIPH_SPI_DMA_MODULE,
+   PERIPH_RMT_MODULE,
+   PERIPH_TIMG0_MODULE
+} periph_module_t;
+
+void periph_module_enable(periph_module_t periph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
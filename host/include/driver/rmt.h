@@ -0,0 +1,75 @@
+/****************************************************************
+ * Host stand-in for driver/rmt.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_DRIVER_RMT_H__
+#define HOST_DRIVER_RMT_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "soc/rmt_struct.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+   RMT_CHANNEL_0,
+   RMT_CHANNEL_1,
+   RMT_CHANNEL_MAX = 8
+} rmt_channel_t;
+
+typedef enum {
+   RMT_MODE_TX,
+   RMT_MODE_RX
+} rmt_mode_t;
+
+typedef enum {
+   RMT_IDLE_LEVEL_LOW,
+   RMT_IDLE_LEVEL_HIGH
+} rmt_idle_level_t;
+
+typedef enum {
+   RMT_CARRIER_LEVEL_LOW,
+   RMT_CARRIER_LEVEL_HIGH
+} rmt_carrier_level_t;
+
+typedef struct {
+   bool loop_en;
+   uint32_t carrier_freq_hz;
+   uint8_t carrier_duty_percent;
+   rmt_carrier_level_t carrier_level;
+   bool carrier_en;
+   rmt_idle_level_t idle_level;
+   bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+   rmt_mode_t rmt_mode;
+   rmt_channel_t channel;
+   uint8_t clk_div;
+   gpio_num_t gpio_num;
+   uint8_t mem_block_num;
+   rmt_tx_config_t tx_config;
+} rmt_config_t;
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags);
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel);
+
+// The items drive the channel's pin from the APB clock over the divider,
+// until a zero duration or the last item. Then the pin returns to idle
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done);
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+/****************************************************************
+ * Host stand-in for driver/spi_master.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_DRIVER_SPI_MASTER_H__
+#define HOST_DRIVER_SPI_MASTER_H__
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+   SPI_HOST = 0,
+   HSPI_HOST = 1,
+   VSPI_HOST = 2
+} spi_host_device_t;
+
+#define SPICOMMON_BUSFLAG_MASTER        (1 << 0)
+#define SPICOMMON_BUSFLAG_QUAD          (1 << 6)
+
+typedef struct {
+   int mosi_io_num;
+   int miso_io_num;
+   int sclk_io_num;
+   int quadwp_io_num;
+   int quadhd_io_num;
+   int max_transfer_sz;
+   uint32_t flags;
+   int intr_flags;
+} spi_bus_config_t;
+
+#define SPI_DEVICE_HALFDUPLEX           (1 << 4)
+
+struct spi_transaction_t;
+typedef void (*transaction_cb_t)(struct spi_transaction_t *trans);
+
+typedef struct {
+   uint8_t command_bits;
+   uint8_t address_bits;
+   uint8_t dummy_bits;
+   uint8_t mode;
+   uint16_t duty_cycle_pos;
+   uint16_t cs_ena_pretrans;
+   uint8_t cs_ena_posttrans;
+   int clock_speed_hz;
+   int input_delay_ns;
+   int spics_io_num;
+   uint32_t flags;
+   int queue_size;
+   transaction_cb_t pre_cb;
+   transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+#define SPI_TRANS_MODE_DIO              (1 << 0)
+#define SPI_TRANS_MODE_QIO              (1 << 1)
+#define SPI_TRANS_USE_RXDATA            (1 << 2)
+#define SPI_TRANS_USE_TXDATA            (1 << 3)
+#define SPI_TRANS_MODE_DIOQIO_ADDR      (1 << 4)
+
+typedef struct spi_transaction_t {
+   uint32_t flags;
+   uint16_t cmd;
+   uint64_t addr;
+   size_t length;
+   size_t rxlength;
+   void *user;
+   union {
+      const void *tx_buffer;
+      uint8_t tx_data[4];
+   };
+   union {
+      void *rx_buffer;
+      uint8_t rx_data[4];
+   };
+} spi_transaction_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, int dma_chan);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config, spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_bus_free(spi_host_device_t host);
+
+// Transactions are shifted into the panel model one after the other at the
+// device's clock. The data is read when a transaction ends, so a buffer
+// changed while it is in flight shows up in the panel image. post_cb runs
+// at that point, as it would from the SPI interrupt
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait);
+
+// Moves simulated time on until the oldest transaction has ended
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
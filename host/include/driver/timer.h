@@ -0,0 +1,86 @@
+/****************************************************************
+ * Host stand-in for driver/timer.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_DRIVER_TIMER_H__
+#define HOST_DRIVER_TIMER_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+   TIMER_GROUP_0,
+   TIMER_GROUP_1,
+   TIMER_GROUP_MAX
+} timer_group_t;
+
+typedef enum {
+   TIMER_0,
+   TIMER_1,
+   TIMER_MAX
+} timer_idx_t;
+
+typedef enum {
+   TIMER_COUNT_DOWN,
+   TIMER_COUNT_UP
+} timer_count_dir_t;
+
+typedef enum {
+   TIMER_PAUSE,
+   TIMER_START
+} timer_start_t;
+
+typedef enum {
+   TIMER_ALARM_DIS,
+   TIMER_ALARM_EN
+} timer_alarm_t;
+
+typedef enum {
+   TIMER_INTR_LEVEL,
+   TIMER_INTR_MAX
+} timer_intr_mode_t;
+
+typedef enum {
+   TIMER_AUTORELOAD_DIS,
+   TIMER_AUTORELOAD_EN
+} timer_autoreload_t;
+
+typedef struct {
+   timer_alarm_t alarm_en;
+   timer_start_t counter_en;
+   timer_intr_mode_t intr_type;
+   timer_count_dir_t counter_dir;
+   timer_autoreload_t auto_reload;
+   uint32_t divider;
+} timer_config_t;
+
+typedef intr_handle_t timer_isr_handle_t;
+
+// Counting up only, the alarm interrupt runs as a scheduled event
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config);
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val);
+esp_err_t timer_get_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *timer_val);
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value);
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_isr_register(timer_group_t group_num, timer_idx_t timer_num, void (*fn)(void *), void *arg, int intr_alloc_flags, timer_isr_handle_t *handle);
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num);
+
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val);
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+void timer_group_intr_clr_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
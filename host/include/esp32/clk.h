@@ -0,0 +1,22 @@
+/****************************************************************
+ * Host stand-in for esp32/clk.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP32_CLK_H__
+#define HOST_ESP32_CLK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The simulated CPU runs at 240 MHz
+int esp_clk_cpu_freq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+/****************************************************************
+ * Host stand-in for esp32/rom/ets_sys.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP32_ROM_ETS_SYS_H__
+#define HOST_ESP32_ROM_ETS_SYS_H__
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Moves simulated time on, running anything due in the meantime
+void ets_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
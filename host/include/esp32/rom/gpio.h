@@ -0,0 +1,23 @@
+/****************************************************************
+ * Host stand-in for esp32/rom/gpio.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP32_ROM_GPIO_H__
+#define HOST_ESP32_ROM_GPIO_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, bool out_inv, bool oen_inv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
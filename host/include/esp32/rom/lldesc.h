@@ -0,0 +1,27 @@
+/****************************************************************
+ * Host stand-in for esp32/rom/lldesc.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP32_ROM_LLDESC_H__
+#define HOST_ESP32_ROM_LLDESC_H__
+#include <stdint.h>
+#include <sys/queue.h>
+
+typedef struct lldesc_s {
+   volatile uint32_t size   : 12,
+                     length : 12,
+                     offset : 5,
+                     sosf   : 1,
+                     eof    : 1,
+                     owner  : 1;
+   volatile uint8_t *buf;
+   union {
+      volatile uint32_t empty;
+      STAILQ_ENTRY(lldesc_s) qe;
+   };
+} lldesc_t;
+
+#endif
@@ -0,0 +1,15 @@
+/****************************************************************
+ * Host stand-in for esp_attr.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP_ATTR_H__
+#define HOST_ESP_ATTR_H__
+
+// There is no flash cache to miss on the host
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
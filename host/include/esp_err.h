@@ -0,0 +1,38 @@
+/****************************************************************
+ * Host stand-in for esp_err.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP_ERR_H__
+#define HOST_ESP_ERR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_TIMEOUT         0x107
+
+// Stops the simulation with the failing call's location
+void sim_error_check_failed(esp_err_t rc, const char *file, int line, const char *expression);
+
+#define ESP_ERROR_CHECK(x) do {                                         \
+      esp_err_t err_rc_ = (x);                                          \
+      if (ESP_OK != err_rc_)                                            \
+         sim_error_check_failed(err_rc_, __FILE__, __LINE__, #x);       \
+   } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+/****************************************************************
+ * Host stand-in for esp_intr_alloc.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP_INTR_ALLOC_H__
+#define HOST_ESP_INTR_ALLOC_H__
+#include "esp_err.h"
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_INTR_FLAG_LEVEL1    (1 << 1)
+#define ESP_INTR_FLAG_SHARED    (1 << 8)
+#define ESP_INTR_FLAG_IRAM      (1 << 10)
+
+typedef void (*intr_handler_t)(void *arg);
+typedef struct intr_handle_data_t *intr_handle_t;
+
+// Handlers of the SPI peripherals are called when a transfer they started
+// ends, the rest are kept but never called
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg, intr_handle_t *ret_handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+/****************************************************************
+ * Host stand-in for esp_timer.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_ESP_TIMER_H__
+#define HOST_ESP_TIMER_H__
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Simulated microseconds since sim_reset
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+/****************************************************************
+ * Host stand-in for freertos/FreeRTOS.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_FREERTOS_H__
+#define HOST_FREERTOS_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+// Brought in through the port headers on target
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp32/rom/ets_sys.h"
+#include "xtensa/hal.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  1
+#define portMAX_DELAY           ((TickType_t)0xffffffff)
+#define portTICK_PERIOD_MS      10
+#define portTICK_RATE_MS        portTICK_PERIOD_MS
+
+// Everything runs on one thread, so locks have nothing to exclude
+typedef struct {
+   uint32_t owner;
+   uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0, 0 }
+#define vPortCPUInitializeMutex(mux)    do { (mux)->owner = 0; (mux)->count = 0; } while (0)
+#define portENTER_CRITICAL(mux)         do { (mux)->count++; } while (0)
+#define portEXIT_CRITICAL(mux)          do { (mux)->count--; } while (0)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR()            do { } while (0)
+
+#endif
@@ -0,0 +1,42 @@
+/****************************************************************
+ * Host stand-in for freertos/task.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_FREERTOS_TASK_H__
+#define HOST_FREERTOS_TASK_H__
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *TaskHandle_t;
+
+typedef enum {
+   eNoAction,
+   eSetBits,
+   eIncrement,
+   eSetValueWithOverwrite,
+   eSetValueWithoutOverwrite
+} eNotifyAction;
+
+// Moves simulated time on by the ticks
+void vTaskDelay(TickType_t ticks);
+
+// There is one task, the one running the test
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken);
+
+// Blocks by running what falls due until the task is notified or the ticks
+// are up, the time it waits counts as blocked
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
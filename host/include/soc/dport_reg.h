@@ -0,0 +1,16 @@
+/****************************************************************
+ * Host stand-in for soc/dport_reg.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_DPORT_REG_H__
+#define HOST_SOC_DPORT_REG_H__
+
+#define DPORT_SPI_DMA_CHAN_SEL_REG      0x3ff005a8
+
+// There are no DPORT registers to write
+#define DPORT_SET_PERI_REG_BITS(reg, bit_map, value, shift) do { (void)(reg); (void)(value); } while (0)
+
+#endif
@@ -0,0 +1,22 @@
+/****************************************************************
+ * Host stand-in for soc/gpio_sig_map.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_GPIO_SIG_MAP_H__
+#define HOST_SOC_GPIO_SIG_MAP_H__
+
+#define HSPICLK_OUT_IDX         8
+#define HSPID_OUT_IDX           10
+#define I2S1O_WS_OUT_IDX        35
+#define VSPICLK_OUT_IDX         63
+#define VSPIQ_OUT_IDX           64
+#define VSPID_OUT_IDX           65
+#define VSPIHD_OUT_IDX          66
+#define VSPIWP_OUT_IDX          67
+#define I2S1O_DATA_OUT0_IDX     166
+#define I2S1O_DATA_OUT8_IDX     174
+
+#endif
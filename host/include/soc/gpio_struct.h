@@ -0,0 +1,41 @@
+/****************************************************************
+ * Host stand-in for soc/gpio_struct.h
+ *
+ * Only the output set and clear registers, as C++ so that writing one
+ * reaches the panel model
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_GPIO_STRUCT_H__
+#define HOST_SOC_GPIO_STRUCT_H__
+#include <stdint.h>
+
+extern "C" void sim_gpio_write(uint8_t bank, uint32_t mask, uint32_t level);
+
+// Register setting (level 1) or clearing (level 0) the pins of one bank
+template <uint8_t BANK, uint32_t LEVEL>
+struct sim_gpio_reg {
+   sim_gpio_reg &operator=(uint32_t mask)
+   {
+      sim_gpio_write(BANK, mask, LEVEL);
+      return *this;
+   }
+};
+
+typedef struct {
+   sim_gpio_reg<0, 1> out_w1ts;
+   sim_gpio_reg<0, 0> out_w1tc;
+   struct {
+      sim_gpio_reg<1, 1> val;
+   } out1_w1ts;
+   struct {
+      sim_gpio_reg<1, 0> val;
+   } out1_w1tc;
+} gpio_dev_t;
+
+// Holds nothing, every translation unit can have its own
+static gpio_dev_t GPIO;
+
+#endif
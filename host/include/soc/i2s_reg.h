@@ -0,0 +1,14 @@
+/****************************************************************
+ * Host stand-in for soc/i2s_reg.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_I2S_REG_H__
+#define HOST_SOC_I2S_REG_H__
+
+#define I2S_OUTDSCR_BURST_EN    (1 << 10)
+#define I2S_OUT_DATA_BURST_EN   (1 << 11)
+
+#endif
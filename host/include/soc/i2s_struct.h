@@ -0,0 +1,115 @@
+/****************************************************************
+ * Host stand-in for soc/i2s_struct.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_I2S_STRUCT_H__
+#define HOST_SOC_I2S_STRUCT_H__
+#include <stdint.h>
+
+// Only the fields PxMatrix programs. Writes land in plain memory, the I2S
+// parallel output isn't simulated
+typedef volatile struct i2s_dev_s {
+   union {
+      struct {
+         uint32_t tx_reset       : 1;
+         uint32_t rx_reset       : 1;
+         uint32_t tx_fifo_reset  : 1;
+         uint32_t rx_fifo_reset  : 1;
+         uint32_t tx_start       : 1;
+         uint32_t rx_start       : 1;
+         uint32_t tx_slave_mod   : 1;
+         uint32_t rx_slave_mod   : 1;
+         uint32_t tx_right_first : 1;
+         uint32_t rx_right_first : 1;
+      };
+      uint32_t val;
+   } conf;
+   union {
+      struct {
+         uint32_t in_rst        : 1;
+         uint32_t out_rst       : 1;
+         uint32_t ahbm_fifo_rst : 1;
+         uint32_t ahbm_rst      : 1;
+      };
+      uint32_t val;
+   } lc_conf;
+   union {
+      struct {
+         uint32_t addr     : 20;
+         uint32_t reserved : 8;
+         uint32_t stop     : 1;
+         uint32_t start    : 1;
+      };
+      uint32_t val;
+   } out_link;
+   union {
+      struct {
+         uint32_t camera_en      : 1;
+         uint32_t lcd_tx_wrx2_en : 1;
+         uint32_t lcd_tx_sdx2_en : 1;
+         uint32_t reserved       : 2;
+         uint32_t lcd_en         : 1;
+      };
+      uint32_t val;
+   } conf2;
+   union {
+      struct {
+         uint32_t rx_bck_div_num : 6;
+         uint32_t tx_bck_div_num : 6;
+         uint32_t rx_bits_mod    : 6;
+         uint32_t tx_bits_mod    : 6;
+      };
+      uint32_t val;
+   } sample_rate_conf;
+   union {
+      struct {
+         uint32_t clkm_div_num : 8;
+         uint32_t clkm_div_b   : 6;
+         uint32_t clkm_div_a   : 6;
+         uint32_t clk_en       : 1;
+         uint32_t clka_en      : 1;
+      };
+      uint32_t val;
+   } clkm_conf;
+   union {
+      struct {
+         uint32_t rx_data_num          : 6;
+         uint32_t tx_data_num          : 6;
+         uint32_t dscr_en              : 1;
+         uint32_t tx_fifo_mod          : 3;
+         uint32_t rx_fifo_mod          : 3;
+         uint32_t tx_fifo_mod_force_en : 1;
+         uint32_t rx_fifo_mod_force_en : 1;
+      };
+      uint32_t val;
+   } fifo_conf;
+   union {
+      struct {
+         uint32_t tx_pcm_conf   : 3;
+         uint32_t tx_pcm_bypass : 1;
+         uint32_t rx_pcm_conf   : 3;
+         uint32_t rx_pcm_bypass : 1;
+         uint32_t tx_stop_en    : 1;
+      };
+      uint32_t val;
+   } conf1;
+   union {
+      struct {
+         uint32_t tx_chan_mod : 3;
+         uint32_t rx_chan_mod : 2;
+      };
+      uint32_t val;
+   } conf_chan;
+   union {
+      uint32_t val;
+   } timing;
+   uint32_t out_eof_des_addr;
+} i2s_dev_t;
+
+extern i2s_dev_t I2S0;
+extern i2s_dev_t I2S1;
+
+#endif
@@ -0,0 +1,24 @@
+/****************************************************************
+ * Host stand-in for soc/rmt_struct.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_RMT_STRUCT_H__
+#define HOST_SOC_RMT_STRUCT_H__
+#include <stdint.h>
+
+typedef struct {
+   union {
+      struct {
+         uint32_t duration0 : 15;
+         uint32_t level0    : 1;
+         uint32_t duration1 : 15;
+         uint32_t level1    : 1;
+      };
+      uint32_t val;
+   };
+} rmt_item32_t;
+
+#endif
@@ -0,0 +1,18 @@
+/****************************************************************
+ * Host stand-in for soc/soc.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_SOC_H__
+#define HOST_SOC_SOC_H__
+
+#define APB_CLK_FREQ            80000000
+
+#define ETS_SPI2_INTR_SOURCE    30
+#define ETS_SPI3_INTR_SOURCE    31
+#define ETS_I2S0_INTR_SOURCE    32
+#define ETS_I2S1_INTR_SOURCE    33
+
+#endif
@@ -0,0 +1,23 @@
+/****************************************************************
+ * Host stand-in for soc/soc_memory_layout.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_SOC_MEMORY_LAYOUT_H__
+#define HOST_SOC_SOC_MEMORY_LAYOUT_H__
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// True inside the simulated PSRAM arena
+bool esp_ptr_external_ram(const void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
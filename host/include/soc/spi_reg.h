@@ -0,0 +1,18 @@
+/****************************************************************
+ * Host stand-in for soc/spi_reg.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_SPI_REG_H__
+#define HOST_SOC_SPI_REG_H__
+
+#define SPI_OUT_RST             (1 << 2)
+#define SPI_IN_RST              (1 << 3)
+#define SPI_AHBM_FIFO_RST       (1 << 4)
+#define SPI_AHBM_RST            (1 << 5)
+#define SPI_FWRITE_QIO          (1 << 12)
+#define SPI_FWRITE_QUAD         (1 << 15)
+
+#endif
@@ -0,0 +1,129 @@
+/****************************************************************
+ * Host stand-in for soc/spi_struct.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_SOC_SPI_STRUCT_H__
+#define HOST_SOC_SPI_STRUCT_H__
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Setting usr in the command register of SPI2 or SPI3 at reg
+void sim_spi_cmd(const volatile void *reg);
+
+#ifdef __cplusplus
+}
+
+// Setting it starts the transfer, as on the chip
+struct sim_spi_usr {
+   uint32_t val;
+   void operator=(uint32_t usr) volatile
+   {
+      if (usr)
+         sim_spi_cmd(this);
+   }
+};
+#endif
+
+// Only the fields PxMatrix programs. Setting cmd.usr from C++ sends
+// mosi_dlen bits from the descriptors at dma_out_link, the rest are plain
+// memory
+typedef volatile struct spi_dev_s {
+#ifdef __cplusplus
+   struct {
+      sim_spi_usr usr;
+   } cmd;
+#else
+   union {
+      struct {
+         uint32_t reserved0 : 18;
+         uint32_t usr       : 1;
+      };
+      uint32_t val;
+   } cmd;
+#endif
+   union {
+      struct {
+         uint32_t wr_bit_order : 1;
+         uint32_t rd_bit_order : 1;
+      };
+      uint32_t val;
+   } ctrl;
+   union {
+      uint32_t val;
+   } ctrl2;
+   union {
+      struct {
+         uint32_t clkcnt_l       : 6;
+         uint32_t clkcnt_h       : 6;
+         uint32_t clkcnt_n       : 6;
+         uint32_t clkdiv_pre     : 13;
+         uint32_t clk_equ_sysclk : 1;
+      };
+      uint32_t val;
+   } clock;
+   union {
+      struct {
+         uint32_t usr_mosi : 1;
+         uint32_t usr_miso : 1;
+      };
+      uint32_t val;
+   } user;
+   union {
+      uint32_t val;
+   } user1;
+   union {
+      uint32_t val;
+   } user2;
+   union {
+      struct {
+         uint32_t usr_mosi_dbitlen : 24;
+      };
+      uint32_t val;
+   } mosi_dlen;
+   union {
+      struct {
+         uint32_t cs0_dis : 1;
+         uint32_t cs1_dis : 1;
+         uint32_t cs2_dis : 1;
+      };
+      uint32_t val;
+   } pin;
+   union {
+      struct {
+         uint32_t trans_done  : 1;
+         uint32_t trans_inten : 1;
+      };
+      uint32_t val;
+   } slave;
+   union {
+      struct {
+         uint32_t out_data_burst_en : 1;
+         uint32_t outdscr_burst_en  : 1;
+      };
+      uint32_t val;
+   } dma_conf;
+   union {
+      struct {
+         uint32_t addr    : 20;
+         uint32_t reserved: 8;
+         uint32_t stop    : 1;
+         uint32_t start   : 1;
+         uint32_t restart : 1;
+      };
+      uint32_t val;
+   } dma_out_link;
+   union {
+      uint32_t val;
+   } dma_int_ena;
+} spi_dev_t;
+
+extern spi_dev_t SPI2;
+extern spi_dev_t SPI3;
+
+#endif
@@ -0,0 +1,23 @@
+/****************************************************************
+ * Host stand-in for xtensa/hal.h
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef HOST_XTENSA_HAL_H__
+#define HOST_XTENSA_HAL_H__
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cycle count of the simulated 240 MHz CPU, every read costs sim_cpu_step_ns
+uint32_t xthal_get_ccount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,319 @@
+/****************************************************************
+ * Host simulator for PxMatrix, the panel model
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+static struct sim_panel_config panel;
+static bool panel_wired;
+
+// Bits of the shift chain and of the output latches, by position from the
+// data input
+static uint32_t chain_length;
+static uint8_t *chain;
+static uint8_t *outputs;
+
+// Light index (y * width + x) * 3 + channel for every scan row and position
+static uint32_t *light_map;
+static uint64_t *light;
+static uint64_t *row_time;
+static uint64_t last_update;
+
+static uint8_t latch_level;
+static uint8_t oe_level;
+static uint8_t address_bits;
+static uint8_t address;
+
+static uint32_t latches;
+static uint32_t ghosts;
+static uint64_t bits_shifted;
+
+// Where position in a colour's stretch of the chain of a scan row lands
+static bool wire(uint32_t position, uint8_t row, uint16_t *x, uint16_t *y)
+{
+   uint16_t blocks = panel.width / 8;
+   uint16_t across;
+   uint32_t band;
+   uint8_t sub;
+   uint8_t bit;
+   uint8_t rows;
+
+   switch (panel.wiring)
+   {
+   case SIM_LINE:
+      across = position % panel.width;
+      *y = ((position / panel.width) * panel.row_pattern) + row;
+      break;
+   case SIM_ZIGZAG:
+      band = position / 16;
+      sub = (position % 16) / 8;
+      across = ((band % blocks) * 8) + (position % 8);
+      *y = ((((band / blocks) * 2) + 1 - sub) * panel.row_pattern) + row;
+      break;
+   case SIM_ZAGGIZ:
+      rows = (panel.row_pattern < 8) ? 8 : panel.row_pattern;
+      band = position / ((rows / panel.row_pattern) * 8);
+      sub = (position % ((rows / panel.row_pattern) * 8)) / 8;
+      bit = position % 8;
+      *y = ((band / blocks) * rows) + (sub * panel.row_pattern) + row;
+      if ((*y % 8) < 4)
+         bit = 7 - bit;
+      across = ((band % blocks) * 8) + bit;
+      break;
+   default:
+      return false;
+   }
+
+   *x = panel.width - 1 - across;
+   return *y < panel.height;
+}
+
+// Adds up the light given off since the last change
+static void panel_update(void)
+{
+   uint64_t now = sim_time_ns();
+   uint64_t elapsed = now - last_update;
+   last_update = now;
+
+   if (!panel_wired || (0 == elapsed) || (0 != oe_level))
+      return;
+
+   row_time[address] += elapsed;
+   const uint32_t *map = &light_map[address * chain_length];
+   for (uint32_t position = 0; position < chain_length; position++)
+   {
+      if (outputs[position])
+         light[map[position]] += elapsed;
+   }
+}
+
+void sim_panel_begin(const struct sim_panel_config *config)
+{
+   free(chain);
+   free(outputs);
+   free(light_map);
+   free(light);
+   free(row_time);
+   chain = NULL;
+   outputs = NULL;
+   light_map = NULL;
+   light = NULL;
+   row_time = NULL;
+   panel_wired = false;
+
+   latch_level = 0;
+   oe_level = 1;
+   address = 0;
+   latches = 0;
+   ghosts = 0;
+   bits_shifted = 0;
+   last_update = sim_time_ns();
+
+   if (NULL == config)
+      return;
+
+   panel = *config;
+   for (address_bits = 0; (1 << address_bits) < panel.row_pattern; address_bits++)
+      ;
+
+   uint32_t colour_length = (panel.height / panel.row_pattern) * panel.width;
+   chain_length = colour_length * 3;
+   chain = (uint8_t *)calloc(chain_length, 1);
+   outputs = (uint8_t *)calloc(chain_length, 1);
+   light_map = (uint32_t *)calloc((size_t)panel.row_pattern * chain_length, sizeof(uint32_t));
+   light = (uint64_t *)calloc((size_t)panel.width * panel.height * 3, sizeof(uint64_t));
+   row_time = (uint64_t *)calloc(panel.row_pattern, sizeof(uint64_t));
+   if ((NULL == chain) || (NULL == outputs) || (NULL == light_map) || (NULL == light) || (NULL == row_time))
+   {
+      printf("Out of memory for a %dx%d panel\n", panel.width, panel.height);
+      fflush(stdout);
+      abort();
+   }
+
+   // Every LED must be wired to exactly one position of one scan row
+   uint8_t *wired = (uint8_t *)calloc((size_t)panel.width * panel.height * 3, 1);
+   for (uint8_t row = 0; row < panel.row_pattern; row++)
+   {
+      for (uint8_t channel = 0; channel < 3; channel++)
+      {
+         for (uint32_t position = 0; position < colour_length; position++)
+         {
+            uint16_t x, y;
+            if (!wire(position, row, &x, &y))
+            {
+               printf("Wiring %d doesn't fit a %dx%d panel with row pattern %d\n", panel.wiring, panel.width, panel.height, panel.row_pattern);
+               fflush(stdout);
+               abort();
+            }
+
+            uint32_t index = (((uint32_t)y * panel.width) + x) * 3 + channel;
+            light_map[(row * chain_length) + (channel * colour_length) + position] = index;
+            wired[index]++;
+         }
+      }
+   }
+   for (uint32_t index = 0; index < (uint32_t)panel.width * panel.height * 3; index++)
+   {
+      if (1 != wired[index])
+      {
+         printf("Wiring %d misses LEDs of a %dx%d panel with row pattern %d\n", panel.wiring, panel.width, panel.height, panel.row_pattern);
+         fflush(stdout);
+         abort();
+      }
+   }
+   free(wired);
+
+   panel_wired = true;
+}
+
+void sim_panel_clear(void)
+{
+   panel_update();
+   if (!panel_wired)
+      return;
+
+   memset(light, 0, (size_t)panel.width * panel.height * 3 * sizeof(uint64_t));
+   memset(row_time, 0, panel.row_pattern * sizeof(uint64_t));
+   latches = 0;
+   ghosts = 0;
+}
+
+uint64_t sim_panel_light(uint16_t x, uint16_t y, uint8_t channel)
+{
+   panel_update();
+   if (!panel_wired || (x >= panel.width) || (y >= panel.height) || (channel > 2))
+      return 0;
+   return light[(((uint32_t)y * panel.width) + x) * 3 + channel];
+}
+
+uint64_t sim_panel_row_time(uint8_t row)
+{
+   panel_update();
+   if (!panel_wired || (row >= panel.row_pattern))
+      return 0;
+   return row_time[row];
+}
+
+uint8_t sim_panel_level(uint16_t x, uint16_t y, uint8_t channel)
+{
+   uint64_t on = sim_panel_row_time(y % panel.row_pattern);
+   if (0 == on)
+      return 0;
+
+   uint64_t level = ((sim_panel_light(x, y, channel) * 255) + (on / 2)) / on;
+   return (level > 255) ? 255 : level;
+}
+
+bool sim_panel_uses_pin(uint8_t pin)
+{
+   if (!panel_wired)
+      return false;
+   if ((pin == panel.latch_pin) || (pin == panel.oe_pin))
+      return true;
+   for (uint8_t bit = 0; bit < address_bits; bit++)
+   {
+      if (pin == panel.address_pins[bit])
+         return true;
+   }
+   return false;
+}
+
+uint32_t sim_panel_latches(void)
+{
+   return latches;
+}
+
+uint32_t sim_panel_ghosts(void)
+{
+   return ghosts;
+}
+
+uint64_t sim_panel_bits(void)
+{
+   return bits_shifted;
+}
+
+// Shifts bits clocks into the stretch of the chain from start, lane picks
+// the data bit of each clock
+static void shift_stretch(uint32_t start, uint32_t length, const uint8_t *data, uint32_t clocks, uint8_t lanes, uint8_t lane)
+{
+   uint8_t *stretch = &chain[start];
+
+   // Bits already in the chain move along, the last clock ends up nearest
+   // the input
+   if (clocks < length)
+      memmove(&stretch[clocks], stretch, length - clocks);
+
+   for (uint32_t position = 0; (position < clocks) && (position < length); position++)
+   {
+      uint32_t clock = clocks - 1 - position;
+      uint8_t bit;
+
+      if (1 == lanes)
+         bit = (data[clock / 8] >> (7 - (clock % 8))) & 1;
+      else
+         bit = (data[clock / 2] >> (((clock & 1) ? 0 : 4) + lane)) & 1;
+      stretch[position] = bit;
+   }
+}
+
+void sim_panel_shift(const uint8_t *data, uint32_t bits, uint8_t lanes)
+{
+   if (!panel_wired)
+      return;
+
+   bits_shifted += bits;
+   if (1 == lanes)
+   {
+      shift_stretch(0, chain_length, data, bits, 1, 0);
+      return;
+   }
+
+   // Lane n feeds quarter n counted from the far end of the chain, where
+   // quarter n of a single lane row ends up
+   uint32_t quarter = chain_length / 4;
+   for (uint8_t lane = 0; lane < 4; lane++)
+      shift_stretch((3 - lane) * quarter, quarter, data, bits / 4, 4, lane);
+}
+
+void sim_panel_pin(uint8_t pin, uint32_t level)
+{
+   if (!panel_wired)
+      return;
+
+   panel_update();
+   level = level ? 1 : 0;
+
+   if (pin == panel.latch_pin)
+   {
+      // The outputs follow the chain on the rising edge
+      if (level && !latch_level)
+      {
+         latches++;
+         if (0 == oe_level)
+            ghosts++;
+         memcpy(outputs, chain, chain_length);
+      }
+      latch_level = level;
+   }
+
+   if (pin == panel.oe_pin)
+      oe_level = level;
+
+   for (uint8_t bit = 0; bit < address_bits; bit++)
+   {
+      if (pin != panel.address_pins[bit])
+         continue;
+
+      uint8_t changed = (address & ~(1 << bit)) | (level << bit);
+      if ((changed != address) && (0 == oe_level))
+         ghosts++;
+      address = changed;
+   }
+}
@@ -0,0 +1,1106 @@
+/****************************************************************
+ * Host simulator for PxMatrix, the simulated clock and the stand-in
+ * IDF drivers
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_intr_alloc.h"
+#include "esp_timer.h"
+#include "esp32/clk.h"
+#include "esp32/rom/lldesc.h"
+#include "esp32/rom/ets_sys.h"
+#include "esp32/rom/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+#include "driver/rmt.h"
+#include "driver/spi_master.h"
+#include "driver/timer.h"
+#include "soc/i2s_struct.h"
+#include "soc/soc.h"
+#include "soc/soc_memory_layout.h"
+#include "soc/spi_struct.h"
+#include "xtensa/hal.h"
+#include "sim.h"
+
+#define SIM_CPU_FREQ 240000000
+#define SIM_EVENTS 64
+#define SIM_SPI_QUEUE 8
+#define SIM_PSRAM_SIZE (4 << 20)
+#define SIM_GPIOS 40
+#define SIM_INTRS 8
+
+// Internal DRAM, the DMA takes the low 20 bits of an address in it
+#define SIM_DMA_BASE 0x3FF00000UL
+#define SIM_DMA_SIZE (1 << 20)
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+// Far beyond any test, a driver waiting on something that never happens
+// stops here instead of spinning for ever
+#define SIM_TIME_LIMIT_NS (60ULL * 1000000000ULL)
+
+spi_dev_t SPI2;
+spi_dev_t SPI3;
+i2s_dev_t I2S0;
+i2s_dev_t I2S1;
+
+uint32_t sim_cpu_step_ns = 50;
+
+static uint64_t sim_now;
+static uint64_t sim_blocked;
+static uint64_t sim_spun;
+static uint8_t sim_isr_depth;
+static uint32_t sim_faults;
+static uint32_t sim_clashes;
+static uint8_t sim_lanes;
+
+struct sim_event {
+   uint64_t time;
+   uint32_t order;
+   void (*fn)(void *arg);
+   void *arg;
+};
+
+static struct sim_event sim_events[SIM_EVENTS];
+static uint8_t sim_event_count;
+static uint32_t sim_event_order;
+
+static uint8_t gpio_levels[SIM_GPIOS];
+
+// PSRAM is a bump allocator over a fixed arena, nothing is given back
+static uint8_t *psram;
+static size_t psram_used;
+static size_t psram_limit;
+
+// So is DMA capable memory, mapped at SIM_DMA_BASE
+static uint8_t *dma_ram;
+static size_t dma_ram_used;
+static size_t dma_ram_limit;
+
+struct sim_intr {
+   int source;
+   int flags;
+   intr_handler_t handler;
+   void *arg;
+};
+
+static struct sim_intr intrs[SIM_INTRS];
+static uint8_t intr_count;
+
+uint64_t sim_time_ns(void)
+{
+   return sim_now;
+}
+
+bool sim_in_isr(void)
+{
+   return 0 != sim_isr_depth;
+}
+
+bool sim_schedule(uint64_t ns, void (*fn)(void *arg), void *arg)
+{
+   if (sim_event_count >= SIM_EVENTS)
+      return false;
+
+   struct sim_event *event = &sim_events[sim_event_count++];
+   event->time = ns;
+   event->order = sim_event_order++;
+   event->fn = fn;
+   event->arg = arg;
+   return true;
+}
+
+// Earliest event, events due at the same time run in the order scheduled
+static int8_t sim_next_event(void)
+{
+   int8_t next = -1;
+
+   for (uint8_t idx = 0; idx < sim_event_count; idx++)
+   {
+      if ((next < 0) || (sim_events[idx].time < sim_events[next].time) ||
+          ((sim_events[idx].time == sim_events[next].time) && (sim_events[idx].order < sim_events[next].order)))
+         next = idx;
+   }
+   return next;
+}
+
+static void sim_set_time(uint64_t ns)
+{
+   if (ns > sim_now)
+      sim_now = ns;
+
+   if (sim_now > SIM_TIME_LIMIT_NS)
+   {
+      printf("Simulated time ran past %llu s, the driver is stuck\n", SIM_TIME_LIMIT_NS / 1000000000ULL);
+      fflush(stdout);
+      abort();
+   }
+}
+
+void sim_advance(uint64_t ns)
+{
+   uint64_t target = sim_now + ns;
+
+   // An interrupt handler isn't interrupted, what falls due waits for it
+   if (sim_in_isr())
+   {
+      sim_set_time(target);
+      return;
+   }
+
+   while (true)
+   {
+      int8_t next = sim_next_event();
+      if ((next < 0) || (sim_events[next].time > target))
+         break;
+
+      struct sim_event event = sim_events[next];
+      sim_events[next] = sim_events[--sim_event_count];
+
+      sim_set_time(event.time);
+      sim_isr_depth++;
+      event.fn(event.arg);
+      sim_isr_depth--;
+   }
+
+   sim_set_time(target);
+}
+
+uint32_t sim_isr_faults(void)
+{
+   return sim_faults;
+}
+
+// Calls an interrupt handler in IRAM mustn't make
+static void sim_isr_fault(const char *what)
+{
+   if (!sim_in_isr())
+      return;
+
+   if (0 == sim_faults++)
+      printf("%s called from an interrupt at %llu ns\n", what, (unsigned long long)sim_now);
+}
+
+void sim_error_check_failed(esp_err_t rc, const char *file, int line, const char *expression)
+{
+   printf("%s:%d: %s failed with 0x%x\n", file, line, expression, rc);
+   fflush(stdout);
+   abort();
+}
+
+/*
+ * Clock
+ */
+
+int64_t esp_timer_get_time(void)
+{
+   sim_advance(sim_cpu_step_ns);
+   return sim_now / 1000;
+}
+
+uint32_t xthal_get_ccount(void)
+{
+   sim_advance(sim_cpu_step_ns);
+   return (uint32_t)((sim_now * (SIM_CPU_FREQ / 1000000)) / 1000);
+}
+
+int esp_clk_cpu_freq(void)
+{
+   return SIM_CPU_FREQ;
+}
+
+uint64_t sim_blocked_ns(void)
+{
+   return sim_blocked;
+}
+
+uint64_t sim_spun_ns(void)
+{
+   return sim_spun;
+}
+
+// Waits the way a blocked task does, other tasks could run meanwhile
+static void sim_block(uint64_t until)
+{
+   uint64_t from = sim_now;
+
+   if (until > sim_now)
+      sim_advance(until - sim_now);
+   sim_blocked += sim_now - from;
+}
+
+void ets_delay_us(uint32_t us)
+{
+   sim_isr_fault("ets_delay_us");
+   sim_advance((uint64_t)us * 1000);
+   sim_spun += (uint64_t)us * 1000;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+   sim_isr_fault("vTaskDelay");
+   sim_block(sim_now + ((uint64_t)ticks * portTICK_PERIOD_MS * 1000000));
+}
+
+/*
+ * Task notifications, of the one task there is
+ */
+
+static uint32_t sim_task;
+static uint32_t sim_notify_value;
+static bool sim_notified;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+   return &sim_task;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken)
+{
+   BaseType_t ret = pdPASS;
+
+   if (eSetBits == action)
+      sim_notify_value |= value;
+   else if (eIncrement == action)
+      sim_notify_value++;
+   else if (eSetValueWithOverwrite == action)
+      sim_notify_value = value;
+   else if (eSetValueWithoutOverwrite == action)
+   {
+      if (sim_notified)
+         ret = pdFALSE;
+      else
+         sim_notify_value = value;
+   }
+   sim_notified = true;
+
+   if (NULL != woken)
+      *woken = pdTRUE;
+   return ret;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+   sim_isr_fault("xTaskNotifyWait");
+
+   if (!sim_notified)
+   {
+      uint64_t deadline = (portMAX_DELAY == ticks) ? SIM_TIME_LIMIT_NS + 1 : sim_now + ((uint64_t)ticks * portTICK_PERIOD_MS * 1000000);
+
+      sim_notify_value &= ~clear_on_entry;
+      while (!sim_notified && (sim_now < deadline))
+      {
+         // Nothing due would notify, only the ticks running out end the wait
+         int8_t next = sim_next_event();
+         uint64_t until = ((next < 0) || (sim_events[next].time > deadline)) ? deadline : sim_events[next].time;
+         uint64_t from = sim_now;
+         sim_advance((until > sim_now) ? until - sim_now : 0);
+         sim_blocked += sim_now - from;
+      }
+   }
+
+   if (NULL != value)
+      *value = sim_notify_value;
+   if (!sim_notified)
+      return pdFALSE;
+
+   sim_notify_value &= ~clear_on_exit;
+   sim_notified = false;
+   return pdTRUE;
+}
+
+/*
+ * Memory
+ */
+
+static void *arena_alloc(uint8_t *arena, size_t *used, size_t arena_size, size_t size)
+{
+   // Descriptors hold pointers, on the host those are 8 bytes
+   size = (size + 7) & ~7;
+   if ((NULL == arena) || ((*used + size) > arena_size))
+      return NULL;
+
+   void *mem = &arena[*used];
+   *used += size;
+   return mem;
+}
+
+static bool sim_dma_ram(const volatile void *p)
+{
+   return (NULL != dma_ram) && ((const uint8_t *)p >= dma_ram) && ((const uint8_t *)p < &dma_ram[SIM_DMA_SIZE]);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+   if (caps & MALLOC_CAP_SPIRAM)
+      return arena_alloc(psram, &psram_used, psram_limit, size);
+   if (caps & MALLOC_CAP_DMA)
+      return arena_alloc(dma_ram, &dma_ram_used, dma_ram_limit, size);
+   return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+   void *mem = heap_caps_malloc(n * size, caps);
+   if (NULL != mem)
+      memset(mem, 0, n * size);
+   return mem;
+}
+
+void heap_caps_free(void *ptr)
+{
+   if (!esp_ptr_external_ram(ptr) && !sim_dma_ram(ptr))
+      free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+   return heap_caps_get_largest_free_block(caps);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+   if (caps & MALLOC_CAP_SPIRAM)
+      return ((NULL == psram) || (psram_used >= psram_limit)) ? 0 : psram_limit - psram_used;
+   if (caps & MALLOC_CAP_DMA)
+      return ((NULL == dma_ram) || (dma_ram_used >= dma_ram_limit)) ? 0 : dma_ram_limit - dma_ram_used;
+   return 128 * 1024;
+}
+
+void sim_memory_limit(size_t dma, size_t psram)
+{
+   dma_ram_limit = (dma < SIM_DMA_SIZE) ? dma : SIM_DMA_SIZE;
+   psram_limit = (psram < SIM_PSRAM_SIZE) ? psram : SIM_PSRAM_SIZE;
+}
+
+bool esp_ptr_external_ram(const void *p)
+{
+   return (NULL != psram) && ((const uint8_t *)p >= psram) && ((const uint8_t *)p < &psram[SIM_PSRAM_SIZE]);
+}
+
+/*
+ * Interrupts, peripherals and pins
+ */
+
+static struct sim_intr *sim_intr_find(int source)
+{
+   for (uint8_t idx = 0; idx < intr_count; idx++)
+   {
+      if (intrs[idx].source == source)
+         return &intrs[idx];
+   }
+   return NULL;
+}
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg, intr_handle_t *ret_handle)
+{
+   struct sim_intr *intr = sim_intr_find(source);
+   if (NULL == intr)
+   {
+      if (intr_count >= SIM_INTRS)
+         return ESP_ERR_NO_MEM;
+      intr = &intrs[intr_count++];
+   }
+
+   intr->source = source;
+   intr->flags = flags;
+   intr->handler = handler;
+   intr->arg = arg;
+   if (NULL != ret_handle)
+      *ret_handle = (intr_handle_t)intr;
+   return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle)
+{
+   struct sim_intr *intr = (struct sim_intr *)handle;
+   if ((intr < &intrs[0]) || (intr >= &intrs[intr_count]))
+      return ESP_ERR_INVALID_ARG;
+
+   *intr = intrs[--intr_count];
+   return ESP_OK;
+}
+
+// The interrupt of source, if anything asked for it
+static void sim_intr_raise(int source)
+{
+   struct sim_intr *intr = sim_intr_find(source);
+   if (NULL == intr)
+      return;
+
+   // Rows would stop for as long as the flash is written
+   if (!(intr->flags & ESP_INTR_FLAG_IRAM) && (0 == sim_faults++))
+      printf("Interrupt source %d allocated without ESP_INTR_FLAG_IRAM\n", source);
+   intr->handler(intr->arg);
+}
+
+void periph_module_enable(periph_module_t periph)
+{
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+}
+
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, bool out_inv, bool oen_inv)
+{
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+   return ((gpio_num < 0) || (gpio_num >= SIM_GPIOS)) ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+static void sim_gpio_set(uint8_t pin, uint32_t level)
+{
+   gpio_levels[pin] = level ? 1 : 0;
+   sim_panel_pin(pin, gpio_levels[pin]);
+}
+
+// Lives in flash on target
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+   sim_isr_fault("gpio_set_level");
+   if ((gpio_num < 0) || (gpio_num >= SIM_GPIOS))
+      return ESP_ERR_INVALID_ARG;
+
+   sim_gpio_set(gpio_num, level);
+   return ESP_OK;
+}
+
+void sim_gpio_write(uint8_t bank, uint32_t mask, uint32_t level)
+{
+   for (uint8_t bit = 0; bit < 32; bit++)
+   {
+      uint8_t pin = (bank * 32) + bit;
+      if ((mask & (1UL << bit)) && (pin < SIM_GPIOS))
+         sim_gpio_set(pin, level);
+   }
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+   return ((gpio_num < 0) || (gpio_num >= SIM_GPIOS)) ? 0 : gpio_levels[gpio_num];
+}
+
+/*
+ * Event groups
+ */
+
+struct sim_event_group {
+   EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+   return (EventGroupHandle_t)calloc(1, sizeof(struct sim_event_group));
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+   free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+   group->bits |= bits;
+   return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+   EventBits_t was = group->bits;
+   group->bits &= ~bits;
+   return was;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t *woken)
+{
+   xEventGroupSetBits(group, bits);
+   if (NULL != woken)
+      *woken = pdFALSE;
+   return pdPASS;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+   return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t ticks)
+{
+   EventBits_t was = group->bits;
+
+   if (clear && ((all && ((was & bits) == bits)) || (!all && (was & bits))))
+      group->bits &= ~bits;
+   return was;
+}
+
+/*
+ * SPI master
+ */
+
+struct spi_device_t {
+   spi_device_interface_config_t config;
+   spi_transaction_t *queue[SIM_SPI_QUEUE];
+   uint64_t ends[SIM_SPI_QUEUE];
+   uint8_t queued;
+   uint8_t done;
+   uint64_t busy_until;
+};
+
+static uint8_t spi_lanes(const spi_transaction_t *trans)
+{
+   return (trans->flags & SPI_TRANS_MODE_QIO) ? 4 : 1;
+}
+
+// End of the oldest transaction still in flight, as the SPI interrupt
+static void spi_trans_end(void *arg)
+{
+   struct spi_device_t *dev = (struct spi_device_t *)arg;
+   spi_transaction_t *trans = dev->queue[dev->done];
+
+   if (NULL != trans->tx_buffer)
+   {
+      sim_lanes = spi_lanes(trans);
+      sim_panel_shift((const uint8_t *)trans->tx_buffer, trans->length, sim_lanes);
+   }
+   dev->done++;
+
+   if (NULL != dev->config.post_cb)
+      dev->config.post_cb(trans);
+}
+
+// A bus signal routed to a pin the panel is driven from
+static void spi_pin_clash(const char *signal, int pin)
+{
+   if ((pin < 0) || !sim_panel_uses_pin(pin))
+      return;
+
+   if (0 == sim_clashes++)
+      printf("SPI %s is on GPIO%d of the panel\n", signal, pin);
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, int dma_chan)
+{
+   spi_pin_clash("MOSI", bus_config->mosi_io_num);
+   spi_pin_clash("MISO", bus_config->miso_io_num);
+   spi_pin_clash("CLK", bus_config->sclk_io_num);
+   spi_pin_clash("WP", bus_config->quadwp_io_num);
+   spi_pin_clash("HD", bus_config->quadhd_io_num);
+   return ESP_OK;
+}
+
+uint32_t sim_spi_clashes(void)
+{
+   return sim_clashes;
+}
+
+uint8_t sim_spi_lanes(void)
+{
+   return sim_lanes;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config, spi_device_handle_t *handle)
+{
+   struct spi_device_t *dev = (struct spi_device_t *)calloc(1, sizeof(struct spi_device_t));
+   if (NULL == dev)
+      return ESP_ERR_NO_MEM;
+
+   dev->config = *dev_config;
+   if (dev->config.queue_size > SIM_SPI_QUEUE)
+      dev->config.queue_size = SIM_SPI_QUEUE;
+   *handle = dev;
+   return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+   // Results still to be collected
+   if (0 != handle->queued)
+      return ESP_ERR_INVALID_STATE;
+
+   free(handle);
+   return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+   return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait)
+{
+   if (sim_in_isr())
+      return ESP_ERR_INVALID_STATE;
+
+   // A full queue waits for the oldest transaction to end
+   while ((handle->queued - handle->done) >= handle->config.queue_size)
+      sim_block(handle->ends[handle->done]);
+
+   // Nobody collected the results that much, the driver would block forever
+   if (handle->queued >= SIM_SPI_QUEUE)
+      return ESP_ERR_TIMEOUT;
+
+   uint64_t start = (handle->busy_until > sim_now) ? handle->busy_until : sim_now;
+   uint64_t clocks = trans_desc->length / spi_lanes(trans_desc);
+   uint64_t end = start + ((clocks * 1000000000ULL) / handle->config.clock_speed_hz);
+
+   handle->queue[handle->queued] = trans_desc;
+   handle->ends[handle->queued] = end;
+   handle->queued++;
+   handle->busy_until = end;
+   sim_schedule(end, spi_trans_end, handle);
+   return ESP_OK;
+}
+
+/*
+ * SPI peripherals driven directly, one DMA transfer at a time
+ */
+
+struct sim_spi_dma {
+   spi_dev_t *hw;
+   int source;
+   uint8_t *data;
+   size_t data_size;
+   uint32_t bits;
+   bool busy;
+};
+
+static struct sim_spi_dma spi_dmas[] = {
+   {.hw = &SPI2, .source = ETS_SPI2_INTR_SOURCE},
+   {.hw = &SPI3, .source = ETS_SPI3_INTR_SOURCE},
+};
+
+static void spi_dma_fault(const char *what, uint32_t value)
+{
+   if (0 == sim_faults++)
+      printf("SPI DMA %s %u at %llu ns\n", what, value, (unsigned long long)sim_now);
+}
+
+static void spi_dma_end(void *arg)
+{
+   struct sim_spi_dma *dma = (struct sim_spi_dma *)arg;
+
+   dma->busy = false;
+   sim_lanes = 1;
+   sim_panel_shift(dma->data, dma->bits, 1);
+
+   dma->hw->slave.trans_done = 1;
+   if (dma->hw->slave.trans_inten)
+      sim_intr_raise(dma->source);
+}
+
+void sim_spi_cmd(const volatile void *reg)
+{
+   struct sim_spi_dma *dma = (reg == (const volatile void *)&SPI2.cmd) ? &spi_dmas[0] : &spi_dmas[1];
+   spi_dev_t *hw = dma->hw;
+   uint32_t bits = hw->mosi_dlen.usr_mosi_dbitlen + 1;
+   size_t bytes = (bits + 7) / 8;
+
+   if (dma->busy)
+   {
+      spi_dma_fault("started while busy, bits", bits);
+      return;
+   }
+   if (!hw->user.usr_mosi || !hw->dma_out_link.start)
+   {
+      spi_dma_fault("started without an out link, bits", bits);
+      return;
+   }
+
+   if (dma->data_size < bytes)
+   {
+      free(dma->data);
+      dma->data = (uint8_t *)malloc(bytes);
+      dma->data_size = bytes;
+   }
+
+   // The descriptors are walked to the first one with eof set
+   const lldesc_t *desc = (const lldesc_t *)(uintptr_t)(SIM_DMA_BASE | hw->dma_out_link.addr);
+   size_t got = 0;
+   while (true)
+   {
+      if (!sim_dma_ram(desc) || !sim_dma_ram(desc->buf))
+      {
+         spi_dma_fault("descriptor or buffer outside DMA memory, after bytes", got);
+         return;
+      }
+
+      size_t length = desc->length;
+      if (got + length > bytes)
+         length = (got < bytes) ? bytes - got : 0;
+      memcpy(&dma->data[got], (const uint8_t *)desc->buf, length);
+      got += desc->length;
+      if (desc->eof)
+         break;
+      desc = desc->qe.stqe_next;
+   }
+   if (got != bytes)
+      spi_dma_fault("sends bits of a segment of bytes", got);
+
+   uint32_t clock = APB_CLK_FREQ / (hw->clock.clkcnt_n + 1);
+   dma->bits = bits;
+   dma->busy = true;
+   sim_schedule(sim_now + (((uint64_t)bits * 1000000000ULL) / clock), spi_dma_end, dma);
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc, TickType_t ticks_to_wait)
+{
+   if (0 == handle->queued)
+      return ESP_ERR_TIMEOUT;
+
+   if (0 == handle->done)
+      sim_block(handle->ends[0]);
+
+   *trans_desc = handle->queue[0];
+   memmove(&handle->queue[0], &handle->queue[1], (handle->queued - 1) * sizeof(handle->queue[0]));
+   memmove(&handle->ends[0], &handle->ends[1], (handle->queued - 1) * sizeof(handle->ends[0]));
+   handle->queued--;
+   handle->done--;
+   return ESP_OK;
+}
+
+/*
+ * RMT, only what driving one pin with a pulse train needs
+ */
+
+struct sim_rmt {
+   rmt_config_t config;
+   uint64_t busy_until;
+};
+
+static struct sim_rmt rmt_channels[RMT_CHANNEL_MAX];
+
+// Level changes ride on the event's argument, pin in the low byte
+static void rmt_edge(void *arg)
+{
+   uintptr_t edge = (uintptr_t)arg;
+   sim_gpio_set(edge & 0xff, (edge >> 8) & 1);
+}
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param)
+{
+   if ((rmt_param->channel >= RMT_CHANNEL_MAX) || (0 == rmt_param->clk_div))
+      return ESP_ERR_INVALID_ARG;
+
+   rmt_channels[rmt_param->channel].config = *rmt_param;
+   if (rmt_param->tx_config.idle_output_en)
+      sim_gpio_set(rmt_param->gpio_num, rmt_param->tx_config.idle_level);
+   return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags)
+{
+   return (channel < RMT_CHANNEL_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel)
+{
+   return (channel < RMT_CHANNEL_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done)
+{
+   if (channel >= RMT_CHANNEL_MAX)
+      return ESP_ERR_INVALID_ARG;
+
+   struct sim_rmt *rmt = &rmt_channels[channel];
+   uint32_t tick_ps = (1000000000000ULL / APB_CLK_FREQ) * rmt->config.clk_div;
+   uintptr_t pin = rmt->config.gpio_num;
+   uint64_t at = (rmt->busy_until > sim_now) ? rmt->busy_until : sim_now;
+   uint64_t ps = 0;
+
+   for (int item = 0; item < item_num; item++)
+   {
+      uint32_t durations[2] = {rmt_item[item].duration0, rmt_item[item].duration1};
+      uint32_t levels[2] = {rmt_item[item].level0, rmt_item[item].level1};
+      bool end = false;
+
+      for (uint8_t half = 0; half < 2; half++)
+      {
+         if (0 == durations[half])
+         {
+            end = true;
+            break;
+         }
+         sim_schedule(at + (ps / 1000), rmt_edge, (void *)(pin | (levels[half] << 8)));
+         ps += (uint64_t)durations[half] * tick_ps;
+      }
+      if (end)
+         break;
+   }
+
+   at += ps / 1000;
+   sim_schedule(at, rmt_edge, (void *)(pin | ((uintptr_t)rmt->config.tx_config.idle_level << 8)));
+   rmt->busy_until = at;
+
+   if (wait_tx_done)
+      rmt_wait_tx_done(channel, portMAX_DELAY);
+   return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time)
+{
+   if (channel >= RMT_CHANNEL_MAX)
+      return ESP_ERR_INVALID_ARG;
+
+   sim_block(rmt_channels[channel].busy_until);
+   return ESP_OK;
+}
+
+/*
+ * Timer groups, counting up from the APB clock
+ */
+
+struct sim_timer {
+   timer_config_t config;
+   bool running;
+   // Count when it last started or was loaded, and the time of that
+   uint64_t base;
+   uint64_t base_time;
+   uint64_t load;
+   uint64_t alarm;
+   bool alarm_en;
+   bool intr_en;
+   void (*fn)(void *arg);
+   void *arg;
+};
+
+static struct sim_timer timers[TIMER_GROUP_MAX][TIMER_MAX];
+
+static struct sim_timer *sim_timer_get(timer_group_t group_num, timer_idx_t timer_num)
+{
+   if ((group_num >= TIMER_GROUP_MAX) || (timer_num >= TIMER_MAX))
+      return NULL;
+   return &timers[group_num][timer_num];
+}
+
+static uint64_t sim_timer_count(const struct sim_timer *timer)
+{
+   if (!timer->running)
+      return timer->base;
+   return timer->base + (((sim_now - timer->base_time) * (APB_CLK_FREQ / 1000000)) / (1000ULL * timer->config.divider));
+}
+
+static void sim_timer_alarm(void *arg);
+
+// Schedules the alarm interrupt for when the count gets there
+static void sim_timer_arm(struct sim_timer *timer)
+{
+   if (!timer->running || !timer->alarm_en || !timer->intr_en || (NULL == timer->fn))
+      return;
+
+   uint64_t count = sim_timer_count(timer);
+   if (timer->alarm <= count)
+   {
+      // On the ESP32 it would only go off once the counter wraps
+      if (0 == sim_faults++)
+         printf("Timer alarm %llu set behind the count %llu\n", (unsigned long long)timer->alarm, (unsigned long long)count);
+      return;
+   }
+
+   uint64_t ticks = timer->alarm - timer->base;
+   uint64_t ns = ((ticks * 1000ULL * timer->config.divider) + (APB_CLK_FREQ / 1000000) - 1) / (APB_CLK_FREQ / 1000000);
+   sim_schedule(timer->base_time + ns, sim_timer_alarm, timer);
+}
+
+static void sim_timer_alarm(void *arg)
+{
+   struct sim_timer *timer = (struct sim_timer *)arg;
+
+   // Moved or turned off since this was scheduled
+   if (!timer->running || !timer->alarm_en || (sim_timer_count(timer) < timer->alarm))
+      return;
+
+   timer->alarm_en = false;
+   if (TIMER_AUTORELOAD_EN == timer->config.auto_reload)
+   {
+      timer->base = timer->load;
+      timer->base_time = sim_now;
+   }
+   timer->fn(timer->arg);
+}
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if ((NULL == timer) || (config->divider < 2) || (TIMER_COUNT_UP != config->counter_dir))
+      return ESP_ERR_INVALID_ARG;
+
+   memset(timer, 0, sizeof(*timer));
+   timer->config = *config;
+   timer->alarm_en = (TIMER_ALARM_EN == config->alarm_en);
+   timer->running = (TIMER_START == config->counter_en);
+   timer->base_time = sim_now;
+   return ESP_OK;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return ESP_ERR_INVALID_ARG;
+
+   timer->load = load_val;
+   timer->base = load_val;
+   timer->base_time = sim_now;
+   return ESP_OK;
+}
+
+esp_err_t timer_get_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *timer_val)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return ESP_ERR_INVALID_ARG;
+
+   *timer_val = sim_timer_count(timer);
+   return ESP_OK;
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return ESP_ERR_INVALID_ARG;
+
+   timer->alarm = alarm_value;
+   sim_timer_arm(timer);
+   return ESP_OK;
+}
+
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return ESP_ERR_INVALID_ARG;
+
+   timer->intr_en = true;
+   sim_timer_arm(timer);
+   return ESP_OK;
+}
+
+esp_err_t timer_isr_register(timer_group_t group_num, timer_idx_t timer_num, void (*fn)(void *), void *arg, int intr_alloc_flags, timer_isr_handle_t *handle)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if ((NULL == timer) || (NULL == fn))
+      return ESP_ERR_INVALID_ARG;
+
+   timer->fn = fn;
+   timer->arg = arg;
+   if (NULL != handle)
+      *handle = NULL;
+   sim_timer_arm(timer);
+   return ESP_OK;
+}
+
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return ESP_ERR_INVALID_ARG;
+
+   if (!timer->running)
+   {
+      timer->running = true;
+      timer->base_time = sim_now;
+      sim_timer_arm(timer);
+   }
+   return ESP_OK;
+}
+
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return ESP_ERR_INVALID_ARG;
+
+   timer->base = sim_timer_count(timer);
+   timer->base_time = sim_now;
+   timer->running = false;
+   return ESP_OK;
+}
+
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num)
+{
+   uint64_t count = 0;
+   timer_get_counter_value(group_num, timer_num, &count);
+   return count;
+}
+
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val)
+{
+   timer_set_alarm_value(group_num, timer_num, alarm_val);
+}
+
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num)
+{
+   struct sim_timer *timer = sim_timer_get(group_num, timer_num);
+   if (NULL == timer)
+      return;
+
+   timer->alarm_en = true;
+   sim_timer_arm(timer);
+}
+
+void timer_group_intr_clr_in_isr(timer_group_t group_num, timer_idx_t timer_num)
+{
+}
+
+/*
+ * Reset
+ */
+
+void sim_reset(void)
+{
+   sim_now = 0;
+   sim_blocked = 0;
+   sim_spun = 0;
+   sim_notify_value = 0;
+   sim_notified = false;
+   sim_isr_depth = 0;
+   sim_faults = 0;
+   sim_clashes = 0;
+   sim_lanes = 0;
+   sim_event_count = 0;
+   sim_event_order = 0;
+   memset(gpio_levels, 0, sizeof(gpio_levels));
+   memset(rmt_channels, 0, sizeof(rmt_channels));
+   memset(timers, 0, sizeof(timers));
+   intr_count = 0;
+   for (uint8_t idx = 0; idx < sizeof(spi_dmas) / sizeof(spi_dmas[0]); idx++)
+      spi_dmas[idx].busy = false;
+
+   if (NULL == psram)
+      psram = (uint8_t *)malloc(SIM_PSRAM_SIZE);
+   psram_used = 0;
+
+   if (NULL == dma_ram)
+   {
+      void *mem = mmap((void *)SIM_DMA_BASE, SIM_DMA_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+      if (mem != (void *)SIM_DMA_BASE)
+      {
+         printf("Can't map DMA memory at 0x%lx\n", SIM_DMA_BASE);
+         abort();
+      }
+      dma_ram = (uint8_t *)mem;
+   }
+   dma_ram_used = 0;
+   sim_memory_limit(SIM_DMA_SIZE, SIM_PSRAM_SIZE);
+
+   sim_panel_begin(NULL);
+}
@@ -0,0 +1,132 @@
+/****************************************************************
+ * Host simulator for PxMatrix
+ *
+ * Runs the driver against stand-in IDF drivers on a simulated clock.
+ * SPI transactions shift into a model of the panel's shift chain, the
+ * latch pin copies the chain to the outputs and while OE is low the row
+ * picked by the address pins lights up. The light every LED gives off is
+ * added up over time, so a test can compare the image the panel shows with
+ * what was drawn.
+ *
+ * Time only moves in the stand-ins: ets_delay_us, SPI waits, vTaskDelay,
+ * task notification waits, and every cycle count or esp_timer read costs
+ * sim_cpu_step_ns. Anything due in the meantime (end of an SPI transaction
+ * and its post callback, end of an SPI DMA transfer and its interrupt, RMT
+ * edges, timer alarms) runs when the clock passes it, as an interrupt would.
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef SIM_H__
+#define SIM_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// How the shift chain of a scan row runs over the panel. Positions are
+// counted from the data input, red first, then green, then blue. Within a
+// colour SIM_LINE runs across the panel right to left, one row of every
+// sector after the other. SIM_ZIGZAG takes every pair of sectors 8 pixels
+// at a time, 8 of the lower sector and then the 8 above them. SIM_ZAGGIZ takes 8 pixels of every
+// sector in a group of 8 rows in turn, and pixels of the first 4 rows of
+// every 8 are wired back to front
+enum sim_wirings {SIM_LINE, SIM_ZIGZAG, SIM_ZAGGIZ};
+
+struct sim_panel_config {
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+   enum sim_wirings wiring;
+   uint8_t latch_pin;
+   uint8_t oe_pin;
+   // A first, as many as the row pattern needs
+   uint8_t address_pins[5];
+};
+
+// Time charged for every cycle count or esp_timer read, in nanoseconds
+extern uint32_t sim_cpu_step_ns;
+
+// Back to time 0 with nothing in flight, no panel or interrupts and the
+// PSRAM and DMA arenas empty
+void sim_reset(void);
+
+// Shrinks the DMA and PSRAM arenas to that many bytes, 0 leaves none.
+// sim_reset gives them their full size back
+void sim_memory_limit(size_t dma, size_t psram);
+
+// Simulated time in nanoseconds
+uint64_t sim_time_ns(void);
+
+// Time the driver spent blocked, when another task could have run, and
+// busy waiting in ets_delay_us
+uint64_t sim_blocked_ns(void);
+uint64_t sim_spun_ns(void);
+
+// Moves the clock on, running everything that falls due
+void sim_advance(uint64_t ns);
+
+// Runs fn(arg) at time ns, as an interrupt. Returns false when the queue
+// is full
+bool sim_schedule(uint64_t ns, void (*fn)(void *arg), void *arg);
+
+// True while a scheduled function runs
+bool sim_in_isr(void);
+
+// Calls made from a scheduled function that an IRAM interrupt handler
+// mustn't make: waits and drivers living in flash, and interrupts raised
+// that weren't allocated in IRAM. Also timer alarms set behind the count,
+// which the ESP32 only fires once the counter wraps, and SPI DMA transfers
+// started while busy, from memory the DMA can't reach or longer or shorter
+// than their descriptors. The first one is printed
+uint32_t sim_isr_faults(void);
+
+// SPI bus pins set up on a pin the panel uses, the first one is printed
+uint32_t sim_spi_clashes(void);
+
+// Lanes of the last SPI transaction to end, 0 before the first
+uint8_t sim_spi_lanes(void);
+
+// Wires up a panel of the given size and layout, all LEDs dark
+void sim_panel_begin(const struct sim_panel_config *config);
+
+// Forgets the light given off so far
+void sim_panel_clear(void);
+
+// Nanoseconds the LED of colour channel (0 red, 1 green, 2 blue) at x, y
+// has been lit since the last clear
+uint64_t sim_panel_light(uint16_t x, uint16_t y, uint8_t channel);
+
+// Nanoseconds OE was active with scan row selected since the last clear.
+// An LED lit for all of it shows full brightness
+uint64_t sim_panel_row_time(uint8_t row);
+
+// Level 0 to 255 the LED shows, its light over the time its row was on
+uint8_t sim_panel_level(uint16_t x, uint16_t y, uint8_t channel);
+
+// Whether the latch, OE or an address pin the row pattern needs is pin
+bool sim_panel_uses_pin(uint8_t pin);
+
+// Latch pulses and the ones taken while OE was active, which flash the
+// half shifted or previous row. Also address changes while OE was active
+uint32_t sim_panel_latches(void);
+uint32_t sim_panel_ghosts(void);
+
+// Bits shifted into the panel since sim_panel_begin
+uint64_t sim_panel_bits(void);
+
+// Called by the stand-ins. Lanes is 1 or 4, a quad transfer splits the
+// chain in four and lane n feeds the quarter the nth quarter of a single
+// lane row would have ended up in
+void sim_panel_shift(const uint8_t *data, uint32_t bits, uint8_t lanes);
+void sim_panel_pin(uint8_t pin, uint32_t level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+/****************************************************************
+ * Checks for the host tests
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef TEST_H__
+#define TEST_H__
+#include <stdio.h>
+
+// Failures past this are counted but not printed
+#ifndef TEST_MAX_PRINTED
+#define TEST_MAX_PRINTED 20
+#endif
+
+static int test_checks;
+static int test_failures;
+
+#define CHECK(cond, ...) do {                                           \
+      test_checks++;                                                    \
+      if (!(cond) && (test_failures++ < TEST_MAX_PRINTED)) {            \
+         printf("%s:%d: ", __FILE__, __LINE__);                         \
+         printf(__VA_ARGS__);                                           \
+         printf("\n");                                                  \
+      }                                                                 \
+   } while (0)
+
+// Prints how it went, the result is the exit code of the test
+static inline int test_summary(const char *name)
+{
+   printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+   return test_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,917 @@
+/****************************************************************
+ * Draws the same frames into PxMatrix by different routes and compares
+ * the encoded buffers byte for byte
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PxMatrix.h"
+#include "PxMatrixT.h"
+#include "sim.h"
+#include "test.h"
+
+// Pins of the board config
+#define PIN_LATCH 26
+#define PIN_OE 21
+#define PIN_A 27
+#define PIN_B 17
+#define PIN_C 25
+#define PIN_D 5
+#define PIN_E 15
+
+// Opens up the buffer being drawn
+template <class Matrix>
+class Probe : public Matrix {
+public:
+   using Matrix::Matrix;
+
+   const uint8_t *drawn()
+   {
+      return this->buffer[this->_draw_buffer];
+   }
+
+   // Planes past the depth aren't shown
+   size_t drawn_size()
+   {
+      return (size_t)this->_buffer_size * this->_color_depth;
+   }
+
+   // Map entry of a canvas pixel and the one worked out from scratch
+   uint32_t mapped(int16_t x, int16_t y)
+   {
+      return this->_pixel_map[(y * this->width()) + x];
+   }
+
+   uint32_t computed(int16_t x, int16_t y)
+   {
+      return this->compute_pixel(x, y);
+   }
+
+   bool map_filled()
+   {
+      return this->_pixel_map_filled;
+   }
+
+   // Every buffer, and which one is drawn into
+   const uint8_t *buffer_at(uint8_t idx)
+   {
+      return this->buffer[idx];
+   }
+
+   uint8_t draw_index()
+   {
+      return this->_draw_buffer;
+   }
+
+   uint8_t dither_phase()
+   {
+      return this->_dither_frame;
+   }
+
+   // One streamed row of one plane, as display() sends it
+   void stream_row(uint8_t plane, uint8_t row, uint8_t *out)
+   {
+      this->encode_stream_row(plane, row, out);
+   }
+
+   size_t row_size()
+   {
+      return this->_send_buffer_size;
+   }
+};
+
+typedef Probe<PxMatrix> probe;
+
+struct layout {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+};
+
+static const layout layouts[] = {
+   {"32x16 4", 32, 16, 4},
+   {"32x16 8", 32, 16, 8},
+   {"64x32 16", 64, 32, 16},
+   {"64x64 32", 64, 64, 32},
+};
+
+static probe *create(const layout &l)
+{
+   return new probe(l.width, l.height, PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+}
+
+// Every level, different in each channel
+static void ramp_colour(int16_t x, int16_t y, uint8_t *rgb)
+{
+   rgb[0] = (x * 8) + (y * 37);
+   rgb[1] = (x * 13) + (y * 5) + 100;
+   rgb[2] = 255 - ((x * 3) + (y * 11));
+}
+
+static void draw_ramp(PxMatrix *matrix)
+{
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         uint8_t rgb[3];
+         ramp_colour(x, y, rgb);
+         matrix->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+      }
+   }
+}
+
+template <class A, class B>
+static bool same_buffers(A *a, B *b)
+{
+   return (a->drawn_size() == b->drawn_size()) && (0 == memcmp(a->drawn(), b->drawn(), a->drawn_size()));
+}
+
+// The scan patterns written out as tables, as the header describes them
+static pxmatrix_scan_table scan_table(scan_patterns scan, uint8_t row_pattern)
+{
+   pxmatrix_scan_table table;
+   memset(&table, 0, sizeof(table));
+   table.block_width = 8;
+   table.columns = 1;
+   table.rows = row_pattern;
+
+   if (ZIGZAG == scan)
+   {
+      // The lower sector's byte follows the upper one's
+      table.rows = row_pattern * 2;
+      for (uint8_t row = 0; row < row_pattern; row++)
+         table.entries[row] = 1;
+   }
+   else if (ZAGGIZ == scan)
+   {
+      // Rows 0 to 3 of every 8 back to front
+      table.rows = (row_pattern < 8) ? 8 : row_pattern;
+      for (uint8_t row = 0; row < table.rows; row++)
+         table.entries[row] = (row / row_pattern) | (((row % 8) < 4) ? PXMATRIX_SCAN_REVERSE : 0);
+   }
+   return table;
+}
+
+// A CUSTOM table describing a scan pattern encodes the same as the pattern
+static void check_scan_tables(const layout &l)
+{
+   static const scan_patterns scans[] = {LINE, ZIGZAG, ZAGGIZ};
+
+   for (scan_patterns scan : scans)
+   {
+      sim_reset();
+      probe *pattern = create(l);
+      probe *custom = create(l);
+      pattern->setScanPattern(scan);
+      pattern->begin(l.row_pattern, BCM);
+      pattern->setScanPattern(scan);
+      pxmatrix_scan_table table = scan_table(scan, l.row_pattern);
+      CHECK(custom->setScanTable(&table), "%s scan %d: table refused before begin", l.name, scan);
+      CHECK(custom->begin(l.row_pattern, BCM), "%s scan %d: begin failed with the table", l.name, scan);
+
+      draw_ramp(pattern);
+      draw_ramp(custom);
+      CHECK(same_buffers(pattern, custom), "%s scan %d: table encodes differently", l.name, scan);
+
+      // Loaded after begin too
+      custom->clearDisplay();
+      CHECK(custom->setScanPattern(LINE), "%s scan %d: LINE refused", l.name, scan);
+      CHECK(custom->setScanTable(&table), "%s scan %d: table refused after begin", l.name, scan);
+      draw_ramp(custom);
+      CHECK(same_buffers(pattern, custom), "%s scan %d: table loaded after begin encodes differently", l.name, scan);
+
+      delete pattern;
+      delete custom;
+   }
+
+   // LINE as bands two blocks wide
+   sim_reset();
+   probe *pattern = create(l);
+   probe *custom = create(l);
+   pattern->setScanPattern(LINE);
+   pattern->begin(l.row_pattern, BCM);
+   pattern->setScanPattern(LINE);
+   pxmatrix_scan_table table = scan_table(LINE, l.row_pattern);
+   table.columns = 2;
+   for (uint8_t row = 0; row < table.rows; row++)
+   {
+      table.entries[row * 2] = 0;
+      table.entries[(row * 2) + 1] = 1;
+   }
+   CHECK(custom->setScanTable(&table), "%s: two column table refused", l.name);
+   CHECK(custom->begin(l.row_pattern, BCM), "%s: begin failed with two columns", l.name);
+   draw_ramp(pattern);
+   draw_ramp(custom);
+   CHECK(same_buffers(pattern, custom), "%s: two column table encodes differently", l.name);
+   delete pattern;
+   delete custom;
+}
+
+// Tables that don't cover every block of a scan row once are turned down,
+// the pattern before stays
+static void check_bad_scan_tables(const layout &l)
+{
+   pxmatrix_scan_table good = scan_table(ZAGGIZ, l.row_pattern);
+   pxmatrix_scan_table bad[7];
+   for (pxmatrix_scan_table &table : bad)
+      table = good;
+
+   // Nothing in it
+   bad[0].rows = 0;
+   // More entries than fit
+   bad[1].columns = 2;
+   bad[1].rows = 128;
+   // Both sectors on the same block
+   bad[2] = scan_table(ZIGZAG, l.row_pattern);
+   bad[2].entries[l.row_pattern] = 1;
+   // A block past the band
+   bad[3].entries[1] = 2;
+   // Not a whole number of scan rows
+   bad[4].rows = l.row_pattern + 1;
+   // Bands don't stack up to the height
+   bad[5].rows = l.row_pattern * 3;
+   for (uint8_t row = 0; row < bad[5].rows; row++)
+      bad[5].entries[row] = row / l.row_pattern;
+   // Nor across the width
+   bad[6].block_width = 24;
+
+   for (uint8_t idx = 0; idx < sizeof(bad) / sizeof(bad[0]); idx++)
+   {
+      sim_reset();
+      probe *pattern = create(l);
+      probe *custom = create(l);
+      pattern->begin(l.row_pattern, BCM);
+      pattern->setScanPattern(ZIGZAG);
+      custom->begin(l.row_pattern, BCM);
+      custom->setScanPattern(ZIGZAG);
+
+      CHECK(!custom->setScanTable(&bad[idx]), "%s: bad table %d taken after begin", l.name, idx);
+      draw_ramp(pattern);
+      draw_ramp(custom);
+      CHECK(same_buffers(pattern, custom), "%s: bad table %d changed the scan pattern", l.name, idx);
+      delete pattern;
+      delete custom;
+
+      // Before begin it only shows then, if the fields make sense at all
+      sim_reset();
+      custom = create(l);
+      if (custom->setScanTable(&bad[idx]))
+         CHECK(!custom->begin(l.row_pattern, BCM), "%s: began with bad table %d", l.name, idx);
+      delete custom;
+   }
+}
+
+// Source pixels as RGB565 and the RGB888 the driver widens them to, with
+// PAD pixels of border all round so rects can hang off the canvas
+#define PAD 8
+
+struct frame {
+   uint16_t stride;
+   uint16_t *rgb565;
+   uint8_t *rgb888;
+};
+
+static uint32_t random_state = 1;
+
+static uint32_t next_random()
+{
+   random_state = (random_state * 1103515245u) + 12345u;
+   return random_state >> 8;
+}
+
+static frame random_frame(uint16_t width, uint16_t height)
+{
+   frame f;
+   f.stride = width + (2 * PAD);
+   uint32_t pixels = (uint32_t)f.stride * (height + (2 * PAD));
+   f.rgb565 = (uint16_t *)malloc(pixels * sizeof(uint16_t));
+   f.rgb888 = (uint8_t *)malloc(pixels * 3);
+   for (uint32_t idx = 0; idx < pixels; idx++)
+   {
+      uint16_t color = next_random();
+      f.rgb565[idx] = color;
+      f.rgb888[idx * 3] = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
+      f.rgb888[idx * 3 + 1] = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
+      f.rgb888[idx * 3 + 2] = (((color & 0x1F) * 527) + 23) >> 6;
+   }
+   return f;
+}
+
+static void free_frame(frame &f)
+{
+   free(f.rgb565);
+   free(f.rgb888);
+}
+
+// Offset of canvas pixel x, y in a frame
+static uint32_t at(const frame &f, int16_t x, int16_t y)
+{
+   return ((uint32_t)(y + PAD) * f.stride) + x + PAD;
+}
+
+// A panel set up one of the ways that changes where pixels land
+struct variant {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+   bool rotate;
+   uint8_t tiles_x;
+   tile_rotations rotations[2];
+};
+
+static const variant variants[] = {
+   {"32x16 8", 32, 16, 8},
+   {"64x32 16", 64, 32, 16},
+   {"32x16 4", 32, 16, 4},
+   {"32x16 8 rotated", 32, 16, 8, true},
+   {"64x32 16 rotated", 64, 32, 16, true},
+   {"2 tiles of 32x16, second at 180", 64, 16, 8, false, 2, {TILE_0, TILE_180}},
+   {"2 tiles of 32x32, first at 90", 64, 32, 16, false, 2, {TILE_90, TILE_0}},
+   {"2 tiles of 32x32 at 270 and 180, rotated", 64, 32, 16, true, 2, {TILE_270, TILE_180}},
+};
+
+static probe *start(const variant &v, scan_patterns scan, color_modes color_mode, bool shadow = false, bool triple_buffer = false)
+{
+   probe *matrix = new probe(v.width, v.height, PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+   matrix->setShadow(shadow);
+   matrix->setTripleBuffer(triple_buffer);
+   CHECK(matrix->begin(v.row_pattern, color_mode), "%s: begin failed", v.name);
+   CHECK(matrix->setScanPattern(scan), "%s: scan %d refused", v.name, scan);
+   if (v.tiles_x)
+   {
+      matrix->setTileLayout(v.tiles_x, 1, TILE_ROW_MAJOR);
+      for (uint8_t tile = 0; tile < v.tiles_x; tile++)
+         matrix->setTileRotation(tile, v.rotations[tile]);
+   }
+   matrix->setRotate(v.rotate);
+   return matrix;
+}
+
+// Cuts of a canvas side into rects, from off one edge to off the other and
+// mostly not on a byte
+static void cuts(int16_t size, int16_t *edges)
+{
+   edges[0] = -PAD;
+   edges[1] = 3;
+   edges[2] = 13;
+   edges[3] = (size / 2) + 1;
+   edges[4] = size + PAD;
+}
+
+// The frame drawn with drawRectRGB565 or drawRectRGB888, in rects clipped
+// at the canvas edges, and some that miss it altogether
+static void draw_rects(PxMatrix *matrix, const frame &f, bool rgb565)
+{
+   int16_t xs[5], ys[5];
+   cuts(matrix->width(), xs);
+   cuts(matrix->height(), ys);
+
+   for (uint8_t row = 0; row < 4; row++)
+   {
+      for (uint8_t column = 0; column < 4; column++)
+      {
+         int16_t x = xs[column];
+         int16_t y = ys[row];
+         int16_t w = xs[column + 1] - x;
+         int16_t h = ys[row + 1] - y;
+         if (rgb565)
+            matrix->drawRectRGB565(x, y, w, h, &f.rgb565[at(f, x, y)], f.stride);
+         else
+            matrix->drawRectRGB888(x, y, w, h, &f.rgb888[at(f, x, y) * 3], f.stride);
+      }
+   }
+
+   // Off every side, and empty
+   const int16_t misses[][4] = {
+      {-PAD, -PAD, PAD, PAD}, {(int16_t)matrix->width(), 0, PAD, 4}, {0, (int16_t)matrix->height(), 4, PAD}, {2, 2, 0, 5}, {2, 2, 5, -1},
+   };
+   for (const int16_t *miss : misses)
+   {
+      if (rgb565)
+         matrix->drawRectRGB565(miss[0], miss[1], miss[2], miss[3], f.rgb565, f.stride);
+      else
+         matrix->drawRectRGB888(miss[0], miss[1], miss[2], miss[3], f.rgb888, f.stride);
+   }
+}
+
+// Every way of drawing a frame encodes the same bytes as drawing it a pixel
+// at a time
+static void check_blits(const variant &v, scan_patterns scan, color_modes color_mode)
+{
+   sim_reset();
+   probe *golden = start(v, scan, color_mode);
+   frame f = random_frame(golden->width(), golden->height());
+   for (int16_t y = 0; y < golden->height(); y++)
+   {
+      for (int16_t x = 0; x < golden->width(); x++)
+      {
+         const uint8_t *rgb = &f.rgb888[at(f, x, y) * 3];
+         golden->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+      }
+   }
+
+   const char *routes[] = {"drawFrameRGB888", "drawFrameRGB565", "drawRectRGB888", "drawRectRGB565"};
+   for (uint8_t route = 0; route < 4; route++)
+   {
+      probe *matrix = start(v, scan, color_mode);
+      if (0 == route)
+         matrix->drawFrameRGB888(&f.rgb888[at(f, 0, 0) * 3], f.stride);
+      else if (1 == route)
+         matrix->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+      else
+         draw_rects(matrix, f, 3 == route);
+
+      CHECK(same_buffers(golden, matrix), "%s scan %d mode %d: %s encodes differently", v.name, scan, color_mode, routes[route]);
+      delete matrix;
+   }
+
+   delete golden;
+   free_frame(f);
+}
+
+static void hand_over(probe *matrix, bool triple_buffer)
+{
+   if (triple_buffer)
+      matrix->present();
+   else
+      matrix->swapBuffer();
+}
+
+// fillRect encodes the same as filling the clipped rect pixel by pixel, on
+// a frame already drawn, from any column in a byte to any other and hanging
+// off any edge
+static void check_fills(const variant &v, scan_patterns scan, color_modes color_mode)
+{
+   sim_reset();
+   probe *golden = start(v, scan, color_mode);
+   probe *matrix = start(v, scan, color_mode);
+   int16_t width = matrix->width();
+   int16_t height = matrix->height();
+   frame f = random_frame(width, height);
+   golden->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+   matrix->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+
+   const int16_t xs[] = {-9, -1, 0, 1, 3, 7, 8, 9, 13, (int16_t)(width - 5), (int16_t)(width - 1), width, (int16_t)(width + 3)};
+   const int16_t ws[] = {-3, 0, 1, 2, 5, 7, 8, 9, 15, 16, 17, (int16_t)(width + 20)};
+   const int16_t ys[][2] = {{-4, 6}, {0, 1}, {3, 5}, {(int16_t)(height - 2), 4}, {height, 2}, {-10, 3}, {0, height}};
+   uint32_t differ = 0;
+   uint32_t fills = 0;
+
+   for (const int16_t *yh : ys)
+   {
+      for (int16_t x : xs)
+      {
+         for (int16_t w : ws)
+         {
+            uint32_t color = next_random();
+            uint8_t r = color;
+            uint8_t g = color >> 8;
+            uint8_t b = color >> 16;
+
+            matrix->fillRect(x, yh[0], w, yh[1], r, g, b);
+            for (int16_t y = yh[0]; y < yh[0] + yh[1]; y++)
+            {
+               for (int16_t xx = x; xx < x + w; xx++)
+               {
+                  if ((xx >= 0) && (xx < width) && (y >= 0) && (y < height))
+                     golden->drawPixelRGB888(xx, y, r, g, b);
+               }
+            }
+
+            fills++;
+            if (!same_buffers(golden, matrix))
+            {
+               differ++;
+               CHECK(false, "%s scan %d mode %d: fillRect(%d, %d, %d, %d) encodes differently", v.name, scan, color_mode,
+                     x, yh[0], w, yh[1]);
+               memcpy((uint8_t *)matrix->drawn(), golden->drawn(), golden->drawn_size());
+            }
+         }
+      }
+   }
+   CHECK(0 == differ, "%s scan %d mode %d: %u of %u fills differ", v.name, scan, color_mode, differ, fills);
+
+   free_frame(f);
+   delete golden;
+   delete matrix;
+}
+
+// Hands the draw buffer over and checks the one drawn next was encoded
+// again from its shadow as golden draws
+static void check_handed_back(probe *matrix, probe *golden, bool triple_buffer, const char *name)
+{
+   hand_over(matrix, triple_buffer);
+   CHECK(same_buffers(golden, matrix), "%s: buffer %d handed back as it was encoded", name, matrix->draw_index());
+}
+
+// The frame in every buffer, a colour cycle after each hand over takes it
+// up. Double buffering then shows the buffer drawn into
+static void fill_buffers(probe *matrix, const frame &f, bool triple_buffer)
+{
+   uint8_t buffers = triple_buffer ? 3 : 2;
+   for (uint8_t idx = 0; idx <= buffers; idx++)
+   {
+      matrix->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+      if (idx < buffers)
+         hand_over(matrix, triple_buffer);
+      for (uint8_t plane = 0; plane < matrix->getColorDepth(); plane++)
+         matrix->display(10);
+   }
+}
+
+// Colour offset and depth changes encode the draw buffer again from its
+// shadow as if drawn afresh, leave the buffers that may be shown alone and
+// catch them up as they come back for drawing. getPixel reads the shadow
+static void check_encode_again(const variant &v, color_modes color_mode, bool triple_buffer)
+{
+   sim_reset();
+   probe *matrix = start(v, ZAGGIZ, color_mode, true, triple_buffer);
+   frame f = random_frame(matrix->width(), matrix->height());
+   uint8_t buffers = triple_buffer ? 3 : 2;
+   size_t size = matrix->drawn_size();
+   uint8_t *before = (uint8_t *)malloc(size * buffers);
+   char name[96];
+   snprintf(name, sizeof(name), "%s mode %d%s", v.name, color_mode, triple_buffer ? " triple buffer" : "");
+
+   fill_buffers(matrix, f, triple_buffer);
+
+   static const struct {
+      const char *what;
+      uint8_t offset[3];
+      uint8_t depth;
+   } changes[] = {
+      {"colour offset", {40, 20, 60}, PXMATRIX_COLOR_DEPTH},
+      {"depth", {40, 20, 60}, 5},
+      {"offset at depth 5", {0, 70, 10}, 5},
+   };
+
+   for (const auto &change : changes)
+   {
+      for (uint8_t idx = 0; idx < buffers; idx++)
+         memcpy(&before[idx * size], matrix->buffer_at(idx), size);
+      uint8_t drawn_before = matrix->draw_index();
+
+      if (change.depth != matrix->getColorDepth())
+         CHECK(matrix->setColorDepth(change.depth), "%s: depth %u refused", name, change.depth);
+      else
+         matrix->setColorOffset(change.offset[0], change.offset[1], change.offset[2]);
+
+      probe *golden = start(v, ZAGGIZ, color_mode);
+      golden->setColorDepth(change.depth);
+      golden->setColorOffset(change.offset[0], change.offset[1], change.offset[2]);
+      golden->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+      CHECK(same_buffers(golden, matrix), "%s: %s encodes the draw buffer differently", name, change.what);
+
+      // Only a buffer that can't be shown until the next hand over changed
+      for (uint8_t idx = 0; idx < buffers; idx++)
+      {
+         if (idx != matrix->draw_index())
+            CHECK(0 == memcmp(&before[idx * size], matrix->buffer_at(idx), size), "%s: %s encoded buffer %d, drawing %d",
+                  name, change.what, idx, matrix->draw_index());
+      }
+      if (!triple_buffer)
+         CHECK(matrix->draw_index() != drawn_before, "%s: %s encoded the buffer shown", name, change.what);
+
+      for (int16_t y = 0; y < matrix->height(); y++)
+      {
+         for (int16_t x = 0; x < matrix->width(); x++)
+         {
+            uint16_t want = f.rgb565[at(f, x, y)];
+            CHECK(want == matrix->getPixel(x, y), "%s: %s, %d,%d reads %04x, drawn %04x", name, change.what, x, y,
+                  matrix->getPixel(x, y), want);
+         }
+      }
+
+      // Show the buffer drawn into again, then take every buffer back
+      for (uint8_t plane = 0; plane < matrix->getColorDepth(); plane++)
+         matrix->display(10);
+      for (uint8_t idx = 0; idx < buffers; idx++)
+         check_handed_back(matrix, golden, triple_buffer, name);
+      for (uint8_t plane = 0; plane < PXMATRIX_COLOR_DEPTH; plane++)
+         matrix->display(10);
+      delete golden;
+   }
+
+   free(before);
+   free_frame(f);
+   delete matrix;
+}
+
+// display() only counts colour cycles for dithering, the buffers stay as
+// they were encoded. A buffer handed back for drawing is encoded again with
+// the next phase, once a cycle has gone by
+static void check_dither_phase(const variant &v, bool triple_buffer)
+{
+   sim_reset();
+   probe *matrix = start(v, ZAGGIZ, THRESHOLD, true, triple_buffer);
+   matrix->setDither(true);
+   frame f = random_frame(matrix->width(), matrix->height());
+   uint8_t buffers = triple_buffer ? 3 : 2;
+   size_t size = matrix->drawn_size();
+   uint8_t *before = (uint8_t *)malloc(size * buffers);
+   char name[96];
+   snprintf(name, sizeof(name), "%s dither%s", v.name, triple_buffer ? " triple buffer" : "");
+
+   fill_buffers(matrix, f, triple_buffer);
+   for (uint8_t idx = 0; idx < buffers; idx++)
+      memcpy(&before[idx * size], matrix->buffer_at(idx), size);
+   uint8_t phase = matrix->dither_phase();
+
+   for (uint8_t plane = 0; plane < 3 * PXMATRIX_COLOR_DEPTH; plane++)
+      matrix->display(10);
+   for (uint8_t idx = 0; idx < buffers; idx++)
+      CHECK(0 == memcmp(&before[idx * size], matrix->buffer_at(idx), size), "%s: buffer %d changed by display", name, idx);
+   CHECK(phase == matrix->dither_phase(), "%s: phase %u moved to %u without a hand over", name, phase, matrix->dither_phase());
+
+   hand_over(matrix, triple_buffer);
+   uint8_t drawn = matrix->draw_index();
+   CHECK((uint8_t)(phase + 1) == matrix->dither_phase(), "%s: phase %u after a hand over from %u", name, matrix->dither_phase(), phase);
+   CHECK(0 != memcmp(&before[drawn * size], matrix->buffer_at(drawn), size), "%s: buffer %d handed back in the old phase", name, drawn);
+
+   // No cycle shown since
+   hand_over(matrix, triple_buffer);
+   CHECK((uint8_t)(phase + 1) == matrix->dither_phase(), "%s: phase %u after a hand over with no cycle shown", name, matrix->dither_phase());
+
+   free(before);
+   free_frame(f);
+   delete matrix;
+}
+
+// A streamed panel scrolled over a virtual canvas bigger than it sends the
+// same rows as one the size of the panel with the visible window drawn
+// straight in, wherever the viewport wraps round the canvas edges. Canvas
+// sizes are after rotation, so it is set first
+static void check_viewport(const variant &v, color_modes color_mode, bool indexed)
+{
+   uint16_t panel_width = v.rotate ? v.height : v.width;
+   uint16_t panel_height = v.rotate ? v.width : v.height;
+   const struct {
+      uint16_t extra_width;
+      uint16_t extra_height;
+   } canvases[] = {{13, 7}, {panel_width, panel_height}};
+
+   for (const auto &canvas : canvases)
+   {
+      uint16_t canvas_width = panel_width + canvas.extra_width;
+      uint16_t canvas_height = panel_height + canvas.extra_height;
+      int16_t viewports[][2] = {
+         {0, 0}, {5, 3}, {(int16_t)(canvas_width - 3), (int16_t)(canvas_height - 2)},
+         {(int16_t)(canvas_width - 1), 0}, {-4, -1}, {(int16_t)(canvas_width + 6), (int16_t)(2 * canvas_height + 1)},
+      };
+
+      sim_reset();
+      probe *scrolled = new probe(v.width, v.height, PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+      scrolled->setVirtualSize(canvas_width, canvas_height);
+      scrolled->setIndexed(indexed);
+      scrolled->setRotate(v.rotate);
+      CHECK(scrolled->begin(v.row_pattern, color_mode), "%s: begin failed on a virtual canvas", v.name);
+      CHECK(canvas_width == scrolled->virtualWidth() && canvas_height == scrolled->virtualHeight(), "%s: canvas %ux%u, asked for %ux%u",
+            v.name, scrolled->virtualWidth(), scrolled->virtualHeight(), canvas_width, canvas_height);
+
+      frame f = random_frame(canvas_width, canvas_height);
+      for (int16_t y = 0; y < canvas_height; y++)
+      {
+         for (int16_t x = 0; x < canvas_width; x++)
+         {
+            const uint8_t *rgb = &f.rgb888[at(f, x, y) * 3];
+            scrolled->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+         }
+      }
+
+      size_t size = scrolled->row_size();
+      uint8_t *want = (uint8_t *)malloc(size);
+      uint8_t *got = (uint8_t *)malloc(size);
+
+      for (const int16_t *viewport : viewports)
+      {
+         probe *direct = new probe(v.width, v.height, PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+         direct->setStreaming(true);
+         direct->setIndexed(indexed);
+         direct->setRotate(v.rotate);
+         CHECK(direct->begin(v.row_pattern, color_mode), "%s: begin failed", v.name);
+
+         int16_t from_x = ((viewport[0] % canvas_width) + canvas_width) % canvas_width;
+         int16_t from_y = ((viewport[1] % canvas_height) + canvas_height) % canvas_height;
+         for (int16_t y = 0; y < direct->height(); y++)
+         {
+            for (int16_t x = 0; x < direct->width(); x++)
+            {
+               const uint8_t *rgb = &f.rgb888[at(f, (from_x + x) % canvas_width, (from_y + y) % canvas_height) * 3];
+               direct->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+            }
+         }
+
+         // Taken up as a colour cycle starts
+         scrolled->setViewport(viewport[0], viewport[1]);
+         scrolled->display(10);
+
+         uint32_t differ = 0;
+         for (uint8_t plane = 0; plane < scrolled->getColorDepth(); plane++)
+         {
+            for (uint8_t row = 0; row < v.row_pattern; row++)
+            {
+               direct->stream_row(plane, row, want);
+               scrolled->stream_row(plane, row, got);
+               if (0 != memcmp(want, got, size))
+                  differ++;
+            }
+         }
+         CHECK(0 == differ, "%s mode %d%s: %u rows differ on a %ux%u canvas from %d,%d", v.name, color_mode,
+               indexed ? " indexed" : "", differ, canvas_width, canvas_height, viewport[0], viewport[1]);
+
+         // The rest of the cycle, the next one takes the next viewport
+         for (uint8_t plane = 1; plane < scrolled->getColorDepth(); plane++)
+            scrolled->display(10);
+         delete direct;
+      }
+
+      // Turning a panel that isn't square would leave it hanging off the
+      // canvas sized for it at begin
+      if ((v.width != v.height) && ((canvas_width < panel_height) || (canvas_height < panel_width)))
+      {
+         scrolled->setRotate(!v.rotate);
+         CHECK(panel_width == scrolled->width(), "%s: turned off a %ux%u canvas", v.name, canvas_width, canvas_height);
+      }
+
+      free(want);
+      free(got);
+      free_frame(f);
+      delete scrolled;
+   }
+}
+
+// The map holds what compute_pixel works out for every pixel, and puts every
+// pixel on its own bit of the red plane
+static void check_map_matches(probe *matrix, const char *name, const char *step)
+{
+   uint32_t plane_bits = (uint32_t)matrix->drawn_size() / PXMATRIX_COLOR_DEPTH * 8;
+   uint8_t *used = (uint8_t *)calloc(plane_bits / 8, 1);
+   bool mismatch = false;
+   bool shared = false;
+
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         uint32_t entry = matrix->mapped(x, y);
+         mismatch |= (entry != matrix->computed(x, y));
+         if ((entry >> 3) >= (plane_bits / 8))
+         {
+            shared = true;
+            continue;
+         }
+         shared |= (0 != (used[entry >> 3] & (1 << (entry & 7))));
+         used[entry >> 3] |= 1 << (entry & 7);
+      }
+   }
+   CHECK(!mismatch, "%s %s: map differs from compute_pixel", name, step);
+   CHECK(!shared, "%s %s: pixels share a bit or land outside the plane", name, step);
+   free(used);
+}
+
+// After every change that moves pixels
+static void check_map(const layout &l)
+{
+   static const scan_patterns scans[] = {LINE, ZIGZAG, ZAGGIZ};
+
+   for (scan_patterns scan : scans)
+   {
+      sim_reset();
+      probe *matrix = create(l);
+      matrix->begin(l.row_pattern, BCM);
+      CHECK(matrix->setScanPattern(scan), "%s: scan %d refused", l.name, scan);
+      check_map_matches(matrix, l.name, "begin");
+
+      matrix->setRotate(true);
+      check_map_matches(matrix, l.name, "rotated");
+      matrix->setRotate(false);
+      check_map_matches(matrix, l.name, "rotated back");
+
+      matrix->setTileLayout(2, 1, TILE_ROW_MAJOR);
+      check_map_matches(matrix, l.name, "2x1 tiles");
+      matrix->setTileRotation(1, TILE_180);
+      check_map_matches(matrix, l.name, "second tile at 180");
+      matrix->setTileLayout(2, 2, TILE_SERPENTINE);
+      check_map_matches(matrix, l.name, "2x2 serpentine");
+      matrix->setTileRotation(3, TILE_180);
+      matrix->setRotate(true);
+      check_map_matches(matrix, l.name, "2x2 serpentine rotated");
+      delete matrix;
+   }
+}
+
+// PxMatrixT encodes the same bytes as PxMatrix set up the same way, by
+// every route, and only builds the pixel map once it leaves its fixed layout
+template <uint16_t W, uint16_t H, uint8_t RowPattern, scan_patterns Scan>
+static void check_fixed(const char *name, color_modes color_mode)
+{
+   typedef Probe<PxMatrixT<W, H, RowPattern, Scan>> fixed_probe;
+
+   sim_reset();
+   probe *plain = new probe(W, H, PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+   CHECK(plain->begin(RowPattern, color_mode), "%s: begin failed", name);
+   CHECK(plain->setScanPattern(Scan), "%s: scan %d refused", name, Scan);
+   fixed_probe *fixed = new fixed_probe(PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+   CHECK(fixed->begin(color_mode), "%s: fixed begin failed", name);
+   CHECK(!fixed->map_filled(), "%s scan %d: map built for the fixed layout", name, Scan);
+
+   frame f = random_frame(W, H);
+   const char *routes[] = {"drawPixelRGB888", "drawFrameRGB888", "drawFrameRGB565", "drawRectRGB888", "drawRectRGB565", "fillRect"};
+   for (uint8_t route = 0; route < 6; route++)
+   {
+      PxMatrix *matrices[2] = {plain, fixed};
+      for (PxMatrix *matrix : matrices)
+      {
+         if (0 == route)
+            draw_ramp(matrix);
+         else if (1 == route)
+            matrix->drawFrameRGB888(&f.rgb888[at(f, 0, 0) * 3], f.stride);
+         else if (2 == route)
+            matrix->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+         else if (route < 5)
+            draw_rects(matrix, f, 4 == route);
+         else
+            matrix->fillRect(-3, 5, W - 7, 9, 0xA5, 0x3C, 0x71);
+      }
+      CHECK(same_buffers(plain, fixed), "%s scan %d mode %d: %s encodes differently", name, Scan, color_mode, routes[route]);
+   }
+
+   // Rotated falls back to the map, and back again
+   plain->setRotate(true);
+   fixed->setRotate(true);
+   CHECK(fixed->map_filled(), "%s scan %d: no map when rotated", name, Scan);
+   draw_ramp(plain);
+   draw_ramp(fixed);
+   CHECK(same_buffers(plain, fixed), "%s scan %d mode %d: rotated encodes differently", name, Scan, color_mode);
+
+   plain->setRotate(false);
+   fixed->setRotate(false);
+   CHECK(!fixed->map_filled(), "%s scan %d: map rebuilt after rotating back", name, Scan);
+   plain->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+   fixed->drawFrameRGB565(&f.rgb565[at(f, 0, 0)], f.stride);
+   CHECK(same_buffers(plain, fixed), "%s scan %d mode %d: rotated back encodes differently", name, Scan, color_mode);
+
+   delete plain;
+   delete fixed;
+   free_frame(f);
+}
+
+template <uint16_t W, uint16_t H, uint8_t RowPattern>
+static void check_fixed_scans(const char *name)
+{
+   static const color_modes modes[] = {THRESHOLD, BCM};
+
+   for (color_modes mode : modes)
+   {
+      check_fixed<W, H, RowPattern, LINE>(name, mode);
+      check_fixed<W, H, RowPattern, ZIGZAG>(name, mode);
+      check_fixed<W, H, RowPattern, ZAGGIZ>(name, mode);
+   }
+}
+
+int main()
+{
+   for (const layout &l : layouts)
+   {
+      check_scan_tables(l);
+      check_bad_scan_tables(l);
+      check_map(l);
+   }
+
+   static const scan_patterns scans[] = {LINE, ZIGZAG, ZAGGIZ};
+   for (const variant &v : variants)
+   {
+      for (scan_patterns scan : scans)
+      {
+         check_blits(v, scan, THRESHOLD);
+         check_blits(v, scan, BCM);
+         check_fills(v, scan, THRESHOLD);
+         check_fills(v, scan, BCM);
+      }
+      check_encode_again(v, THRESHOLD, false);
+      check_encode_again(v, BCM, false);
+      check_encode_again(v, BCM, true);
+      check_dither_phase(v, false);
+      check_dither_phase(v, true);
+
+      // Streaming maps panel pixels without the tiles
+      if (!v.tiles_x)
+      {
+         check_viewport(v, THRESHOLD, false);
+         check_viewport(v, BCM, false);
+         check_viewport(v, BCM, true);
+      }
+   }
+
+   check_fixed_scans<32, 16, 8>("fixed 32x16 8");
+   check_fixed_scans<64, 32, 16>("fixed 64x32 16");
+
+   return test_summary("test_encode");
+}
@@ -0,0 +1,241 @@
+/****************************************************************
+ * Walks the I2S parallel descriptor chain the way the DMA does and checks
+ * every row is lit for its time with its own address and nothing is
+ * latched or addressed while OE is active. Also checks every bit of a row
+ * goes out on the lane of its half of the panel
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "PxMatrixI2s.h"
+#include "test.h"
+
+// A 32x16 panel with row pattern 8
+#define ROWS 8
+#define PLANES 8
+#define COLOR_BYTES 8
+#define ROW_SAMPLES PXMATRIX_I2S_ROW_SAMPLES(COLOR_BYTES)
+#define MAX_DESC (ROWS * 34 * (1 + PXMATRIX_I2S_HOLD_DESC))
+
+#define _BV(x) (1 << (x))
+#define ADDRESS(sample) (((sample) >> PXMATRIX_I2S_BIT_A) & 0x1f)
+
+static uint16_t samples[PLANES * ROWS * 2 * ROW_SAMPLES];
+static uint16_t hold[ROWS * PXMATRIX_I2S_HOLD_SAMPLES];
+static lldesc_t chain[MAX_DESC];
+
+// Samples a block lights, split between the shift and the hold before it
+// as the driver does
+static uint16_t shift_lit(uint32_t lit)
+{
+   uint16_t shift = PXMATRIX_I2S_SHIFT_LIT(ROW_SAMPLES);
+   return (lit < shift) ? lit : shift;
+}
+
+static uint16_t hold_lit(uint32_t lit)
+{
+   uint32_t held = lit - shift_lit(lit);
+   return (held > PXMATRIX_I2S_HOLD_LIT) ? PXMATRIX_I2S_HOLD_LIT : held;
+}
+
+// Lit time of a plane, lit over the shift and then held, and of repeats
+static void check_chain(const char *name, const uint32_t *lit, const uint8_t *repeat)
+{
+   static uint8_t row[3 * COLOR_BYTES];
+   static uint16_t lanes[2 * ROW_SAMPLES];
+   uint8_t upper[COLOR_BYTES * 8];
+   uint16_t held[PLANES];
+
+   for (uint16_t bit = 0; bit < COLOR_BYTES * 8; bit++)
+      upper[bit] = (bit >= COLOR_BYTES * 4);
+   CHECK(pxmatrix_i2s_map_lanes(lanes, upper, COLOR_BYTES), "%s: LINE doesn't split", name);
+
+   for (uint8_t plane = 0; plane < PLANES; plane++)
+   {
+      held[plane] = hold_lit(lit[plane]);
+      for (uint8_t r = 0; r < ROWS; r++)
+      {
+         uint8_t shown = (0 == r) ? (plane + PLANES - 1) % PLANES : plane;
+         uint16_t *block = samples + ((plane * ROWS) + r) * 2 * ROW_SAMPLES;
+
+         memset(row, (plane * ROWS) + r, sizeof(row));
+         pxmatrix_i2s_pack_row(block, row, COLOR_BYTES, lanes, (r + ROWS - 1) % ROWS, shift_lit(lit[shown]));
+         pxmatrix_i2s_pack_row(block + ROW_SAMPLES, row, COLOR_BYTES, lanes, r, shift_lit(lit[plane]));
+      }
+   }
+   for (uint8_t r = 0; r < ROWS; r++)
+      pxmatrix_i2s_pack_hold(hold + (r * PXMATRIX_I2S_HOLD_SAMPLES), r);
+
+   size_t used = pxmatrix_build_i2s_chain(chain, MAX_DESC, samples, ROW_SAMPLES, ROWS, PLANES, repeat, hold, held);
+   CHECK(0 != used, "%s: chain doesn't fit", name);
+   if (0 == used)
+      return;
+
+   // Twice round the loop, the first to pick up what the end leaves latched
+   static uint32_t on[PLANES][ROWS];
+   int16_t latched = -1;
+   int16_t address = -1;
+   uint32_t ghosts = 0;
+   uint32_t misaddressed = 0;
+   uint32_t latches = 0;
+   const lldesc_t *desc = &chain[0];
+
+   memset(on, 0, sizeof(on));
+   for (uint8_t pass = 0; pass < 2; pass++)
+   {
+      for (size_t idx = 0; idx < used; idx++)
+      {
+         const uint16_t *data = (const uint16_t *)desc->buf;
+         uint16_t count = desc->length / sizeof(uint16_t);
+         int32_t block = -1;
+
+         CHECK(0 == (desc->length & 3), "%s: descriptor of %d bytes", name, desc->length);
+         if ((data >= samples) && (data < samples + (sizeof(samples) / sizeof(samples[0]))))
+            block = (data - samples) / (2 * ROW_SAMPLES);
+
+         for (uint16_t k = 0; k < count; k++)
+         {
+            uint16_t sample = data[k ^ 1];
+            bool oe = !(sample & _BV(PXMATRIX_I2S_BIT_OE));
+
+            if (oe && (address >= 0) && (ADDRESS(sample) != address))
+               ghosts++;
+            address = ADDRESS(sample);
+
+            if (sample & _BV(PXMATRIX_I2S_BIT_LAT))
+            {
+               if (oe)
+                  ghosts++;
+               CHECK(block >= 0, "%s: latch outside a block", name);
+               latched = block;
+               latches += pass;
+            }
+            else if (oe && (latched >= 0))
+            {
+               if (address != (latched % ROWS))
+                  misaddressed++;
+               if (1 == pass)
+                  on[latched / ROWS][latched % ROWS]++;
+            }
+         }
+         desc = desc->qe.stqe_next;
+      }
+      CHECK(desc == &chain[0], "%s: chain doesn't loop after %u descriptors", name, (unsigned)used);
+   }
+
+   CHECK(0 == ghosts, "%s: %u latches or address changes with OE active", name, ghosts);
+   CHECK(0 == misaddressed, "%s: %u samples lit with the wrong address", name, misaddressed);
+
+   uint32_t blocks = 0;
+   for (uint8_t plane = 0; plane < PLANES; plane++)
+   {
+      uint32_t want = repeat[plane] * (shift_lit(lit[plane]) + pxmatrix_i2s_hold_lit(held[plane]));
+      blocks += repeat[plane] * ROWS;
+      for (uint8_t r = 0; r < ROWS; r++)
+         CHECK(on[plane][r] == want, "%s: plane %d row %d lit %u, wants %u",
+               name, plane, r, on[plane][r], want);
+   }
+   CHECK(latches == blocks, "%s: %u latches for %u blocks", name, latches, blocks);
+}
+
+// Every bit of a section on the lane of its half, in the order it is sent
+static void check_lanes(const char *name, const uint8_t *upper)
+{
+   static uint16_t lanes[2 * ROW_SAMPLES];
+   uint16_t out[ROW_SAMPLES];
+   uint8_t row[3 * COLOR_BYTES];
+
+   CHECK(pxmatrix_i2s_map_lanes(lanes, upper, COLOR_BYTES), "%s: doesn't split", name);
+
+   for (uint8_t half = 0; half < 2; half++)
+   {
+      int32_t last = -1;
+      for (uint16_t k = 0; k < ROW_SAMPLES; k++)
+      {
+         uint16_t bit = lanes[(2 * k) + half];
+         CHECK(upper[bit] == !half, "%s: bit %d on the wrong lane", name, bit);
+         CHECK((int32_t)bit > last, "%s: bit %d sent out of order", name, bit);
+         last = bit;
+      }
+   }
+
+   // One bit at a time in each colour lights exactly its lane on its clock
+   for (uint8_t colour = 0; colour < 3; colour++)
+   {
+      for (uint16_t bit = 0; bit < COLOR_BYTES * 8; bit++)
+      {
+         memset(row, 0, sizeof(row));
+         row[(colour * COLOR_BYTES) + (bit / 8)] = 0x80 >> (bit % 8);
+         pxmatrix_i2s_pack_row(out, row, COLOR_BYTES, lanes, 0, 0);
+
+         // Sections are B, G, R and lanes R, G, B
+         uint8_t lane = (2 - colour) + (upper[bit] ? PXMATRIX_I2S_BIT_R1 : PXMATRIX_I2S_BIT_R2);
+         for (uint16_t k = 0; k < ROW_SAMPLES; k++)
+         {
+            uint16_t data = out[k ^ 1] & (_BV(PXMATRIX_I2S_BIT_A) - 1);
+            bool mine = (lanes[(2 * k) + !upper[bit]] == bit);
+            CHECK(data == (mine ? _BV(lane) : 0), "%s: bit %d of colour %d sends %02x on clock %d", name, bit, colour, data, k);
+         }
+      }
+   }
+}
+
+int main(void)
+{
+   static const uint8_t once[PLANES] = {1, 1, 1, 1, 1, 1, 1, 1};
+   static const uint8_t bcm[PLANES] = {1, 1, 1, 1, 2, 4, 8, 16};
+
+   // Within the shift, a hold of part of a buffer, several and past the cap
+   static const uint32_t short_lit[PLANES] = {1, 2, 5, 10, 20, 29, 30, 30};
+   static const uint32_t long_lit[PLANES] = {31, 32, 33, 100, 284, 285, 287, 540};
+   static const uint32_t capped_lit[PLANES] = {600, 600, 600, 600, 600, 600, 600, 600};
+   uint32_t bcm_lit[PLANES];
+
+   for (uint8_t plane = 0; plane < PLANES; plane++)
+      bcm_lit[plane] = (plane < 3) ? ((850 << plane) >> 3) : 850;
+
+   check_chain("threshold short", short_lit, once);
+   check_chain("threshold long", long_lit, once);
+   check_chain("threshold capped", capped_lit, once);
+   check_chain("bcm short", short_lit, bcm);
+   check_chain("bcm long", bcm_lit, bcm);
+
+   // Holds light whole words, never less than asked and at most one more
+   for (uint16_t lit = 0; lit <= PXMATRIX_I2S_HOLD_LIT + 10; lit++)
+   {
+      uint16_t want = (lit > PXMATRIX_I2S_HOLD_LIT) ? PXMATRIX_I2S_HOLD_LIT : lit;
+      uint16_t held = pxmatrix_i2s_hold_lit(lit);
+      CHECK((held >= want) && (held <= want + 1), "hold of %d lights %d", lit, held);
+   }
+
+   // LINE sends the bottom half first, ZIGZAG alternates a byte of each
+   uint8_t upper[COLOR_BYTES * 8];
+   for (uint16_t bit = 0; bit < COLOR_BYTES * 8; bit++)
+      upper[bit] = (bit >= COLOR_BYTES * 4);
+   check_lanes("LINE", upper);
+   for (uint16_t bit = 0; bit < COLOR_BYTES * 8; bit++)
+      upper[bit] = (bit / 8) & 1;
+   check_lanes("ZIGZAG", upper);
+
+   // Any split as long as it is half and half
+   srand(1);
+   for (uint16_t bit = 0; bit < COLOR_BYTES * 8; bit++)
+      upper[bit] = bit & 1;
+   for (uint16_t bit = COLOR_BYTES * 8 - 1; bit > 0; bit--)
+   {
+      uint16_t other = rand() % (bit + 1);
+      uint8_t temp = upper[bit];
+      upper[bit] = upper[other];
+      upper[other] = temp;
+   }
+   check_lanes("shuffled", upper);
+
+   upper[0] = !upper[0];
+   static uint16_t lanes[2 * ROW_SAMPLES];
+   CHECK(!pxmatrix_i2s_map_lanes(lanes, upper, COLOR_BYTES), "uneven halves split");
+
+   return test_summary("test_i2s");
+}
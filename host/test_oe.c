@@ -0,0 +1,106 @@
+/****************************************************************
+ * Checks the RMT items for OE pulses of every length hold OE low for the
+ * time asked, end with a marker and stay within their items
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdbool.h>
+#include <string.h>
+#include "PxMatrixOe.h"
+#include "test.h"
+
+#define GUARD 0xA5
+
+// Longest pulse in ticks that count items hold, with room for the end marker
+static uint64_t max_ticks(size_t count)
+{
+   return (uint64_t)((2 * count) - 1) * PXMATRIX_OE_MAX_TICKS;
+}
+
+static void check_pulse(uint32_t show_time_ns, size_t max_items)
+{
+   rmt_item32_t items[PXMATRIX_OE_MAX_ITEMS + 1];
+   uint64_t ticks = ((uint64_t)show_time_ns + (PXMATRIX_OE_TICK_NS / 2)) / PXMATRIX_OE_TICK_NS;
+
+   memset(items, GUARD, sizeof(items));
+   size_t count = pxmatrix_oe_pulse(items, max_items, show_time_ns);
+
+   if ((0 == ticks) || (ticks > max_ticks(max_items)))
+   {
+      CHECK(0 == count, "%u ns in %d items gives %d items", show_time_ns, (int)max_items, (int)count);
+      return;
+   }
+   CHECK(0 != count, "%u ns doesn't fit %d items", show_time_ns, (int)max_items);
+   if (0 == count)
+      return;
+
+   CHECK(count <= max_items, "%u ns takes %d items of %d", show_time_ns, (int)count, (int)max_items);
+   CHECK(ticks * PXMATRIX_OE_TICK_NS == pxmatrix_oe_pulse_ns(items, count), "%u ns held low for %u ns",
+         show_time_ns, pxmatrix_oe_pulse_ns(items, count));
+
+   // Active low all the way, then a zero length half within the items
+   bool ended = false;
+   for (size_t half = 0; half < 2 * count; half++)
+   {
+      const rmt_item32_t *item = &items[half / 2];
+      uint32_t duration = (half & 1) ? item->duration1 : item->duration0;
+      uint32_t level = (half & 1) ? item->level1 : item->level0;
+
+      CHECK(0 == level, "%u ns: half %d at level %u", show_time_ns, (int)half, level);
+      if (0 == duration)
+      {
+         ended = true;
+         break;
+      }
+   }
+   CHECK(ended, "%u ns: no end marker in %d items", show_time_ns, (int)count);
+
+   const uint8_t *past = (const uint8_t *)&items[count];
+   for (size_t idx = 0; idx < sizeof(rmt_item32_t); idx++)
+      CHECK(GUARD == past[idx], "%u ns: wrote past %d items", show_time_ns, (int)count);
+}
+
+int main(void)
+{
+   // Rounding either side of the tick, and nothing for under half of one
+   for (uint32_t ns = 0; ns < 20 * PXMATRIX_OE_TICK_NS; ns++)
+      check_pulse(ns, PXMATRIX_OE_MAX_ITEMS);
+
+   // Either side of where a pulse needs another half or another item
+   for (uint32_t halves = 1; halves < 2 * PXMATRIX_OE_MAX_ITEMS; halves++)
+   {
+      uint64_t edge = (uint64_t)halves * PXMATRIX_OE_MAX_TICKS * PXMATRIX_OE_TICK_NS;
+      for (int32_t offset = -PXMATRIX_OE_TICK_NS; offset <= PXMATRIX_OE_TICK_NS; offset += PXMATRIX_OE_TICK_NS / 2)
+      {
+         if (edge + offset <= UINT32_MAX)
+            check_pulse(edge + offset, PXMATRIX_OE_MAX_ITEMS);
+      }
+   }
+
+   // Show times the panel uses, and pulses too long for fewer items
+   for (uint32_t us = 1; us <= 20000; us += 7)
+      check_pulse(us * 1000, PXMATRIX_OE_MAX_ITEMS);
+   for (size_t max_items = 1; max_items <= 4; max_items++)
+   {
+      for (uint32_t halves = 0; halves <= 2 * max_items; halves++)
+      {
+         check_pulse((halves * PXMATRIX_OE_MAX_TICKS * PXMATRIX_OE_TICK_NS) - PXMATRIX_OE_TICK_NS, max_items);
+         check_pulse(halves * PXMATRIX_OE_MAX_TICKS * PXMATRIX_OE_TICK_NS, max_items);
+         check_pulse((halves * PXMATRIX_OE_MAX_TICKS * PXMATRIX_OE_TICK_NS) + PXMATRIX_OE_TICK_NS, max_items);
+      }
+   }
+
+   // Stops at a high half as well as the end marker
+   rmt_item32_t items[2];
+   memset(items, 0, sizeof(items));
+   items[0].duration0 = 10;
+   items[0].duration1 = 20;
+   items[0].level1 = 1;
+   items[1].duration0 = 30;
+   CHECK(10 * PXMATRIX_OE_TICK_NS == pxmatrix_oe_pulse_ns(items, 2), "low then high is %u ns",
+         pxmatrix_oe_pulse_ns(items, 2));
+
+   return test_summary("test_oe");
+}
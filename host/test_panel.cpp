@@ -0,0 +1,796 @@
+/****************************************************************
+ * Refreshes PxMatrix into the simulated panel and checks the image it
+ * shows against what was drawn and what readPixel works out, for every
+ * scan pattern and the ways of sending rows
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "PxMatrix.h"
+#include "sim.h"
+#include "test.h"
+
+// Pins of the board config
+#define PIN_LATCH 26
+#define PIN_OE 21
+#define PIN_A 27
+#define PIN_B 17
+#define PIN_C 25
+#define PIN_D 5
+#define PIN_E 15
+#define PIN_POWER 22
+
+// Quad SPI lanes clear of the panel, where Kconfig puts them
+#define PIN_WP 33
+#define PIN_HD 32
+
+// Every plane of a BCM cycle is then a whole number of microseconds
+#define SHOW_TIME_US 255
+
+struct setup {
+   const char *name;
+   uint16_t width;
+   uint16_t height;
+   uint8_t row_pattern;
+   scan_patterns scan;
+   color_modes color_mode;
+   output_modes output_mode;
+   bool streaming;
+   bool rotate;
+   bool quad_spi;
+   bool rmt_oe;
+   bool triple_buffer;
+   bool dither;
+   // Quad SPI lane pins, 0 for PIN_WP and PIN_HD
+   uint8_t wp_pin;
+   uint8_t hd_pin;
+   bool indexed;
+   uint32_t psram_threshold;
+   bool shadow;
+};
+
+// Lanes rows should go out on, quad SPI falls back to one when a lane
+// lands on a pin of the panel or its supply
+static uint8_t expected_lanes(const setup &s)
+{
+   static const uint8_t taken[] = {PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E, PIN_POWER};
+   if (!s.quad_spi)
+      return 1;
+   for (uint8_t pin : taken)
+   {
+      if ((pin == s.wp_pin) || (pin == s.hd_pin))
+         return 1;
+   }
+   return 4;
+}
+
+static enum sim_wirings wiring_of(scan_patterns scan)
+{
+   switch (scan)
+   {
+   case ZIGZAG:
+      return SIM_ZIGZAG;
+   case ZAGGIZ:
+      return SIM_ZAGGIZ;
+   default:
+      return SIM_LINE;
+   }
+}
+
+// A matrix set up for s, not begun
+static PxMatrix *create(const setup &s)
+{
+   sim_reset();
+
+   sim_panel_config config;
+   memset(&config, 0, sizeof(config));
+   config.width = s.width;
+   config.height = s.height;
+   config.row_pattern = s.row_pattern;
+   config.wiring = wiring_of(s.scan);
+   config.latch_pin = PIN_LATCH;
+   config.oe_pin = PIN_OE;
+   config.address_pins[0] = PIN_A;
+   config.address_pins[1] = PIN_B;
+   config.address_pins[2] = PIN_C;
+   config.address_pins[3] = PIN_D;
+   config.address_pins[4] = PIN_E;
+   sim_panel_begin(&config);
+
+   PxMatrix *matrix = new PxMatrix(s.width, s.height, PIN_LATCH, PIN_OE, PIN_A, PIN_B, PIN_C, PIN_D, PIN_E);
+   matrix->setScanPattern(s.scan);
+   matrix->setOutputMode(s.output_mode);
+   matrix->setStreaming(s.streaming);
+   matrix->setQuadSpi(s.quad_spi);
+   matrix->setQuadSpiPins(s.wp_pin ? s.wp_pin : PIN_WP, s.hd_pin ? s.hd_pin : PIN_HD);
+   matrix->setPowerPin(PIN_POWER);
+   matrix->setRmtOe(s.rmt_oe);
+   matrix->setTripleBuffer(s.triple_buffer);
+   matrix->setDither(s.dither);
+   matrix->setIndexed(s.indexed);
+   matrix->setPsramThreshold(s.psram_threshold);
+   matrix->setShadow(s.shadow);
+   return matrix;
+}
+
+static PxMatrix *start(const setup &s)
+{
+   PxMatrix *matrix = create(s);
+   CHECK(matrix->begin(s.row_pattern, s.color_mode), "%s: begin failed", s.name);
+   matrix->setRotate(s.rotate);
+   return matrix;
+}
+
+// Runs whole colour cycles. The SPI_DMA_CHAIN interrupt refreshes by itself
+// once display() has started it, it runs until the last row of the cycle
+// is latched
+static void refresh(const setup &s, PxMatrix *matrix, uint8_t cycles, uint16_t show_time = SHOW_TIME_US)
+{
+   if (SPI_DMA_CHAIN == s.output_mode)
+   {
+      matrix->display(show_time);
+      uint32_t latches = sim_panel_latches() + ((uint32_t)cycles * s.row_pattern * matrix->getColorDepth());
+      while (sim_panel_latches() < latches)
+         sim_advance(100);
+      return;
+   }
+
+   for (uint16_t plane = 0; plane < cycles * matrix->getColorDepth(); plane++)
+      matrix->display(show_time);
+}
+
+// Nanoseconds a scan row takes to shift in on one lane at 20MHz
+static uint64_t shift_ns(const setup &s)
+{
+   return ((uint64_t)s.width * s.height * 3 / s.row_pattern) * 50;
+}
+
+// Nanoseconds some row was lit since the last clear
+static uint64_t lit_ns(const setup &s)
+{
+   uint64_t lit = 0;
+   for (uint8_t row = 0; row < s.row_pattern; row++)
+      lit += sim_panel_row_time(row);
+   return lit;
+}
+
+// Where a canvas pixel is on the panel
+static void panel_xy(const setup &s, int16_t x, int16_t y, uint16_t *px, uint16_t *py)
+{
+   *px = x;
+   *py = y;
+   if (s.rotate)
+   {
+      *px = y;
+      *py = s.height - 1 - x;
+   }
+}
+
+// Level a channel value shows, from the modulation rather than the encoder
+static uint8_t expected_level(const setup &s, uint8_t depth, uint8_t value)
+{
+   if (BCM == s.color_mode)
+      return ((value >> (8 - depth)) * 255) / ((1 << depth) - 1);
+
+   uint16_t step = 256 / depth;
+   uint8_t lit = 0;
+   for (uint8_t slot = 0; slot < depth; slot++)
+   {
+      if (value > (slot * step) + (step / 2))
+         lit++;
+   }
+   return (lit * 255) / depth;
+}
+
+// A channel value through RGB565, which loses its low bits first
+static uint8_t rgb565_value(uint8_t channel, uint8_t value)
+{
+   if (1 == channel)
+      return (((value >> 2) * 259) + 33) >> 6;
+   return (((value >> 3) * 527) + 23) >> 6;
+}
+
+// Streaming keeps frames as RGB565 and dithering encodes again from an RGB565
+// shadow
+static uint8_t stored_value(const setup &s, uint8_t channel, uint8_t value)
+{
+   if (!s.streaming && !s.dither)
+      return value;
+   return rgb565_value(channel, value);
+}
+
+// Colours full on or off, any two pixels swapped or dropped show up
+static void binary_colour(int16_t x, int16_t y, uint8_t *rgb)
+{
+   uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+   hash ^= hash >> 13;
+   hash *= 0x5bd1e995u;
+   hash ^= hash >> 15;
+   for (uint8_t channel = 0; channel < 3; channel++)
+      rgb[channel] = (hash >> (channel * 7)) & 1 ? 255 : 0;
+}
+
+// Every level, different in each channel
+static void ramp_colour(int16_t x, int16_t y, uint8_t *rgb)
+{
+   rgb[0] = (x * 8) + (y * 37);
+   rgb[1] = (x * 13) + (y * 5) + 100;
+   rgb[2] = 255 - ((x * 3) + (y * 11));
+}
+
+static void check_image(const setup &s, void (*colour)(int16_t x, int16_t y, uint8_t *rgb), uint8_t tolerance)
+{
+   PxMatrix *matrix = start(s);
+   uint8_t depth = matrix->getColorDepth();
+
+   // Frames are drawn the way display.c does, double buffering swaps to the
+   // buffer it draws into, triple buffering hands it over after
+   if (!s.triple_buffer)
+      matrix->swapBuffer();
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         uint8_t rgb[3];
+         colour(x, y, rgb);
+         matrix->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+      }
+   }
+   uint32_t frame_id = 0;
+   if (s.triple_buffer)
+      frame_id = matrix->present();
+
+   // The frame is picked up at the end of a cycle
+   refresh(s, matrix, 2);
+   sim_panel_clear();
+   uint64_t start_time = sim_time_ns();
+   refresh(s, matrix, 1);
+
+   if (s.triple_buffer)
+   {
+      int64_t shown_time = 0;
+      CHECK(frame_id == matrix->getShownFrame(&shown_time), "%s: frame %u presented, %u shown", s.name, frame_id, matrix->getShownFrame(NULL));
+      CHECK(shown_time > 0, "%s: frame shown at %lld", s.name, (long long)shown_time);
+   }
+
+   CHECK(0 == sim_isr_faults(), "%s: %u waits or flash calls from interrupts", s.name, sim_isr_faults());
+   CHECK(0 == sim_spi_clashes(), "%s: %u SPI pins on panel pins", s.name, sim_spi_clashes());
+   if ((SPI_BLOCKING == s.output_mode) || (SPI_PIPELINED == s.output_mode))
+      CHECK(expected_lanes(s) == sim_spi_lanes(), "%s: rows sent on %u lanes", s.name, sim_spi_lanes());
+   CHECK(0 == sim_panel_ghosts(), "%s: %u latches or address changes with OE active", s.name, sim_panel_ghosts());
+   CHECK(sim_panel_latches() == (uint32_t)s.row_pattern * depth, "%s: %u latches in a cycle", s.name, sim_panel_latches());
+
+   // The chain shifts every row while the one before is lit, short planes
+   // blank partway through. Only the first row of a frame goes in dark
+   if (SPI_DMA_CHAIN == s.output_mode)
+   {
+      uint64_t dark = sim_time_ns() - start_time - lit_ns(s);
+      CHECK(dark <= (s.row_pattern + 1) * shift_ns(s), "%s: dark for %llu ns of a cycle, a row shifts in %llu",
+            s.name, (unsigned long long)dark, (unsigned long long)shift_ns(s));
+   }
+
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         uint8_t rgb[3];
+         uint8_t read[3];
+         uint16_t px, py;
+         colour(x, y, rgb);
+         panel_xy(s, x, y, &px, &py);
+
+         // readPixel works the same out from the bits the driver sent
+         CHECK(matrix->readPixel(x, y, &read[0], &read[1], &read[2]), "%s: %d,%d can't be read back", s.name, x, y);
+
+         for (uint8_t channel = 0; channel < 3; channel++)
+         {
+            int16_t want = expected_level(s, depth, stored_value(s, channel, rgb[channel]));
+            int16_t got = sim_panel_level(px, py, channel);
+            CHECK(abs(want - got) <= tolerance, "%s: %d,%d channel %d shows %d, drawn %d wants %d",
+                  s.name, x, y, channel, got, rgb[channel], want);
+            CHECK(abs(read[channel] - got) <= tolerance, "%s: %d,%d channel %d shows %d, read back %d",
+                  s.name, x, y, channel, got, read[channel]);
+         }
+      }
+   }
+
+   delete matrix;
+}
+
+// A static image drawn once, dithered over cycles whole passes of the 16
+// dither phases. Every pixel averages out to within a level of its value.
+// Encoded buffers are handed over again every cycle without being redrawn
+static void check_dither(const setup &s, uint8_t value, uint16_t cycles)
+{
+   PxMatrix *matrix = start(s);
+   for (uint8_t idx = 0; idx < 3; idx++)
+   {
+      matrix->swapBuffer();
+      matrix->fillScreen(value, value, value);
+      refresh(s, matrix, 1);
+   }
+
+   for (uint16_t cycle = 0; cycle < 2 * cycles; cycle++)
+   {
+      if (cycle == cycles)
+         sim_panel_clear();
+      if (!s.streaming)
+         matrix->swapBuffer();
+      refresh(s, matrix, 1);
+   }
+   CHECK(0 == sim_isr_faults(), "%s: %u waits or flash calls from interrupts", s.name, sim_isr_faults());
+
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         for (uint8_t channel = 0; channel < 3; channel++)
+         {
+            int16_t want = (stored_value(s, channel, value) * 255) / 256;
+            int16_t got = sim_panel_level(x, y, channel);
+            CHECK(abs(want - got) <= 1, "%s: %d,%d channel %d shows %d dithering %d", s.name, x, y, channel, got, value);
+         }
+      }
+   }
+
+   delete matrix;
+}
+
+// A new show time stops the SPI_DMA_CHAIN interrupt at the end of a frame
+// and rebuilds the chains, rows then stay lit for the new time
+static void check_show_time(const setup &s)
+{
+   PxMatrix *matrix = start(s);
+   matrix->swapBuffer();
+   matrix->fillScreen(255, 255, 255);
+
+   refresh(s, matrix, 2);
+   sim_panel_clear();
+   refresh(s, matrix, 1);
+   uint64_t lit = lit_ns(s);
+
+   refresh(s, matrix, 1, SHOW_TIME_US / 2);
+   refresh(s, matrix, 1, SHOW_TIME_US / 2);
+   sim_panel_clear();
+   refresh(s, matrix, 1, SHOW_TIME_US / 2);
+   uint64_t halved = lit_ns(s);
+
+   CHECK(0 == sim_isr_faults(), "%s: %u waits or flash calls from interrupts", s.name, sim_isr_faults());
+   CHECK(0 == sim_panel_ghosts(), "%s: %u latches or address changes with OE active", s.name, sim_panel_ghosts());
+   CHECK((halved * 2 >= lit - (lit / 50)) && (halved * 2 <= lit + (lit / 50)), "%s: lit %llu ns a cycle, %llu at half the show time",
+         s.name, (unsigned long long)lit, (unsigned long long)halved);
+
+   delete matrix;
+}
+
+// Only presented frames replaced before they are shown count as dropped, a
+// buffer swapped in without present doesn't, whatever it held before
+static void check_dropped(const setup &s)
+{
+   PxMatrix *matrix = start(s);
+
+   // The chain takes a frame up at the end of the one it is on, so refresh
+   // for two cycles
+   matrix->present();
+   uint32_t frame_id = matrix->present();
+   CHECK(1 == matrix->getDroppedFrames(), "%s: %u dropped replacing a presented frame", s.name, matrix->getDroppedFrames());
+
+   refresh(s, matrix, 2);
+   CHECK(frame_id == matrix->getShownFrame(NULL), "%s: frame %u presented, %u shown", s.name, frame_id, matrix->getShownFrame(NULL));
+
+   // Swapped in the buffer of the first frame, still tagged with its id
+   matrix->swapBuffer();
+   frame_id = matrix->present();
+   CHECK(1 == matrix->getDroppedFrames(), "%s: %u dropped replacing a swapped frame", s.name, matrix->getDroppedFrames());
+
+   refresh(s, matrix, 2);
+   CHECK(frame_id == matrix->getShownFrame(NULL), "%s: frame %u presented, %u shown", s.name, frame_id, matrix->getShownFrame(NULL));
+
+   delete matrix;
+}
+
+// A canvas pixel and the LED of the chain it lights
+struct tile_point {
+   int16_t x;
+   int16_t y;
+   uint16_t px;
+   uint16_t py;
+};
+
+struct tile_case {
+   setup s;
+   uint8_t tiles_x;
+   uint8_t tiles_y;
+   tile_layouts layout;
+   tile_rotations rotations[4];
+   tile_point points[6];
+};
+
+// Lights the points of a tiled canvas, exactly the LEDs worked out for them
+// by hand light up
+static void check_tiles(const tile_case &c)
+{
+   const setup &s = c.s;
+   PxMatrix *matrix = start(s);
+   matrix->setTileLayout(c.tiles_x, c.tiles_y, c.layout);
+   for (uint8_t tile = 0; tile < (c.tiles_x * c.tiles_y); tile++)
+      matrix->setTileRotation(tile, c.rotations[tile]);
+
+   matrix->swapBuffer();
+   matrix->fillScreen(0, 0, 0);
+   for (const tile_point &point : c.points)
+      matrix->drawPixelRGB888(point.x, point.y, 255, 255, 255);
+
+   refresh(s, matrix, 2);
+   sim_panel_clear();
+   refresh(s, matrix, 1);
+
+   for (uint16_t py = 0; py < s.height; py++)
+   {
+      for (uint16_t px = 0; px < s.width; px++)
+      {
+         bool want = false;
+         for (const tile_point &point : c.points)
+            want |= (point.px == px) && (point.py == py);
+         for (uint8_t channel = 0; channel < 3; channel++)
+         {
+            uint8_t got = sim_panel_level(px, py, channel);
+            CHECK(got == (want ? 255 : 0), "%s: LED %d,%d channel %d shows %d", s.name, px, py, channel, got);
+         }
+      }
+   }
+
+   delete matrix;
+}
+
+// Buffers of at least the threshold go to PSRAM while it has room, then to
+// internal memory. Running out of DMA memory fails begin
+static void check_memory(const setup &s)
+{
+   uint32_t buffer_bytes = ((uint32_t)s.width * s.height * 3 / 8) * PXMATRIX_COLOR_DEPTH;
+   uint32_t buffers = s.triple_buffer ? 3 : 2;
+   pxmatrix_memory memory;
+
+   PxMatrix *matrix = create(s);
+   matrix->setPsramThreshold(buffer_bytes);
+   CHECK(matrix->begin(s.row_pattern, s.color_mode), "%s: begin failed", s.name);
+   matrix->getMemoryUsage(&memory);
+   CHECK(memory.psram == buffers * buffer_bytes, "%s: %u bytes in PSRAM, %u buffers of %u", s.name, memory.psram, buffers, buffer_bytes);
+   delete matrix;
+
+   // One byte short of a buffer
+   matrix = create(s);
+   matrix->setPsramThreshold(buffer_bytes + 1);
+   CHECK(matrix->begin(s.row_pattern, s.color_mode), "%s: begin failed", s.name);
+   matrix->getMemoryUsage(&memory);
+   CHECK(0 == memory.psram, "%s: %u bytes in PSRAM over the threshold", s.name, memory.psram);
+   delete matrix;
+
+   // Room for one, the rest fall back
+   matrix = create(s);
+   sim_memory_limit(1 << 20, buffer_bytes);
+   matrix->setPsramThreshold(buffer_bytes);
+   CHECK(matrix->begin(s.row_pattern, s.color_mode), "%s: begin failed", s.name);
+   matrix->getMemoryUsage(&memory);
+   CHECK(memory.psram == buffer_bytes, "%s: %u bytes in PSRAM with room for %u", s.name, memory.psram, buffer_bytes);
+   CHECK(memory.dma >= (buffers - 1) * buffer_bytes, "%s: %u bytes of DMA memory", s.name, memory.dma);
+   delete matrix;
+
+   // Neither has room for the buffers
+   matrix = create(s);
+   sim_memory_limit(buffer_bytes, 0);
+   matrix->setPsramThreshold(buffer_bytes);
+   CHECK(!matrix->begin(s.row_pattern, s.color_mode), "%s: began without memory for the buffers", s.name);
+   delete matrix;
+}
+
+// Pipelined output sleeps on the interrupts rather than spinning, and a
+// count the task keeps in its notification value, as display.c does with
+// refresh ticks, comes out of a plane as it went in
+static void check_pipe_blocks(const setup &s)
+{
+   PxMatrix *matrix = start(s);
+   matrix->swapBuffer();
+   matrix->fillScreen(255, 255, 255);
+   refresh(s, matrix, 1);
+
+   uint64_t started = sim_time_ns();
+   uint64_t blocked = sim_blocked_ns();
+   uint64_t spun = sim_spun_ns();
+   xTaskNotifyFromISR(xTaskGetCurrentTaskHandle(), 0, eIncrement, NULL);
+   xTaskNotifyFromISR(xTaskGetCurrentTaskHandle(), 0, eIncrement, NULL);
+   refresh(s, matrix, 1);
+   uint64_t elapsed = sim_time_ns() - started;
+   blocked = sim_blocked_ns() - blocked;
+
+   uint32_t ticks = 0;
+   xTaskNotifyWait(0, 0, &ticks, 0);
+   CHECK(spun == sim_spun_ns(), "%s: busy waited %llu ns", s.name, (unsigned long long)(sim_spun_ns() - spun));
+   CHECK(blocked * 10 >= elapsed * 9, "%s: blocked %llu of %llu ns", s.name, (unsigned long long)blocked, (unsigned long long)elapsed);
+   CHECK(2 == ticks, "%s: notification value 0x%x, 2 given", s.name, ticks);
+   CHECK(0 == sim_isr_faults(), "%s: %u waits or flash calls from interrupts", s.name, sim_isr_faults());
+
+   delete matrix;
+}
+
+// Draws the ramp the way display.c does and hands it over
+static void draw_ramp(const setup &s, PxMatrix *matrix)
+{
+   if (!s.triple_buffer)
+      matrix->swapBuffer();
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         uint8_t rgb[3];
+         ramp_colour(x, y, rgb);
+         matrix->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+      }
+   }
+   if (s.triple_buffer)
+      matrix->present();
+}
+
+// The cycle shown since the panel was cleared is the ramp at depth, lit for
+// as long as depth planes of the show time. As drawn, or through the shadow
+// once encoded again
+static void check_ramp_cycle(const setup &s, uint8_t depth, bool encoded_again, const char *when)
+{
+   uint64_t want_lit = (uint64_t)s.row_pattern * depth * SHOW_TIME_US * 1000;
+   uint64_t lit = lit_ns(s);
+
+   CHECK(sim_panel_latches() == (uint32_t)s.row_pattern * depth, "%s: %u latches in a cycle %s", s.name, sim_panel_latches(), when);
+   CHECK((lit * 100 >= want_lit * 99) && (lit * 100 <= want_lit * 101), "%s: lit %llu ns %s, %llu at depth %u",
+         s.name, (unsigned long long)lit, when, (unsigned long long)want_lit, depth);
+   CHECK(0 == sim_panel_ghosts(), "%s: %u latches or address changes with OE active %s", s.name, sim_panel_ghosts(), when);
+
+   for (int16_t y = 0; y < s.height; y++)
+   {
+      for (int16_t x = 0; x < s.width; x++)
+      {
+         uint8_t rgb[3];
+         ramp_colour(x, y, rgb);
+         for (uint8_t channel = 0; channel < 3; channel++)
+         {
+            uint8_t value = encoded_again ? rgb565_value(channel, rgb[channel]) : stored_value(s, channel, rgb[channel]);
+            int16_t want = expected_level(s, depth, value);
+            int16_t got = sim_panel_level(x, y, channel);
+            CHECK(abs(want - got) <= 1, "%s: %d,%d channel %d shows %d %s, wants %d at depth %u",
+                  s.name, x, y, channel, got, when, want, depth);
+         }
+      }
+   }
+}
+
+// A depth change partway through a colour cycle leaves that cycle at the
+// old depth, every plane of it weighted for the old depth. Once the display
+// picks up the buffer drawn into, it shows what was drawn at the new depth
+static void check_depth_change(const setup &s)
+{
+   PxMatrix *matrix = start(s);
+
+   // Every buffer holds the ramp
+   for (uint8_t frame = 0; frame < 3; frame++)
+   {
+      draw_ramp(s, matrix);
+      refresh(s, matrix, 2);
+   }
+
+   sim_panel_clear();
+   for (uint8_t plane = 0; plane < 3; plane++)
+      matrix->display(SHOW_TIME_US);
+   CHECK(matrix->setColorDepth(4), "%s: depth 4 refused", s.name);
+   CHECK(PXMATRIX_COLOR_DEPTH == matrix->getColorDepth(), "%s: display at depth %u within a cycle", s.name, matrix->getColorDepth());
+   for (uint8_t plane = 3; plane < PXMATRIX_COLOR_DEPTH; plane++)
+      matrix->display(SHOW_TIME_US);
+   check_ramp_cycle(s, PXMATRIX_COLOR_DEPTH, false, "changing depth");
+
+   // Double buffering and streaming show the buffer drawn into from the end
+   // of the cycle, triple buffering once it is presented
+   if (s.triple_buffer)
+      matrix->present();
+   refresh(s, matrix, 1);
+   refresh(s, matrix, 1);
+   CHECK(4 == matrix->getColorDepth(), "%s: display at depth %u after the change", s.name, matrix->getColorDepth());
+   sim_panel_clear();
+   refresh(s, matrix, 1);
+   check_ramp_cycle(s, 4, true, "after the change");
+
+   // Every buffer follows as it comes back for drawing
+   for (uint8_t frame = 0; frame < 3; frame++)
+   {
+      if (s.triple_buffer)
+         matrix->present();
+      else
+         matrix->swapBuffer();
+      refresh(s, matrix, 2);
+      sim_panel_clear();
+      refresh(s, matrix, 1);
+      check_ramp_cycle(s, 4, true, "after handing buffers over");
+   }
+
+   // readPixel works it out from the planes sent
+   for (int16_t y = 0; y < matrix->height(); y++)
+   {
+      for (int16_t x = 0; x < matrix->width(); x++)
+      {
+         uint8_t read[3];
+         CHECK(matrix->readPixel(x, y, &read[0], &read[1], &read[2]), "%s: %d,%d can't be read back", s.name, x, y);
+         for (uint8_t channel = 0; channel < 3; channel++)
+         {
+            int16_t got = sim_panel_level(x, y, channel);
+            CHECK(abs(read[channel] - got) <= 1, "%s: %d,%d channel %d shows %d, read back %d at depth 4",
+                  s.name, x, y, channel, got, read[channel]);
+         }
+      }
+   }
+
+   CHECK(0 == sim_isr_faults(), "%s: %u waits or flash calls from interrupts", s.name, sim_isr_faults());
+   delete matrix;
+}
+
+// Colours drawn as RGB in indexed mode show the nearest entry of the
+// palette as it is when drawn, however often they were matched before
+static void check_palette(const setup &s)
+{
+   PxMatrix *matrix = start(s);
+   matrix->swapBuffer();
+
+   for (uint8_t pass = 0; pass < 2; pass++)
+   {
+      for (int16_t y = 0; y < matrix->height(); y++)
+      {
+         for (int16_t x = 0; x < matrix->width(); x++)
+         {
+            uint8_t rgb[3];
+            ramp_colour(x, y, rgb);
+            matrix->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+
+            // Nearest of the RGB332 palette it starts with, the lowest on a tie
+            uint32_t best_distance = UINT32_MAX;
+            uint16_t best = 0;
+            for (uint16_t idx = 0; idx < 256; idx++)
+            {
+               int32_t dr = (((idx >> 5) * 255) / 7) - rgb[0];
+               int32_t dg = ((((idx >> 2) & 7) * 255) / 7) - rgb[1];
+               int32_t db = ((idx & 3) * 85) - rgb[2];
+               uint32_t distance = (dr * dr) + (dg * dg) + (db * db);
+               if (distance < best_distance)
+               {
+                  best_distance = distance;
+                  best = matrix->color565(((idx >> 5) * 255) / 7, (((idx >> 2) & 7) * 255) / 7, (idx & 3) * 85);
+               }
+            }
+            CHECK(best == matrix->getPixel(x, y), "%s: pass %d %d,%d shows %04x, nearest %04x",
+                  s.name, pass, x, y, matrix->getPixel(x, y), best);
+         }
+      }
+   }
+
+   // Red matched once, then taken out of the palette
+   matrix->drawPixelRGB888(0, 0, 255, 0, 0);
+   matrix->setPaletteColor(0xE0, 0, 0, 0);
+   matrix->drawPixelRGB888(1, 0, 255, 0, 0);
+   CHECK(0 == matrix->getPixel(0, 0), "%s: changed entry shows %04x", s.name, matrix->getPixel(0, 0));
+   CHECK(matrix->color565(255, 36, 0) == matrix->getPixel(1, 0), "%s: red matched to %04x after its entry changed",
+         s.name, matrix->getPixel(1, 0));
+
+   delete matrix;
+}
+
+int main()
+{
+   static const setup layouts[] = {
+      {"32x16 8 LINE", 32, 16, 8, LINE},
+      {"32x16 8 ZIGZAG", 32, 16, 8, ZIGZAG},
+      {"32x16 8 ZAGGIZ", 32, 16, 8, ZAGGIZ},
+      {"32x16 4 ZIGZAG", 32, 16, 4, ZIGZAG},
+      {"64x32 16 LINE", 64, 32, 16, LINE},
+      {"64x32 16 ZIGZAG", 64, 32, 16, ZIGZAG},
+      {"64x32 16 ZAGGIZ", 64, 32, 16, ZAGGIZ},
+      {"64x64 32 LINE", 64, 64, 32, LINE},
+   };
+
+   // Every layout both ways of modulating colour
+   for (const setup &layout : layouts)
+   {
+      setup s = layout;
+      s.color_mode = THRESHOLD;
+      check_image(s, binary_colour, 0);
+      check_image(s, ramp_colour, 1);
+      s.color_mode = BCM;
+      check_image(s, binary_colour, 0);
+      check_image(s, ramp_colour, 1);
+   }
+
+   // The ways of sending rows and buffering frames on the board's layout
+   static const setup outputs[] = {
+      {"pipelined", 32, 16, 8, ZAGGIZ, BCM, SPI_PIPELINED},
+      {"pipelined threshold", 32, 16, 8, ZIGZAG, THRESHOLD, SPI_PIPELINED},
+      {"pipelined 64x64", 64, 64, 32, LINE, BCM, SPI_PIPELINED},
+      {"quad", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, true},
+      {"quad pipelined", 64, 32, 16, LINE, BCM, SPI_PIPELINED, false, false, true},
+      {"quad on native pins", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, true, false, false, false, 22, 21},
+      {"quad on address", 64, 32, 16, LINE, BCM, SPI_BLOCKING, false, false, true, false, false, false, PIN_WP, PIN_D},
+      {"rmt oe", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, false, true},
+      {"rotated", 32, 32, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, true},
+      {"streaming", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, true},
+      {"streaming pipelined", 64, 32, 16, ZIGZAG, THRESHOLD, SPI_PIPELINED, true},
+      {"streaming rotated", 32, 32, 8, LINE, BCM, SPI_BLOCKING, true, true},
+      {"triple buffer", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, false, false, true},
+      {"dma chain", 32, 16, 8, ZAGGIZ, BCM, SPI_DMA_CHAIN},
+      {"dma chain threshold", 64, 32, 16, ZIGZAG, THRESHOLD, SPI_DMA_CHAIN},
+      {"dma chain 64x64", 64, 64, 32, LINE, BCM, SPI_DMA_CHAIN},
+      {"dma chain triple buffer", 32, 16, 8, ZAGGIZ, BCM, SPI_DMA_CHAIN, false, false, false, false, true},
+      {"psram", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, false, false, false, false, 0, 0, false, 1},
+      {"psram pipelined", 64, 32, 16, ZIGZAG, THRESHOLD, SPI_PIPELINED, false, false, false, false, true, false, 0, 0, false, 1},
+   };
+
+   for (const setup &s : outputs)
+   {
+      check_image(s, binary_colour, 0);
+      check_image(s, ramp_colour, 1);
+      if (SPI_DMA_CHAIN == s.output_mode)
+         check_show_time(s);
+      if (s.triple_buffer)
+         check_dropped(s);
+      if (s.psram_threshold)
+         check_memory(s);
+      if (SPI_PIPELINED == s.output_mode)
+         check_pipe_blocks(s);
+   }
+
+   // Panels of 32x16 chained, then square ones mounted turned. TILE_90 puts
+   // the panel's bottom left corner at the top left of its tile, TILE_270
+   // its top right
+   static const tile_case tiled[] = {
+      {{"2x1 tiles", 64, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING}, 2, 1, TILE_ROW_MAJOR, {},
+       {{0, 0, 0, 0}, {31, 15, 31, 15}, {32, 0, 32, 0}, {63, 15, 63, 15}, {40, 5, 40, 5}, {9, 12, 9, 12}}},
+      {{"1x2 tiles", 64, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING}, 1, 2, TILE_ROW_MAJOR, {},
+       {{0, 0, 0, 0}, {31, 15, 31, 15}, {0, 16, 32, 0}, {31, 31, 63, 15}, {5, 20, 37, 4}, {9, 12, 9, 12}}},
+      {{"2x2 tiles", 128, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING}, 2, 2, TILE_ROW_MAJOR, {},
+       {{0, 0, 0, 0}, {33, 1, 33, 1}, {2, 17, 66, 1}, {35, 18, 99, 2}, {63, 31, 127, 15}, {31, 16, 95, 0}}},
+      {{"2x2 serpentine", 128, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING}, 2, 2, TILE_SERPENTINE, {},
+       {{0, 0, 0, 0}, {33, 1, 33, 1}, {2, 17, 98, 1}, {35, 18, 67, 2}, {63, 31, 95, 15}, {31, 16, 127, 0}}},
+      {{"tiles at 90 and 180", 64, 32, 16, LINE, BCM, SPI_BLOCKING}, 2, 1, TILE_ROW_MAJOR, {TILE_90, TILE_180},
+       {{1, 0, 0, 30}, {0, 2, 2, 31}, {31, 31, 31, 0}, {33, 0, 62, 31}, {32, 2, 63, 29}, {63, 31, 32, 0}}},
+      {{"tiles at 270 and 0", 64, 32, 16, LINE, BCM, SPI_BLOCKING}, 1, 2, TILE_ROW_MAJOR, {TILE_270, TILE_0},
+       {{1, 0, 31, 1}, {0, 2, 29, 0}, {31, 31, 0, 31}, {1, 32, 33, 0}, {0, 34, 32, 2}, {31, 63, 63, 31}}},
+   };
+   for (const tile_case &c : tiled)
+      check_tiles(c);
+
+   // Depth changes go through the shadow, streamed frames need none
+   static const setup depths[] = {
+      {"depth", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, false, false, false, false, 0, 0, false, 0, true},
+      {"depth threshold", 32, 16, 8, ZIGZAG, THRESHOLD, SPI_BLOCKING, false, false, false, false, false, false, 0, 0, false, 0, true},
+      {"depth pipelined", 64, 32, 16, LINE, BCM, SPI_PIPELINED, false, false, false, false, false, false, 0, 0, false, 0, true},
+      {"depth triple buffer", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, false, false, false, false, true, false, 0, 0, false, 0, true},
+      {"depth streaming", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, true},
+      {"depth streaming triple buffer", 32, 16, 8, ZAGGIZ, THRESHOLD, SPI_BLOCKING, true, false, false, false, true},
+   };
+   for (const setup &s : depths)
+      check_depth_change(s);
+
+   static const setup indexed = {"indexed", 32, 16, 8, ZAGGIZ, BCM, SPI_BLOCKING, true, false, false, false, false, false, 0, 0, true};
+   check_image(indexed, binary_colour, 0);
+   check_palette(indexed);
+
+   // Threshold slots are 32 apart at full depth, 80 is halfway between two.
+   // Streaming moves the phase on every cycle, encoded buffers every frame
+   // handed over
+   static const setup dithered[] = {
+      {"dither streaming", 32, 16, 8, ZAGGIZ, THRESHOLD, SPI_BLOCKING, true, false, false, false, false, true},
+      {"dither encoded", 32, 16, 8, ZAGGIZ, THRESHOLD, SPI_BLOCKING, false, false, false, false, false, true},
+      {"dither triple buffer", 32, 16, 8, ZAGGIZ, THRESHOLD, SPI_BLOCKING, false, false, false, false, true, true},
+      {"dither dma chain", 32, 16, 8, ZAGGIZ, THRESHOLD, SPI_DMA_CHAIN, false, false, false, false, false, true},
+   };
+   for (const setup &s : dithered)
+      check_dither(s, 80, 16);
+
+   return test_summary("test_panel");
+}
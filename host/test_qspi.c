@@ -0,0 +1,63 @@
+/****************************************************************
+ * Checks every lane of the quad SPI interleave carries its quarter of the
+ * row in the order one lane would have sent it
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "PxMatrixQspi.h"
+#include "test.h"
+
+#define ROW_MAX 192
+
+// Bit the lane carries on a clock, nibbles go out high first
+static uint8_t sent_bit(const uint8_t *out, uint32_t clock, uint8_t lane)
+{
+   return (out[clock / 2] >> (((clock & 1) ? 0 : 4) + lane)) & 1;
+}
+
+static void check_row(const uint8_t *row, uint16_t row_size)
+{
+   uint8_t out[ROW_MAX + 1];
+   uint16_t quarter = row_size / PXMATRIX_QSPI_LANES;
+
+   memset(out, 0xA5, sizeof(out));
+   pxmatrix_qspi_interleave(out, row, row_size);
+   CHECK(0xA5 == out[row_size], "%d bytes: wrote past the row", row_size);
+
+   for (uint8_t lane = 0; lane < PXMATRIX_QSPI_LANES; lane++)
+   {
+      for (uint32_t clock = 0; clock < (uint32_t)quarter * 8; clock++)
+      {
+         uint8_t want = (row[(lane * quarter) + (clock / 8)] >> (7 - (clock % 8))) & 1;
+         CHECK(want == sent_bit(out, clock, lane), "%d bytes: lane %d clock %u sends %d", row_size, lane, clock, !want);
+      }
+   }
+}
+
+int main(void)
+{
+   uint8_t row[ROW_MAX];
+
+   // One bit set at a time finds any lane or clock swapped
+   for (uint16_t bit = 0; bit < 12 * 8; bit++)
+   {
+      memset(row, 0, sizeof(row));
+      row[bit / 8] = 0x80 >> (bit % 8);
+      check_row(row, 12);
+   }
+
+   // Every row size that splits over the lanes, well past the panels here
+   srand(1);
+   for (uint16_t size = 4; size <= ROW_MAX; size += 4)
+   {
+      for (uint16_t idx = 0; idx < size; idx++)
+         row[idx] = rand();
+      check_row(row, size);
+   }
+
+   return test_summary("test_qspi");
+}
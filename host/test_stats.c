@@ -0,0 +1,147 @@
+/****************************************************************
+ * Checks the timing statistics buckets and percentiles against the exact
+ * values of the samples sorted
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "PxMatrixStats.h"
+#include "test.h"
+
+#define SAMPLES 5000
+
+static uint32_t samples[SAMPLES];
+
+// Smallest value in the same bucket as value, and how many share it
+static void bucket_range(uint32_t value, uint64_t *low, uint64_t *width)
+{
+   if (value < 8)
+   {
+      *low = value;
+      *width = 1;
+      return;
+   }
+
+   uint8_t msb = 31 - __builtin_clz(value);
+   *width = 1ULL << (msb - 2);
+   *low = value & ~(*width - 1);
+}
+
+static void check_bucket(uint32_t value)
+{
+   uint64_t low, width;
+   uint8_t bucket = pxmatrix_stats_bucket(value);
+
+   bucket_range(value, &low, &width);
+   CHECK(bucket < PXMATRIX_STATS_BUCKETS, "%u in bucket %d", value, bucket);
+   CHECK((value < 8) || ((width * 4) <= low), "%u shares a bucket %u wide from %u", value, (unsigned)width, (unsigned)low);
+
+   // The first value of the bucket opens it, the one before is in the last
+   if ((low == value) && (0 != value))
+      CHECK(pxmatrix_stats_bucket(value - 1) + 1 == bucket, "%u in bucket %d, %u in %d",
+            value, bucket, value - 1, pxmatrix_stats_bucket(value - 1));
+   else if (0 != value)
+      CHECK(pxmatrix_stats_bucket(value - 1) == bucket, "%u in bucket %d, %u in %d",
+            value, bucket, value - 1, pxmatrix_stats_bucket(value - 1));
+}
+
+static int compare(const void *a, const void *b)
+{
+   uint32_t x = *(const uint32_t *)a;
+   uint32_t y = *(const uint32_t *)b;
+   return (x > y) - (x < y);
+}
+
+// Every percentile in the bucket of the exact one, within a quarter of it,
+// and min and max exact
+static void check_samples(const char *name, uint32_t count)
+{
+   pxmatrix_stats_t stats;
+   uint64_t total = 0;
+
+   pxmatrix_stats_reset(&stats);
+   for (uint32_t idx = 0; idx < count; idx++)
+   {
+      pxmatrix_stats_add(&stats, samples[idx]);
+      total += samples[idx];
+   }
+   qsort(samples, count, sizeof(samples[0]), compare);
+
+   CHECK(stats.count == count, "%s: %u samples counted of %u", name, stats.count, count);
+   CHECK(stats.total == total, "%s: total %llu, wants %llu", name, (unsigned long long)stats.total, (unsigned long long)total);
+   CHECK(stats.min == samples[0], "%s: min %u, wants %u", name, stats.min, samples[0]);
+   CHECK(stats.max == samples[count - 1], "%s: max %u, wants %u", name, stats.max, samples[count - 1]);
+
+   for (uint8_t percent = 0; percent <= 100; percent++)
+   {
+      uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+      uint32_t want = samples[(rank > 0) ? rank - 1 : 0];
+      uint32_t got = pxmatrix_stats_percentile(&stats, percent);
+      uint64_t low, width;
+
+      bucket_range(want, &low, &width);
+      CHECK((got >= low) && (got < low + width), "%s: %d%% is %u, wants %u in its bucket from %u",
+            name, percent, got, want, (unsigned)low);
+      CHECK((got >= stats.min) && (got <= stats.max), "%s: %d%% is %u outside %u to %u",
+            name, percent, got, stats.min, stats.max);
+   }
+}
+
+int main(void)
+{
+   pxmatrix_stats_t stats;
+
+   // Small values exactly, then every bucket edge up to the top
+   for (uint32_t value = 0; value < (1 << 16); value++)
+      check_bucket(value);
+   for (uint8_t msb = 16; msb < 32; msb++)
+   {
+      for (uint32_t step = 0; step < 4; step++)
+      {
+         uint32_t edge = (4 | step) << (msb - 2);
+         check_bucket(edge - 1);
+         check_bucket(edge);
+         check_bucket(edge + 1);
+      }
+   }
+   check_bucket(UINT32_MAX);
+
+   pxmatrix_stats_reset(&stats);
+   CHECK(0 == pxmatrix_stats_percentile(&stats, 50), "no samples gives %u", pxmatrix_stats_percentile(&stats, 50));
+
+   // One value over and over comes back as itself
+   for (uint32_t idx = 0; idx < SAMPLES; idx++)
+      samples[idx] = 12345;
+   check_samples("constant", SAMPLES);
+
+   // Row times spread evenly, small ones and a long tail
+   srand(1);
+   for (uint32_t idx = 0; idx < SAMPLES; idx++)
+      samples[idx] = 1000 + (rand() % 9000);
+   check_samples("even", SAMPLES);
+
+   for (uint32_t idx = 0; idx < SAMPLES; idx++)
+      samples[idx] = rand() % 16;
+   check_samples("small", SAMPLES);
+
+   for (uint32_t idx = 0; idx < SAMPLES; idx++)
+      samples[idx] = ((idx % 100) == 0) ? 1000000 + (rand() % 1000000) : 2000 + (rand() % 200);
+   check_samples("tail", SAMPLES);
+
+   for (uint32_t idx = 0; idx < SAMPLES; idx++)
+      samples[idx] = (uint32_t)rand() << (rand() % 8);
+   check_samples("wide", SAMPLES);
+
+   check_samples("one", 1);
+
+   // Small values have a bucket each, so the rank has to be exact
+   samples[0] = 5;
+   samples[1] = 1;
+   samples[2] = 2;
+   check_samples("three", 3);
+
+   return test_summary("test_stats");
+}
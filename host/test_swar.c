@@ -0,0 +1,84 @@
+/****************************************************************
+ * Checks the byte at a time encoder kernel against working every bit out
+ * on its own
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "PxMatrixSwar.h"
+#include "test.h"
+
+static void check_transpose(const uint8_t in[8])
+{
+   uint8_t out[8];
+
+   pxmatrix_swar_transpose8(out, in);
+   for (uint8_t i = 0; i < 8; i++)
+   {
+      for (uint8_t j = 0; j < 8; j++)
+      {
+         uint8_t want = (in[j] >> i) & 1;
+         CHECK(((out[i] >> j) & 1) == want, "bit %d of row %d is %d, wants %d", j, i, !want, want);
+      }
+   }
+}
+
+// Values step bytes apart through a random lut, both ways round
+static void check_encode(size_t step, bool reverse)
+{
+   uint8_t lut[256];
+   uint8_t values[8 * 3];
+   uint8_t slots[8];
+
+   for (uint16_t idx = 0; idx < 256; idx++)
+      lut[idx] = rand();
+   for (uint8_t idx = 0; idx < sizeof(values); idx++)
+      values[idx] = rand();
+
+   pxmatrix_swar_encode8(slots, values, step, lut, reverse);
+   for (uint8_t plane = 0; plane < 8; plane++)
+   {
+      for (uint8_t pixel = 0; pixel < 8; pixel++)
+      {
+         uint8_t want = (lut[values[pixel * step]] >> plane) & 1;
+         uint8_t bit = reverse ? 7 - pixel : pixel;
+         CHECK(((slots[plane] >> bit) & 1) == want, "step %d%s: plane %d of pixel %d is %d",
+               (int)step, reverse ? " reversed" : "", plane, pixel, !want);
+      }
+   }
+}
+
+int main(void)
+{
+   uint8_t in[8];
+
+   // One bit set at a time finds any bit moved to the wrong place
+   for (uint8_t bit = 0; bit < 64; bit++)
+   {
+      memset(in, 0, sizeof(in));
+      in[bit / 8] = 1 << (bit % 8);
+      check_transpose(in);
+   }
+
+   srand(1);
+   for (uint16_t round = 0; round < 1000; round++)
+   {
+      for (uint8_t idx = 0; idx < 8; idx++)
+         in[idx] = rand();
+      check_transpose(in);
+   }
+
+   // One colour of RGB888 pixels is 3 bytes apart, of a single channel 1
+   for (uint16_t round = 0; round < 100; round++)
+   {
+      check_encode(1, false);
+      check_encode(1, true);
+      check_encode(3, false);
+      check_encode(3, true);
+   }
+
+   return test_summary("test_swar");
+}
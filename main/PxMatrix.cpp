@@ -10,7 +10,33 @@
 #include <stdlib.h>
 #include <string.h>
 #include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+#include "driver/rmt.h"
+#include "driver/timer.h"
+#include "esp_attr.h"
+#include "esp_intr_alloc.h"
+#include "esp32/rom/gpio.h"
+#include "soc/dport_reg.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/gpio_struct.h"
+#include "soc/soc.h"
+#include "soc/spi_reg.h"
+#include "soc/spi_struct.h"
+#include "soc/soc_memory_layout.h"
+#include "esp32/clk.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "xtensa/hal.h"
+#include "soc/i2s_struct.h"
+#include "soc/i2s_reg.h"
 #include "PxMatrix.h"
+#include "PxMatrixT.h"
+#include "PxMatrixDma.h"
+#include "PxMatrixI2s.h"
+#include "PxMatrixOe.h"
+#include "PxMatrixQspi.h"
+#include "PxMatrixStats.h"
+#include "PxMatrixSwar.h"
 
 //#define USE_HSPI
 
@@ -20,14 +46,45 @@
   #define SPI_BUS_MOSI 13
   #define SPI_BUS_MISO 12
   #define SPI_BUS_SS 4
+  #define SPI_BUS_WP 2
+  #define SPI_BUS_HD 4
+  #define SPI_HW SPI2
+  #define SPI_PERIPH_MODULE PERIPH_HSPI_MODULE
+  #define SPI_INTR_SOURCE ETS_SPI2_INTR_SOURCE
+  #define SPI_CLK_OUT_IDX HSPICLK_OUT_IDX
+  #define SPI_MOSI_OUT_IDX HSPID_OUT_IDX
 #else
   #define SPI_HOST_TYPE VSPI_HOST
   #define SPI_BUS_CLK 18
   #define SPI_BUS_MOSI 23
   #define SPI_BUS_MISO 19
   #define SPI_BUS_SS 21
+  #define SPI_BUS_WP 22
+  #define SPI_BUS_HD 21
+  #define SPI_HW SPI3
+  #define SPI_PERIPH_MODULE PERIPH_VSPI_MODULE
+  #define SPI_INTR_SOURCE ETS_SPI3_INTR_SOURCE
+  #define SPI_CLK_OUT_IDX VSPICLK_OUT_IDX
+  #define SPI_MOSI_OUT_IDX VSPID_OUT_IDX
 #endif //
 
+#define SPI_DMA_CHANNEL 2
+#define SPI_CLOCK_SPEED 20000000
+
+// The DMA chain clocks out this zeroed padding ahead of the next row while a
+// row is lit for longer than the shift
+#define DMA_PADDING_SIZE 1024
+#define DMA_HOLD_MAX_SIZE (4 * DMA_PADDING_SIZE)
+
+// Parallel output runs from I2S1 in LCD mode, samples go out at half the clock
+#define I2S_HW I2S1
+#define I2S_CLOCK_SPEED 20000000
+#define I2S_SAMPLES_PER_US (I2S_CLOCK_SPEED / 2000000)
+
+// In BCM mode planes below this are weighted by OE time within one row,
+// planes from it up are weighted by repeating the row
+#define I2S_BCM_REPEAT_PLANE 3
+
 
 #ifndef _BV
 #define _BV(x) (1 << (x))
@@ -35,18 +92,55 @@
 
 #define BIT_BUFFER_SWAP_OK   ( 1 << 0 )
 
-#define color_depth 8
-#define color_step 256 / color_depth
+// Triple buffering handoff, the buffer index and whether it holds a new frame
+#define BUFFER_INDEX_MASK    0x03
+#define BUFFER_FRAME_READY   ( 1 << 2 )
+
+#define color_step (256 / _color_depth)
 #define color_half_step int(color_step / 2)
 #define color_third_step int(color_step / 3)
 #define color_two_third_step int(color_third_step*2)
 
+// RMT channel that times OE pulses
+#define PXMATRIX_OE_CHANNEL RMT_CHANNEL_0
+
+// Timer that ends the show time of pipelined rows, display.c refreshes from
+// TIMER_0 of the same group. 80MHz APB clock / 2 gives 25ns ticks
+#define PXMATRIX_PIPE_TIMER_GROUP TIMER_GROUP_0
+#define PXMATRIX_PIPE_TIMER TIMER_1
+#define PXMATRIX_PIPE_TIMER_DIVIDER 2
+#define PXMATRIX_PIPE_TICKS_PER_US (APB_CLK_FREQ / PXMATRIX_PIPE_TIMER_DIVIDER / 1000000)
+
+// An alarm is set from the counter, so it has to clear the time that takes.
+// On the ESP32 an alarm behind the counter only fires once the counter wraps
+#define PXMATRIX_PIPE_MIN_TICKS PXMATRIX_PIPE_TICKS_PER_US
+
+// Notification bit that wakes the task waiting on the pipelined rows. It is
+// set rather than counted and cleared again, so the task can still count
+// notifications of its own, as display.c does with refresh ticks
+#define PXMATRIX_PIPE_NOTIFY (1UL << 31)
+
+// 4x4 ordered dither pattern, the frame phase is added on top so every pixel
+// walks through all 16 levels
+static const uint8_t dither_pattern[4][4] = {
+   { 0,  8,  2, 10},
+   {12,  4, 14,  6},
+   { 3, 11,  1,  9},
+   {15,  7, 13,  5}
+};
+
+// Colour depth used while fast update is on
+#define FAST_UPDATE_COLOR_DEPTH 1
+
+// Stream map entry for a bit of a row that no pixel lands on
+#define STREAM_MAP_NONE 0xFFFFFFFF
+
 
 uint16_t PxMatrix::color565(uint8_t r, uint8_t g, uint8_t b) {
   return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
 }
 
-void PxMatrix::init(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B) 
+void PxMatrix::init(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B) 
 {
    _LATCH_PIN = LATCH;
    _OE_PIN = OE;
@@ -58,8 +152,27 @@ void PxMatrix::init(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, ui
    _width = width;
    _height = height;
 
-   _selected_buffer = false;
-   _active_buffer = false;
+   _canvas_width = width;
+   _canvas_height = height;
+   _tiles_x = 1;
+   _tiles_y = 1;
+   _tile_layout = TILE_ROW_MAJOR;
+   _tile_rotation = NULL;
+   _row_offset = NULL;
+
+   _draw_buffer = 0;
+   _active_buffer = 0;
+   _triple_buffer = false;
+   _frame_handoff = 0;
+
+   _next_frame_id = 1;
+   memset(_buffer_frame, 0, sizeof(_buffer_frame));
+   _shown_seq = 0;
+   _shown_frame = 0;
+   _shown_time = 0;
+   _dropped_frames = 0;
+   _present_cb = NULL;
+   _present_arg = NULL;
 
    _color_R_offset = 0;
    _color_G_offset = 0;
@@ -70,16 +183,165 @@ void PxMatrix::init(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, ui
    _test_line_counter = 0;
    _rotate = 0;
    _fast_update = 0;
+   _color_depth = PXMATRIX_COLOR_DEPTH;
+   _color_depth_setting = PXMATRIX_COLOR_DEPTH;
+   _display_depth = PXMATRIX_COLOR_DEPTH;
+   _pending_depth = 0;
+   _plane_serial = 0;
+   for (uint8_t idx = 0; idx < PXMATRIX_BUFFERS; idx++)
+   {
+      _buffer_depth[idx] = PXMATRIX_COLOR_DEPTH;
+      _buffer_serial[idx] = 0;
+   }
+   _dither = false;
+   _dither_frame = 0;
+   _dither_cycle = 0;
+   _dither_seen = 0;
+
+   buffer[0] = NULL;
+   buffer[1] = NULL;
+   buffer[2] = NULL;
+   flushBuffer = NULL;
+   spi = NULL;
+   xDisplayEventGroup = NULL;
 
    _row_pattern = BINARY;
    _mux_pattern = BINARY;
    _scan_pattern = LINE;
+   memset(&_scan_table, 0, sizeof(_scan_table));
+   _color_mode = THRESHOLD;
+   _output_mode = SPI_BLOCKING;
+
+   _show_time = 0;
+   _pipe_ticks = 0;
+   _pipe_lit = false;
+   _pipe_pending = -1;
+   _pipe_latched = 0;
+   _pipe_task = NULL;
+   vPortCPUInitializeMutex(&_pipe_lock);
+   _row_time = 0;
+
+   _dma_chain[0] = NULL;
+   _dma_chain[1] = NULL;
+   _dma_chain[2] = NULL;
+   _dma_padding = NULL;
+   _dma_actions = NULL;
+   _dma_intr = NULL;
+   _dma_running = false;
+   _dma_stop = false;
+
+   _pixel_map = NULL;
+   _pixel_map_filled = false;
+   _byte_runs = false;
+
+   _i2s_samples[0] = NULL;
+   _i2s_samples[1] = NULL;
+   _i2s_chain[0] = NULL;
+   _i2s_chain[1] = NULL;
+   _i2s_hold = NULL;
+   _i2s_lanes = NULL;
+   _i2s_shown = 0;
+   _i2s_swapping = false;
+
+   _quad_spi = false;
+   _qspi_rows = NULL;
+   _WP_PIN = SPI_BUS_WP;
+   _HD_PIN = SPI_BUS_HD;
+   _POWER_PIN = PXMATRIX_NO_PIN;
+
+   _rmt_oe = false;
+   _oe_items = NULL;
+
+   _streaming = false;
+   _frame[0] = NULL;
+   _frame[1] = NULL;
+   _frame[2] = NULL;
+   _stream_rows = NULL;
+   _stream_map = NULL;
+   memset(&_memory, 0, sizeof(_memory));
+
+   // RGB332 until a palette is set, the masks are worked out at begin
+   _indexed = false;
+   _index_frame[0] = NULL;
+   _index_frame[1] = NULL;
+   _index_frame[2] = NULL;
+   for (uint16_t idx = 0; idx < 256; idx++)
+      _palette[idx] = ((((idx >> 5) * 255) / 7) << 16) | (((((idx >> 2) & 7) * 255) / 7) << 8) | ((idx & 3) * 85);
+   memset(_palette_planes, 0, sizeof(_palette_planes));
+   clear_palette_cache();
+
+   _shadow = false;
+   _shadow_frame[0] = NULL;
+   _shadow_frame[1] = NULL;
+   _shadow_frame[2] = NULL;
+
+   _virtual_width = 0;
+   _virtual_height = 0;
+   _viewport = 0;
+   _viewport_shown = 0;
+
+   resetTimings();
+
+   _psram_threshold = 0;
+   _bounce = false;
 
    memset(&_transactions[0], 0, sizeof(spi_transaction_t));
    memset(&_transactions[1], 0, sizeof(spi_transaction_t));
 
 }
 
+PxMatrix::~PxMatrix()
+{
+   // Nothing may still be reading the buffers once they're freed
+   if (_dma_running)
+      stop_dma_chain();
+   if (NULL != _dma_intr)
+      esp_intr_free(_dma_intr);
+   if (NULL != _i2s_chain[0])
+   {
+      I2S_HW.conf.tx_start = 0;
+      I2S_HW.out_link.stop = 1;
+   }
+   if (SPI_PIPELINED == _output_mode)
+      timer_pause(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER);
+   if (NULL != _oe_items)
+      rmt_driver_uninstall(PXMATRIX_OE_CHANNEL);
+   if (NULL != spi)
+   {
+      spi_bus_remove_device(spi);
+      spi_bus_free(SPI_HOST_TYPE);
+   }
+   if (NULL != xDisplayEventGroup)
+      vEventGroupDelete(xDisplayEventGroup);
+
+   // heap_caps_free and free take NULL
+   for (uint8_t idx = 0; idx < PXMATRIX_BUFFERS; idx++)
+   {
+      heap_caps_free(buffer[idx]);
+      heap_caps_free(_shadow_frame[idx]);
+      heap_caps_free(_frame[idx]);
+      heap_caps_free(_index_frame[idx]);
+      heap_caps_free(_dma_chain[idx]);
+   }
+   for (uint8_t copy = 0; copy < 2; copy++)
+   {
+      heap_caps_free(_i2s_samples[copy]);
+      heap_caps_free(_i2s_chain[copy]);
+   }
+   heap_caps_free(flushBuffer);
+   heap_caps_free(_row_offset);
+   heap_caps_free(_pixel_map);
+   heap_caps_free(_stream_map);
+   heap_caps_free(_stream_rows);
+   heap_caps_free(_qspi_rows);
+   heap_caps_free(_dma_padding);
+   heap_caps_free(_dma_actions);
+   heap_caps_free(_oe_items);
+   heap_caps_free(_i2s_hold);
+   heap_caps_free(_i2s_lanes);
+   free(_tile_rotation);
+}
+
 void PxMatrix::setMuxPattern(mux_patterns mux_pattern)
 {
    _mux_pattern = mux_pattern;
@@ -97,9 +359,209 @@ void PxMatrix::setMuxPattern(mux_patterns mux_pattern)
    }
 }
 
-void PxMatrix::setScanPattern(scan_patterns scan_pattern)
+bool PxMatrix::setScanPattern(scan_patterns scan_pattern)
+{
+   // A table has to be loaded with setScanTable
+   if (CUSTOM == scan_pattern)
+      return false;
+
+   return set_scan(scan_pattern, NULL);
+}
+
+bool PxMatrix::setScanTable(const pxmatrix_scan_table *table)
+{
+   if ((0 == table->block_width) || (0 == table->columns) || (0 == table->rows) ||
+       ((table->rows * table->columns) > PXMATRIX_SCAN_TABLE_SIZE))
+      return false;
+
+   return set_scan(CUSTOM, table);
+}
+
+bool PxMatrix::set_scan(scan_patterns scan_pattern, const pxmatrix_scan_table *table)
 {
+   scan_patterns previous = _scan_pattern;
+   pxmatrix_scan_table previous_table;
+   memcpy(&previous_table, &_scan_table, sizeof(_scan_table));
+
    _scan_pattern = scan_pattern;
+   if (NULL != table)
+      memcpy(&_scan_table, table, sizeof(_scan_table));
+   if (build_pixel_map())
+      return true;
+
+   _scan_pattern = previous;
+   memcpy(&_scan_table, &previous_table, sizeof(_scan_table));
+   build_pixel_map();
+   return false;
+}
+
+void PxMatrix::build_scan_table()
+{
+   memset(&_scan_table, 0, sizeof(_scan_table));
+   _scan_table.block_width = 8;
+   _scan_table.columns = 1;
+
+   switch (_scan_pattern)
+   {
+   case ZIGZAG:
+      // Every byte of a row is followed by the byte of the row one sector down
+      _scan_table.rows = _row_pattern * 2;
+      for (uint8_t row = 0; row < _row_pattern; row++)
+         _scan_table.entries[row] = 1;
+      break;
+   case ZAGGIZ:
+      // Bytes of the first 4 rows out of every 8 are reversed
+      _scan_table.rows = (_row_pattern < 8) ? 8 : _row_pattern;
+      for (uint8_t row = 0; row < _scan_table.rows; row++)
+         _scan_table.entries[row] = (row / _row_pattern) | (((row % 8) < 4) ? PXMATRIX_SCAN_REVERSE : 0);
+      break;
+   default:
+      _scan_table.rows = _row_pattern;
+      break;
+   }
+}
+
+bool PxMatrix::scan_table_fits()
+{
+   uint16_t band_width = _scan_table.columns * _scan_table.block_width;
+
+   if ((0 == band_width) || (0 == _scan_table.rows) || (_scan_table.rows % _row_pattern) ||
+       (_height % _scan_table.rows) || (_width % band_width))
+      return false;
+
+   // Every block position of a band must be used once in each scan row
+   uint8_t band_blocks = (_scan_table.rows / _row_pattern) * _scan_table.columns;
+   for (uint8_t scan_row = 0; scan_row < _row_pattern; scan_row++)
+   {
+      uint32_t used[PXMATRIX_SCAN_TABLE_SIZE / 32] = {0};
+      for (uint8_t row = scan_row; row < _scan_table.rows; row += _row_pattern)
+      {
+         for (uint8_t column = 0; column < _scan_table.columns; column++)
+         {
+            uint8_t block = _scan_table.entries[(row * _scan_table.columns) + column] & ~PXMATRIX_SCAN_REVERSE;
+            if ((block >= band_blocks) || (used[block / 32] & (1UL << (block % 32))))
+               return false;
+            used[block / 32] |= 1UL << (block % 32);
+         }
+      }
+   }
+
+   return true;
+}
+
+void PxMatrix::setOutputMode(output_modes output_mode)
+{
+   _output_mode = output_mode;
+}
+
+void PxMatrix::setQuadSpi(bool quad_spi)
+{
+   _quad_spi = quad_spi;
+}
+
+void PxMatrix::setQuadSpiPins(uint8_t WP, uint8_t HD)
+{
+   _WP_PIN = WP;
+   _HD_PIN = HD;
+}
+
+void PxMatrix::setPowerPin(uint8_t POWER)
+{
+   _POWER_PIN = POWER;
+}
+
+void PxMatrix::setRmtOe(bool rmt_oe)
+{
+   _rmt_oe = rmt_oe;
+}
+
+void PxMatrix::setStreaming(bool streaming)
+{
+   _streaming = streaming;
+   if (!streaming)
+   {
+      _indexed = false;
+      _virtual_width = 0;
+      _virtual_height = 0;
+   }
+}
+
+void PxMatrix::setShadow(bool shadow)
+{
+   _shadow = shadow;
+}
+
+void PxMatrix::setIndexed(bool indexed)
+{
+   _indexed = indexed;
+   if (indexed)
+      _streaming = true;
+}
+
+void PxMatrix::setPsramThreshold(uint32_t threshold)
+{
+   _psram_threshold = threshold;
+}
+
+void *PxMatrix::allocFrame(size_t size)
+{
+   return alloc_frame(size, 1, MALLOC_CAP_8BIT);
+}
+
+void PxMatrix::setParallelPins(uint8_t R1, uint8_t G1, uint8_t B1, uint8_t R2, uint8_t G2, uint8_t B2, uint8_t CLK)
+{
+   _R1_PIN = R1;
+   _G1_PIN = G1;
+   _B1_PIN = B1;
+   _R2_PIN = R2;
+   _G2_PIN = G2;
+   _B2_PIN = B2;
+   _CLK_PIN = CLK;
+}
+
+uint32_t PxMatrix::getRowTime()
+{
+   return _row_time;
+}
+
+void PxMatrix::getMemoryUsage(pxmatrix_memory *memory)
+{
+   *memory = _memory;
+}
+
+static uint32_t cycles_to_ns(uint64_t cycles, uint32_t mhz)
+{
+   uint64_t ns = cycles * 1000 / mhz;
+   return ns > UINT32_MAX ? UINT32_MAX : ns;
+}
+
+bool PxMatrix::getTiming(pxmatrix_timings timing, pxmatrix_timing *summary)
+{
+   memset(summary, 0, sizeof(*summary));
+   if (timing >= PXMATRIX_TIMINGS)
+      return false;
+
+   // Copy first, display() keeps adding samples while this runs
+   pxmatrix_stats_t stats = _timings[timing];
+   if (0 == stats.count)
+      return false;
+
+   uint32_t mhz = esp_clk_cpu_freq() / 1000000;
+   summary->count = stats.count;
+   summary->min = cycles_to_ns(stats.min, mhz);
+   summary->avg = cycles_to_ns(stats.total / stats.count, mhz);
+   summary->max = cycles_to_ns(stats.max, mhz);
+   summary->p50 = cycles_to_ns(pxmatrix_stats_percentile(&stats, 50), mhz);
+   summary->p90 = cycles_to_ns(pxmatrix_stats_percentile(&stats, 90), mhz);
+   summary->p99 = cycles_to_ns(pxmatrix_stats_percentile(&stats, 99), mhz);
+   return true;
+}
+
+void PxMatrix::resetTimings()
+{
+   for (uint8_t idx = 0; idx < PXMATRIX_TIMINGS; idx++)
+      pxmatrix_stats_reset(&_timings[idx]);
+   _cycle_start = 0;
 }
 
 void PxMatrix::flushDisplay()
@@ -112,6 +574,7 @@ void PxMatrix::flushDisplay()
    _transactions[0].flags = SPI_TRANS_USE_RXDATA;
    _transactions[0].rxlength = 0;
    _transactions[0].tx_buffer = flushBuffer;
+   _transactions[0].user = NULL;
 
    ret = spi_device_queue_trans(spi, &_transactions[0], portMAX_DELAY);
    ESP_ERROR_CHECK(ret);
@@ -121,33 +584,175 @@ void PxMatrix::flushDisplay()
 
 void PxMatrix::setRotate(bool rotate)
 {
+   // A virtual canvas is only made big enough for the panel as it was at
+   // begin, the rows sent would read past it
+   uint16_t turned_width = rotate ? _height : _width;
+   uint16_t turned_height = rotate ? _width : _height;
+   if ((NULL != _stream_map) && _virtual_width && ((_virtual_width < turned_width) || (_virtual_height < turned_height)))
+   {
+      printf("Virtual canvas %dx%d is smaller than the panel turned\n", _virtual_width, _virtual_height);
+      return;
+   }
+
    _rotate = rotate;
+   build_pixel_map();
+}
+
+void PxMatrix::setTileLayout(uint8_t tiles_x, uint8_t tiles_y, tile_layouts layout)
+{
+   uint16_t tiles = tiles_x * tiles_y;
+
+   if ((0 == tiles) || (_width % (tiles * 8)))
+   {
+      printf("Chain of width %d can't be split into %d tiles\n", _width, tiles);
+      return;
+   }
+
+   if (NULL != _tile_rotation)
+      free(_tile_rotation);
+
+   _tiles_x = tiles_x;
+   _tiles_y = tiles_y;
+   _tile_layout = layout;
+   _tile_rotation = (tile_rotations *)calloc(tiles, sizeof(tile_rotations));
+   _canvas_width = (_width / tiles) * tiles_x;
+   _canvas_height = _height * tiles_y;
+   build_pixel_map();
+}
+
+void PxMatrix::setTileRotation(uint8_t tile, tile_rotations rotation)
+{
+   if ((NULL == _tile_rotation) || (tile >= (_tiles_x * _tiles_y)))
+      return;
+
+   // Turning by a quarter only fits square panels
+   if (((TILE_90 == rotation) || (TILE_270 == rotation)) && ((_width / (_tiles_x * _tiles_y)) != _height))
+   {
+      printf("Tile %d is not square, it can't be turned by 90 degrees\n", tile);
+      return;
+   }
+
+   _tile_rotation[tile] = rotation;
+   build_pixel_map();
+}
+
+uint16_t PxMatrix::width()
+{
+   return _rotate ? _canvas_height : _canvas_width;
+}
+
+uint16_t PxMatrix::height()
+{
+   return _rotate ? _canvas_width : _canvas_height;
+}
+
+void PxMatrix::setVirtualSize(uint16_t width, uint16_t height)
+{
+   _virtual_width = width;
+   _virtual_height = height;
+   if (width || height)
+      _streaming = true;
+}
+
+uint16_t PxMatrix::virtualWidth()
+{
+   return _virtual_width ? _virtual_width : width();
+}
+
+uint16_t PxMatrix::virtualHeight()
+{
+   return _virtual_height ? _virtual_height : height();
+}
+
+void PxMatrix::setViewport(int16_t x, int16_t y)
+{
+   int32_t frame_width = virtualWidth();
+   int32_t frame_height = virtualHeight();
+
+   x = ((x % frame_width) + frame_width) % frame_width;
+   y = ((y % frame_height) + frame_height) % frame_height;
+   _viewport = ((uint32_t)y << 16) | x;
 }
 
 void PxMatrix::setFastUpdate(bool fast_update)
 {
+   if (!depth_changeable())
+      return;
+
    _fast_update = fast_update;
+   apply_color_depth();
+}
+
+bool PxMatrix::setColorDepth(uint8_t color_depth)
+{
+   if ((color_depth < 1) || (color_depth > PXMATRIX_COLOR_DEPTH) || !depth_changeable())
+      return false;
+
+   _color_depth_setting = color_depth;
+   apply_color_depth();
+   return true;
+}
+
+uint8_t PxMatrix::getColorDepth()
+{
+   return _display_depth;
+}
+
+void PxMatrix::setDither(bool dither)
+{
+   _dither = dither;
+   build_plane_lut();
+   build_pixel_map();
+   encode_draw_buffer();
+}
+
+bool PxMatrix::depth_changeable()
+{
+   // The DMA driven modes build their descriptor chains for the depth at begin
+   if ((NULL != buffer[0]) && ((SPI_DMA_CHAIN == _output_mode) || (I2S_PARALLEL == _output_mode)))
+      return false;
+
+   return true;
+}
+
+void PxMatrix::apply_color_depth()
+{
+   uint8_t depth = _fast_update ? FAST_UPDATE_COLOR_DEPTH : _color_depth_setting;
+
+   // Streamed rows are encoded with the plane tables as they are sent, so
+   // display() switches between colour cycles
+   if (_streaming && (NULL != _stream_rows))
+   {
+      _pending_depth = depth;
+      return;
+   }
+
+   // The buffers shown keep the depth they were encoded for, the others are
+   // encoded again when they come back for drawing
+   _color_depth = depth;
+   build_plane_lut();
+   encode_draw_buffer();
 }
 
-PxMatrix::PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B)
+PxMatrix::PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B)
 {
    init(width, height, LATCH, OE, A, B);
 }
 
-PxMatrix::PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C)
+PxMatrix::PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C)
 {
    _C_PIN = C;
    init(width, height, LATCH, OE, A, B);
 }
 
-PxMatrix::PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D)
+PxMatrix::PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D)
 {
    _C_PIN = C;
    _D_PIN = D;
    init(width, height, LATCH, OE, A, B);
 }
 
-PxMatrix::PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
+PxMatrix::PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
 {
    _C_PIN = C;
    _D_PIN = D;
@@ -157,145 +762,1348 @@ PxMatrix::PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uin
 
 void PxMatrix::clearDisplay(void)
 {
+   if (_streaming)
+   {
+      if (_indexed && (NULL != _index_frame[_draw_buffer]))
+         memset(_index_frame[_draw_buffer], palette_index(0, 0, 0), virtualWidth() * virtualHeight());
+      else if (NULL != _frame[_draw_buffer])
+         memset(_frame[_draw_buffer], 0, virtualWidth() * virtualHeight() * sizeof(uint16_t));
+      return;
+   }
+
+   if (NULL == buffer[_draw_buffer])
+      return;
+
+   // No plane lights a pixel that is all zero bits, whatever the depth
+   memset(buffer[_draw_buffer], 0, _buffer_size * PXMATRIX_COLOR_DEPTH);
+   _buffer_depth[_draw_buffer] = _color_depth;
+   _buffer_serial[_draw_buffer] = _plane_serial;
+   if (NULL != _shadow_frame[_draw_buffer])
+      memset(_shadow_frame[_draw_buffer], 0, width() * height() * sizeof(uint16_t));
 }
 
 void PxMatrix::selectBuffer(bool selected_buffer)
 {
-   _selected_buffer = selected_buffer;
+   // Triple buffering decides for itself which buffer is free
+   if (!_triple_buffer)
+      _draw_buffer = selected_buffer ? 1 : 0;
 }
 
 void PxMatrix::swapBuffer()
 {
-   xEventGroupWaitBits(xDisplayEventGroup, BIT_BUFFER_SWAP_OK, pdFALSE, pdTRUE, 1000 / portTICK_PERIOD_MS);
-   _selected_buffer = !_selected_buffer;
-}
-
-void PxMatrix::setColorOffset(uint8_t r, uint8_t g, uint8_t b)
-{
+   // Not presented, so it mustn't count as dropped or shown under the id the
+   // buffer held before
+   _buffer_frame[_draw_buffer] = 0;
+   hand_over();
 }
 
-void PxMatrix::fillMatrixBuffer(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, bool selected_buffer)
+void PxMatrix::hand_over()
 {
-   if (_rotate) {
-      uint16_t temp_x = x;
-      x = y;
-      y = _height-1-temp_x;
+   if (_triple_buffer)
+   {
+      // Publish the finished frame and carry on with whichever buffer is free,
+      // if that still holds a presented frame the display never got to it
+      uint32_t handoff = __atomic_exchange_n(&_frame_handoff, _draw_buffer | BUFFER_FRAME_READY, __ATOMIC_ACQ_REL);
+      if ((handoff & BUFFER_FRAME_READY) && (0 != _buffer_frame[handoff & BUFFER_INDEX_MASK]))
+         _dropped_frames++;
+      _draw_buffer = handoff & BUFFER_INDEX_MASK;
    }
-
-   if ((x < 0) || (x >= _width) || (y < 0) || (y >= _height))
-      return;
-
-   x = _width - 1 - x;
-
-   uint8_t buffer_idx = selected_buffer ? 1 : 0;
-   uint32_t base_offset;
-   uint32_t total_offset_r = 0;
-   uint32_t total_offset_g = 0;
-   uint32_t total_offset_b = 0;
-
-   if (4 == _row_pattern)
+   else
    {
+      uint32_t wait_start = xthal_get_ccount();
+      xEventGroupWaitBits(xDisplayEventGroup, BIT_BUFFER_SWAP_OK, pdFALSE, pdTRUE, 1000 / portTICK_PERIOD_MS);
+      pxmatrix_stats_add(&_timings[PXMATRIX_TIME_SWAP_WAIT], xthal_get_ccount() - wait_start);
+      _draw_buffer ^= 1;
+   }
 
-   } 
-   else 
+   // Dithering moves on a phase with every frame handed over once a colour
+   // cycle has gone by, the buffers take it up as they come back
+   if (_dither && !_streaming && (_dither_seen != _dither_cycle))
    {
-      // Handle The Offset
-      base_offset = _row_offset[y] - (x / 8);
-
-      // relies on integer truncation, do not simplify
-      uint8_t vert_sector = y / _row_pattern;
-      total_offset_r = base_offset - vert_sector * _width / 8;
-      total_offset_g = total_offset_r - _pattern_color_bytes;
-      total_offset_b = total_offset_g - _pattern_color_bytes;
+      _dither_seen = _dither_cycle;
+      _dither_frame++;
+      _plane_serial++;
    }
 
-   uint8_t bit_select = x % 8;
-   if ((ZAGGIZ == _scan_pattern) && ((y%8) < 4))
-      bit_select = 7 - bit_select;
+   // Shown until now, so it may still be encoded with older plane tables
+   if (_buffer_serial[_draw_buffer] != _plane_serial)
+      encode_draw_buffer();
+}
 
-   // Colour Interlacing
-   for (int this_color=0; this_color < color_depth; this_color++)
-   {
-      uint8_t color_thresh = this_color * color_step + color_half_step;
+void PxMatrix::setTripleBuffer(bool triple_buffer)
+{
+   _triple_buffer = triple_buffer;
+}
 
-      uint32_t off_r = (this_color * _buffer_size) + total_offset_r;
-      if (r > color_thresh + _color_R_offset)
-         buffer[buffer_idx][off_r] |= _BV(bit_select);
-      else
-         buffer[buffer_idx][off_r] &= ~_BV(bit_select);
+uint32_t PxMatrix::present()
+{
+   uint32_t frame_id = _next_frame_id++;
+   if (0 == _next_frame_id)
+      _next_frame_id = 1;
 
-      uint32_t off_g = (((this_color + color_third_step) % color_depth) * _buffer_size ) + total_offset_g;
+   _buffer_frame[_draw_buffer] = frame_id;
+   hand_over();
+   return frame_id;
+}
 
-      if (g > color_thresh + _color_G_offset)
-         buffer[buffer_idx][off_g] |= _BV(bit_select);
-      else
-         buffer[buffer_idx][off_g] &= ~_BV(bit_select);
+uint32_t PxMatrix::getShownFrame(int64_t *shown_time)
+{
+   uint32_t frame_id;
+   int64_t time;
+   uint32_t seq;
 
-      uint32_t off_b = (((this_color + color_two_third_step) % color_depth) * _buffer_size) + total_offset_b;
-      if (b > color_thresh + _color_B_offset)
-         buffer[buffer_idx][off_b] |= _BV(bit_select);
-      else
-         buffer[buffer_idx][off_b] &= ~_BV(bit_select);
-   }
+   // The display may be halfway through writing both on the other core, an
+   // odd or changed sequence means the copy can be torn
+   do
+   {
+      seq = __atomic_load_n(&_shown_seq, __ATOMIC_ACQUIRE);
+      frame_id = _shown_frame;
+      time = _shown_time;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while ((seq & 1) || (seq != __atomic_load_n(&_shown_seq, __ATOMIC_RELAXED)));
+
+   if (NULL != shown_time)
+      *shown_time = time;
+   return frame_id;
 }
 
-void PxMatrix::drawPixelRGB565(int16_t x, int16_t y, uint16_t color, bool selected_buffer) {
-  uint8_t r = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
-  uint8_t g = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
-  uint8_t b = (((color & 0x1F) * 527) + 23) >> 6;
-  fillMatrixBuffer( x,  y, r, g, b, selected_buffer);
+uint32_t PxMatrix::getDroppedFrames()
+{
+   return _dropped_frames;
 }
 
-void PxMatrix::drawPixelRGB565(int16_t x, int16_t y, uint16_t color) {
-  uint8_t r = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
-  uint8_t g = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
-  uint8_t b = (((color & 0x1F) * 527) + 23) >> 6;
-  fillMatrixBuffer( x,  y, r, g, b, _selected_buffer);
+void PxMatrix::setPresentCallback(pxmatrix_present_cb callback, void *arg)
+{
+   _present_cb = NULL;
+   _present_arg = arg;
+   _present_cb = callback;
 }
 
-void PxMatrix::drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, bool selected_buffer) {
-  fillMatrixBuffer(x, y, r, g, b, selected_buffer);
+void IRAM_ATTR PxMatrix::next_frame()
+{
+   if (!_triple_buffer)
+   {
+      _active_buffer = _draw_buffer;
+   }
+   else if (_frame_handoff & BUFFER_FRAME_READY)
+   {
+      // Only this side clears the flag, so a frame seen here can't go away. Take
+      // the newest one and hand the buffer that was shown back for drawing
+      _active_buffer = __atomic_exchange_n(&_frame_handoff, (uint32_t)_active_buffer, __ATOMIC_ACQ_REL) & BUFFER_INDEX_MASK;
+   }
+   _display_depth = _buffer_depth[_active_buffer];
+
+   // Streamed rows are dithered as they are sent, encoded buffers pick the
+   // cycles up in hand_over
+   _dither_cycle++;
+   if (_streaming)
+      _dither_frame++;
+
+   // Frame ids only go up, a buffer still tagged with an older one is being
+   // redrawn, 0 was swapped in without present
+   uint32_t frame_id = _buffer_frame[_active_buffer];
+   if ((0 == frame_id) || ((int32_t)(frame_id - _shown_frame) <= 0))
+      return;
+
+   // Only written from here, odd while the two below are, see getShownFrame
+   int64_t shown_time = esp_timer_get_time();
+   __atomic_store_n(&_shown_seq, _shown_seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   _shown_time = shown_time;
+   _shown_frame = frame_id;
+   __atomic_store_n(&_shown_seq, _shown_seq + 1, __ATOMIC_RELEASE);
+
+   pxmatrix_present_cb callback = _present_cb;
+   if (NULL != callback)
+      callback(frame_id, shown_time, _present_arg);
 }
 
-void PxMatrix::drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b) {
-  fillMatrixBuffer(x, y, r, g, b, _selected_buffer);
+void PxMatrix::setColorOffset(uint8_t r, uint8_t g, uint8_t b)
+{
+   _color_R_offset = r;
+   _color_G_offset = g;
+   _color_B_offset = b;
+   build_plane_lut();
+   encode_draw_buffer();
 }
 
-void PxMatrix::begin()
+uint32_t PxMatrix::compute_pixel(int16_t x, int16_t y)
 {
-  begin(8);
+   if (_rotate) {
+      uint16_t temp_x = x;
+      x = y;
+      y = _canvas_height-1-temp_x;
+   }
+
+   if (NULL != _tile_rotation)
+      map_tile(&x, &y);
+
+   uint32_t position = scan_position(x, y);
+   uint32_t offset = _row_offset[y] - (position / 8);
+   return (offset << 3) | (position % 8);
 }
 
-void PxMatrix::begin(uint8_t row_pattern)
+uint32_t PxMatrix::scan_position(int16_t x, int16_t y)
 {
-   esp_err_t ret;
+   x = _width - 1 - x;
 
-   _row_pattern = row_pattern;
-   if (4 == _row_pattern)
-      _scan_pattern = ZIGZAG;
+   // Find the band and the block within it from the scan table
+   uint16_t band_width = _scan_table.columns * _scan_table.block_width;
+   uint32_t band = ((y / _scan_table.rows) * (_width / band_width)) + (x / band_width);
+   uint8_t entry = _scan_table.entries[((y % _scan_table.rows) * _scan_table.columns) + ((x % band_width) / _scan_table.block_width)];
 
-   _buffer_size = ((_width * _height * 3) / 8);
-   _pattern_color_bytes = (_height / _row_pattern) * (_width / 8);
-   _send_buffer_size = _pattern_color_bytes * 3;
+   uint8_t in_block = x % _scan_table.block_width;
+   if (entry & PXMATRIX_SCAN_REVERSE)
+      in_block = _scan_table.block_width - 1 - in_block;
 
-   spi_bus_config_t cfg;
-   memset(&cfg, 0, sizeof(spi_bus_config_t));
-   cfg.miso_io_num = SPI_BUS_MISO;
-   cfg.mosi_io_num = SPI_BUS_MOSI;
-   cfg.sclk_io_num = SPI_BUS_CLK;
-   cfg.quadwp_io_num = -1;
-   cfg.quadhd_io_num = -1;
-   cfg.max_transfer_sz = _send_buffer_size;
+   // Position in the shift chain of the scan row, counted from the data input
+   uint32_t band_length = (_scan_table.rows / _row_pattern) * band_width;
+   return (band * band_length) + ((entry & ~PXMATRIX_SCAN_REVERSE) * _scan_table.block_width) + in_block;
+}
 
-//#define buffer_size max_matrix_width * max_matrix_height * 3 / 8
+void PxMatrix::map_tile(int16_t *x, int16_t *y)
+{
+   uint16_t panel_width = _width / (_tiles_x * _tiles_y);
+   uint8_t tile_x = *x / panel_width;
+   uint8_t tile_y = *y / _height;
+   int16_t local_x = *x % panel_width;
+   int16_t local_y = *y % _height;
+   int16_t temp;
+
+   switch (_tile_rotation[(tile_y * _tiles_x) + tile_x])
+   {
+   case TILE_90:
+      temp = local_x;
+      local_x = local_y;
+      local_y = _height - 1 - temp;
+      break;
+   case TILE_180:
+      local_x = panel_width - 1 - local_x;
+      local_y = _height - 1 - local_y;
+      break;
+   case TILE_270:
+      temp = local_x;
+      local_x = panel_width - 1 - local_y;
+      local_y = temp;
+      break;
+   default:
+      break;
+   }
 
-   spi_device_interface_config_t dev; 
-   memset(&dev, 0, sizeof(spi_device_interface_config_t));
-   dev.mode = 0;
-   dev.clock_speed_hz = 20000000;
+   // Position of the panel along the chain
+   uint16_t chain = tile_y * _tiles_x;
+   if ((TILE_SERPENTINE == _tile_layout) && (tile_y & 1))
+      chain += _tiles_x - 1 - tile_x;
+   else
+      chain += tile_x;
+
+   *x = (chain * panel_width) + local_x;
+   *y = local_y;
+}
+
+bool PxMatrix::build_pixel_map()
+{
+   // Built by begin(), later rotation and scan changes rebuild it
+   if ((NULL == _pixel_map) && (NULL == _stream_map))
+      return true;
+
+   int16_t canvas_width = width();
+   int16_t canvas_height = height();
+
+   if (CUSTOM != _scan_pattern)
+      build_scan_table();
+
+   if (!scan_table_fits())
+   {
+      printf("Scan table doesn't fit a %dx%d panel with row pattern %d\n", _width, _height, _row_pattern);
+      return false;
+   }
+
+   // I2S_PARALLEL sends the two halves of the panel on their own lanes
+   if ((NULL != _i2s_lanes) && !map_i2s_lanes())
+   {
+      printf("Scan table doesn't split the panel in two halves\n");
+      return false;
+   }
+
+   // Runs of 8 pixels stay in one byte unless something turns them on end
+   // or the scan table splits them
+   _byte_runs = !_rotate && !(_scan_table.block_width % 8);
+   for (uint16_t tile = 0; (NULL != _tile_rotation) && (tile < (_tiles_x * _tiles_y)); tile++)
+   {
+      if ((TILE_90 == _tile_rotation[tile]) || (TILE_270 == _tile_rotation[tile]))
+         _byte_runs = false;
+   }
+
+   if (NULL != _pixel_map)
+   {
+      _pixel_map_filled = map_needed();
+      for (int16_t yy = 0; _pixel_map_filled && (yy < canvas_height); yy++)
+      {
+         for (int16_t xx = 0; xx < canvas_width; xx++)
+            _pixel_map[(yy * canvas_width) + xx] = compute_pixel(xx, yy);
+      }
+      return true;
+   }
+
+   // Streaming looks pixels up the other way round, by their bit of a row.
+   // Rotating after begin can leave some of the panel off a virtual canvas,
+   // those stay dark
+   memset(_stream_map, 0xff, _width * _height * sizeof(uint32_t));
+   for (int16_t yy = 0; (yy < canvas_height) && (yy < virtualHeight()); yy++)
+   {
+      for (int16_t xx = 0; (xx < canvas_width) && (xx < virtualWidth()); xx++)
+      {
+         uint32_t entry = compute_pixel(xx, yy);
+         uint32_t offset = entry >> 3;
+         uint32_t row = offset / _send_buffer_size;
+         uint32_t position = ((_send_buffer_size - 1 - (offset % _send_buffer_size)) << 3) | (entry & 0x07);
+
+         _stream_map[(row * _pattern_color_bytes * 8) + position] = ((uint32_t)yy << 16) | xx;
+      }
+   }
+   return true;
+}
+
+bool PxMatrix::map_needed()
+{
+   return true;
+}
+
+inline bool PxMatrix::map_pixel(int16_t x, int16_t y, uint32_t *offset, uint8_t *bit)
+{
+   int16_t canvas_width = width();
+   int16_t canvas_height = height();
+
+   if ((x < 0) || (x >= canvas_width) || (y < 0) || (y >= canvas_height))
+      return false;
+
+   uint32_t entry = _pixel_map_filled ? _pixel_map[(y * canvas_width) + x] : compute_pixel(x, y);
+
+   *offset = entry >> 3;
+   *bit = entry & 0x07;
+   return true;
+}
+
+inline void PxMatrix::encode_pixel(uint8_t *buf, uint32_t offset, uint8_t bit_select, uint8_t r, uint8_t g, uint8_t b)
+{
+   uint32_t total_offset_r = offset;
+   uint32_t total_offset_g = total_offset_r - _pattern_color_bytes;
+   uint32_t total_offset_b = total_offset_g - _pattern_color_bytes;
+
+   if (BCM == _color_mode)
+   {
+      // Bit Planes, plane n holds bit n of each colour
+      for (int plane=0; plane < _color_depth; plane++)
+      {
+         uint32_t plane_offset = plane * _buffer_size;
+         uint8_t plane_bit = 8 - _color_depth + plane;
+
+         if (r & _BV(plane_bit))
+            buf[plane_offset + total_offset_r] |= _BV(bit_select);
+         else
+            buf[plane_offset + total_offset_r] &= ~_BV(bit_select);
+
+         if (g & _BV(plane_bit))
+            buf[plane_offset + total_offset_g] |= _BV(bit_select);
+         else
+            buf[plane_offset + total_offset_g] &= ~_BV(bit_select);
+
+         if (b & _BV(plane_bit))
+            buf[plane_offset + total_offset_b] |= _BV(bit_select);
+         else
+            buf[plane_offset + total_offset_b] &= ~_BV(bit_select);
+      }
+      return;
+   }
+
+   // Colour Interlacing
+   for (int this_color=0; this_color < _color_depth; this_color++)
+   {
+      uint8_t color_thresh = this_color * color_step + color_half_step;
+
+      uint32_t off_r = (this_color * _buffer_size) + total_offset_r;
+      if (r > color_thresh + _color_R_offset)
+         buf[off_r] |= _BV(bit_select);
+      else
+         buf[off_r] &= ~_BV(bit_select);
+
+      uint32_t off_g = (((this_color + color_third_step) % _color_depth) * _buffer_size ) + total_offset_g;
+
+      if (g > color_thresh + _color_G_offset)
+         buf[off_g] |= _BV(bit_select);
+      else
+         buf[off_g] &= ~_BV(bit_select);
+
+      uint32_t off_b = (((this_color + color_two_third_step) % _color_depth) * _buffer_size) + total_offset_b;
+      if (b > color_thresh + _color_B_offset)
+         buf[off_b] |= _BV(bit_select);
+      else
+         buf[off_b] &= ~_BV(bit_select);
+   }
+}
+
+inline void PxMatrix::encode_group(uint8_t *buf, uint32_t offset, bool reverse, const uint8_t *rgb)
+{
+   uint8_t slots[8];
+
+   for (uint8_t channel = 0; channel < 3; channel++)
+   {
+      uint32_t channel_offset = offset - (channel * _pattern_color_bytes);
+
+      pxmatrix_swar_encode8(slots, rgb + channel, 3, _plane_lut[channel], reverse);
+      for (uint8_t slot = 0; slot < _color_depth; slot++)
+         buf[(((slot + _plane_rotate[channel]) % _color_depth) * _buffer_size) + channel_offset] = slots[slot];
+   }
+}
+
+void PxMatrix::build_plane_lut()
+{
+   uint8_t offsets[3] = {_color_R_offset, _color_G_offset, _color_B_offset};
+
+   _plane_rotate[0] = 0;
+   _plane_rotate[1] = (BCM == _color_mode) ? 0 : color_third_step % _color_depth;
+   _plane_rotate[2] = (BCM == _color_mode) ? 0 : color_two_third_step % _color_depth;
+
+   for (uint8_t channel = 0; channel < 3; channel++)
+   {
+      for (uint16_t value = 0; value < 256; value++)
+      {
+         uint8_t mask = 0;
+
+         if (BCM == _color_mode)
+         {
+            mask = value >> (8 - _color_depth);
+         }
+         else
+         {
+            // Threshold slots light in order, so this is a thermometer code
+            for (uint8_t slot = 0; slot < _color_depth; slot++)
+            {
+               uint8_t color_thresh = slot * color_step + color_half_step;
+               if (value > color_thresh + offsets[channel])
+                  mask |= _BV(slot);
+            }
+         }
+
+         _plane_lut[channel][value] = mask;
+      }
+
+      // The same from RGB565 fields, green has 6 bits and the others 5
+      for (uint8_t value = 0; value < 64; value++)
+      {
+         uint8_t full = (1 == channel) ? (((value * 259) + 33) >> 6) : ((((value & 0x1F) * 527) + 23) >> 6);
+         _plane_lut565[channel][value] = _plane_lut[channel][full];
+      }
+   }
+
+   // Dithering spreads a value over the colour levels either side of it. A
+   // level is step wide, BCM truncates and THRESHOLD rounds to the nearest
+   uint16_t step = (BCM == _color_mode) ? (1 << (8 - _color_depth)) : color_step;
+   for (uint8_t level = 0; level < 16; level++)
+   {
+      _dither_offset[level] = 0;
+      if (!_dither || (step <= 1))
+         continue;
+
+      _dither_offset[level] = (level * step) / 16;
+      if (BCM != _color_mode)
+         _dither_offset[level] += 1 - color_half_step;
+   }
+
+   resolve_palette(0, 256);
+   _plane_serial++;
+}
+
+void PxMatrix::resolve_palette(uint8_t first, uint16_t count)
+{
+   for (uint16_t idx = first; (idx < first + count) && (idx < 256); idx++)
+   {
+      uint32_t color = _palette[idx];
+      _palette_planes[idx] = _plane_lut[0][(color >> 16) & 0xFF] |
+                             (_plane_lut[1][(color >> 8) & 0xFF] << 8) |
+                             (_plane_lut[2][color & 0xFF] << 16);
+   }
+}
+
+void PxMatrix::clear_palette_cache()
+{
+   memset(_palette_cache, 0xFF, sizeof(_palette_cache));
+}
+
+uint8_t PxMatrix::palette_index(uint8_t r, uint8_t g, uint8_t b)
+{
+   uint32_t color = (r << 16) | (g << 8) | b;
+   // Fibonacci hashing, the high bits mix all three channels
+   uint8_t slot = ((color * 2654435761u) >> 24) & (PXMATRIX_PALETTE_CACHE - 1);
+   if (color == _palette_cache[slot])
+      return _palette_cache_index[slot];
+
+   uint8_t best = 0;
+   uint32_t best_distance = UINT32_MAX;
+   for (uint16_t idx = 0; idx < 256; idx++)
+   {
+      int32_t dr = (int32_t)((_palette[idx] >> 16) & 0xFF) - r;
+      int32_t dg = (int32_t)((_palette[idx] >> 8) & 0xFF) - g;
+      int32_t db = (int32_t)(_palette[idx] & 0xFF) - b;
+      uint32_t distance = (dr * dr) + (dg * dg) + (db * db);
+      if (distance < best_distance)
+      {
+         best = idx;
+         best_distance = distance;
+         if (0 == distance)
+            break;
+      }
+   }
+
+   _palette_cache[slot] = color;
+   _palette_cache_index[slot] = best;
+   return best;
+}
+
+void PxMatrix::setPaletteColor(uint8_t index, uint8_t r, uint8_t g, uint8_t b)
+{
+   _palette[index] = (r << 16) | (g << 8) | b;
+   resolve_palette(index, 1);
+   clear_palette_cache();
+}
+
+void PxMatrix::setPalette(const uint8_t *rgb, uint8_t first, uint16_t count)
+{
+   for (uint16_t idx = 0; (idx < count) && (first + idx < 256); idx++, rgb += 3)
+      _palette[first + idx] = (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+   resolve_palette(first, count);
+   clear_palette_cache();
+}
+
+void PxMatrix::rotatePalette(uint8_t first, uint16_t count, int16_t steps)
+{
+   if (first + count > 256)
+      count = 256 - first;
+   if (count < 2)
+      return;
+
+   uint16_t shift = ((steps % (int16_t)count) + count) % count;
+   if (0 == shift)
+      return;
+
+   // Follow each cycle of the rotation so every entry is written once, with
+   // its new colour and masks, and the display never sees one half moved
+   uint16_t cycles = count;
+   for (uint16_t rem = shift; 0 != rem; )
+   {
+      uint16_t next = cycles % rem;
+      cycles = rem;
+      rem = next;
+   }
+
+   for (uint16_t start = 0; start < cycles; start++)
+   {
+      uint32_t color = _palette[first + start];
+      uint32_t planes = _palette_planes[first + start];
+      uint16_t idx = start;
+      while (true)
+      {
+         uint16_t from = (idx + count - shift) % count;
+         if (from == start)
+            break;
+         _palette[first + idx] = _palette[first + from];
+         _palette_planes[first + idx] = _palette_planes[first + from];
+         idx = from;
+      }
+      _palette[first + idx] = color;
+      _palette_planes[first + idx] = planes;
+   }
+   clear_palette_cache();
+}
+
+void PxMatrix::dither_pixels(uint8_t *rgb, int16_t x, int16_t y, uint8_t count)
+{
+   const uint8_t *pattern = dither_pattern[y & 3];
+
+   for (uint8_t idx = 0; idx < count; idx++)
+   {
+      int16_t offset = _dither_offset[(pattern[(x + idx) & 3] + _dither_frame) & 15];
+
+      for (uint8_t channel = 0; channel < 3; channel++)
+      {
+         // Black stays black, otherwise it would flicker on dark panels
+         if (!rgb[(idx * 3) + channel])
+            continue;
+
+         int16_t value = rgb[(idx * 3) + channel] + offset;
+         rgb[(idx * 3) + channel] = (value < 0) ? 0 : ((value > 255) ? 255 : value);
+      }
+   }
+}
+
+void PxMatrix::encode_stream_row(uint8_t plane, uint8_t row, uint8_t *out)
+{
+   const uint16_t *frame = _frame[_active_buffer];
+   const uint8_t *indices = _index_frame[_active_buffer];
+   const uint32_t *map = &_stream_map[row * _pattern_color_bytes * 8];
+   uint16_t frame_width = virtualWidth();
+   uint16_t frame_height = virtualHeight();
+   uint16_t view_x = _viewport_shown & 0xFFFF;
+   uint16_t view_y = _viewport_shown >> 16;
+   uint8_t masks[3];
+
+   // The colour slot that ends up in this plane, threshold slots are rotated
+   for (uint8_t channel = 0; channel < 3; channel++)
+      masks[channel] = _BV((plane + _color_depth - (_plane_rotate[channel] % _color_depth)) % _color_depth);
+
+   for (uint16_t byte = 0; byte < _pattern_color_bytes; byte++, map += 8)
+   {
+      uint8_t bits[3] = {0, 0, 0};
+
+      for (uint8_t bit = 0; bit < 8; bit++)
+      {
+         if (STREAM_MAP_NONE == map[bit])
+            continue;
+
+         // Panel position to the frame, through the viewport
+         uint16_t x = map[bit] & 0xFFFF;
+         uint16_t y = map[bit] >> 16;
+         uint16_t frame_x = x + view_x;
+         uint16_t frame_y = y + view_y;
+         if (frame_x >= frame_width)
+            frame_x -= frame_width;
+         if (frame_y >= frame_height)
+            frame_y -= frame_height;
+         uint32_t pixel = (frame_y * frame_width) + frame_x;
+
+         uint8_t planes[3];
+
+         if (_dither)
+         {
+            uint8_t rgb[3];
+            if (_indexed)
+            {
+               uint32_t color = _palette[indices[pixel]];
+               rgb[0] = color >> 16;
+               rgb[1] = color >> 8;
+               rgb[2] = color;
+            }
+            else
+            {
+               uint16_t color = frame[pixel];
+               rgb[0] = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
+               rgb[1] = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
+               rgb[2] = (((color & 0x1F) * 527) + 23) >> 6;
+            }
+            dither_pixels(rgb, x, y, 1);
+            planes[0] = _plane_lut[0][rgb[0]];
+            planes[1] = _plane_lut[1][rgb[1]];
+            planes[2] = _plane_lut[2][rgb[2]];
+         }
+         else if (_indexed)
+         {
+            // Resolved when the palette entry was set
+            uint32_t masks = _palette_planes[indices[pixel]];
+            planes[0] = masks;
+            planes[1] = masks >> 8;
+            planes[2] = masks >> 16;
+         }
+         else
+         {
+            uint16_t color = frame[pixel];
+            planes[0] = _plane_lut565[0][color >> 11];
+            planes[1] = _plane_lut565[1][(color >> 5) & 0x3F];
+            planes[2] = _plane_lut565[2][color & 0x1F];
+         }
+
+         for (uint8_t channel = 0; channel < 3; channel++)
+         {
+            if (planes[channel] & masks[channel])
+               bits[channel] |= _BV(bit);
+         }
+      }
+
+      // Red is sent last, blue first
+      out[_send_buffer_size - 1 - byte] = bits[0];
+      out[_send_buffer_size - 1 - byte - _pattern_color_bytes] = bits[1];
+      out[_send_buffer_size - 1 - byte - (2 * _pattern_color_bytes)] = bits[2];
+   }
+}
+
+uint8_t *PxMatrix::fill_row(uint8_t plane, uint8_t row, uint8_t slot)
+{
+   uint8_t *out = &_stream_rows[slot * _send_buffer_size];
+
+   if (_streaming)
+   {
+      encode_stream_row(plane, row, out);
+      return out;
+   }
+
+   // Quad SPI interleaves into internal memory anyway
+   uint8_t *src = &(buffer[_active_buffer][(plane * _buffer_size) + (row * _send_buffer_size)]);
+   if (!_bounce || _quad_spi)
+      return src;
+
+   memcpy(out, src, _send_buffer_size);
+   return out;
+}
+
+void PxMatrix::fillMatrixBuffer(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t buffer_idx)
+{
+   uint32_t offset;
+   uint8_t bit_select;
+
+   // Streaming keeps the frame as it is drawn, dithering is done as it is sent
+   if (_streaming)
+   {
+      if ((x < 0) || (x >= virtualWidth()) || (y < 0) || (y >= virtualHeight()))
+         return;
+
+      if (_indexed)
+         _index_frame[buffer_idx][(y * virtualWidth()) + x] = palette_index(r, g, b);
+      else
+         _frame[buffer_idx][(y * virtualWidth()) + x] = color565(r, g, b);
+      return;
+   }
+
+   if (!map_pixel(x, y, &offset, &bit_select))
+      return;
+
+   shadow_pixel(x, y, r, g, b, buffer_idx);
+
+   if (_dither)
+   {
+      uint8_t rgb[3] = {r, g, b};
+      dither_pixels(rgb, x, y, 1);
+      r = rgb[0];
+      g = rgb[1];
+      b = rgb[2];
+   }
+
+   encode_pixel(buffer[buffer_idx], offset, bit_select, r, g, b);
+}
+
+bool PxMatrix::clip_rect(int16_t *x, int16_t *y, int16_t *w, int16_t *h, int16_t *skip_x, int16_t *skip_y)
+{
+   int16_t canvas_width = virtualWidth();
+   int16_t canvas_height = virtualHeight();
+
+   *skip_x = 0;
+   *skip_y = 0;
+   if (*x < 0)
+   {
+      *skip_x = -*x;
+      *w += *x;
+      *x = 0;
+   }
+   if (*y < 0)
+   {
+      *skip_y = -*y;
+      *h += *y;
+      *y = 0;
+   }
+   if (*x + *w > canvas_width)
+      *w = canvas_width - *x;
+   if (*y + *h > canvas_height)
+      *h = canvas_height - *y;
+
+   return (*w > 0) && (*h > 0);
+}
+
+void PxMatrix::drawRectRGB565(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride)
+{
+   int16_t skip_x, skip_y;
+   if (!clip_rect(&x, &y, &w, &h, &skip_x, &skip_y))
+      return;
+
+   data += (skip_y * stride) + skip_x;
+
+   if (_streaming)
+   {
+      uint16_t canvas_width = virtualWidth();
+      for (int16_t yy = 0; yy < h; yy++, data += stride)
+      {
+         if (!_indexed)
+         {
+            memcpy(&_frame[_draw_buffer][((y + yy) * canvas_width) + x], data, w * sizeof(uint16_t));
+            continue;
+         }
+
+         uint8_t *dst = &_index_frame[_draw_buffer][((y + yy) * canvas_width) + x];
+         for (int16_t xx = 0; xx < w; xx++)
+         {
+            uint16_t color = data[xx];
+            dst[xx] = palette_index(((((color >> 11) & 0x1F) * 527) + 23) >> 6,
+                                    ((((color >> 5) & 0x3F) * 259) + 33) >> 6,
+                                    (((color & 0x1F) * 527) + 23) >> 6);
+         }
+      }
+      return;
+   }
+
+   shadow_rect565(x, y, w, h, data, stride);
+   encode_rect565(buffer[_draw_buffer], x, y, w, h, data, stride);
+}
+
+void PxMatrix::encode_rect565(uint8_t *buf, int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride)
+{
+   for (int16_t yy = 0; yy < h; yy++, data += stride)
+   {
+      const uint16_t *src = data;
+      int16_t xx = 0;
+      while (xx < w)
+      {
+         uint32_t offset;
+         uint8_t bit_select;
+         uint8_t rgb[8 * 3];
+         uint8_t count = 1;
+
+         // Whole bytes of 8 pixels are encoded at once
+         if (_byte_runs && !((x + xx) % 8) && (xx + 8 <= w))
+            count = 8;
+
+         for (uint8_t idx = 0; idx < count; idx++)
+         {
+            uint16_t color = src[idx];
+            rgb[idx * 3] = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
+            rgb[idx * 3 + 1] = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
+            rgb[idx * 3 + 2] = (((color & 0x1F) * 527) + 23) >> 6;
+         }
+
+         if (_dither)
+            dither_pixels(rgb, x + xx, y + yy, count);
+
+         if (map_pixel(x + xx, y + yy, &offset, &bit_select))
+         {
+            if (8 == count)
+               encode_group(buf, offset, 7 == bit_select, rgb);
+            else
+               encode_pixel(buf, offset, bit_select, rgb[0], rgb[1], rgb[2]);
+         }
+
+         xx += count;
+         src += count;
+      }
+   }
+}
+
+void PxMatrix::drawRectRGB888(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride)
+{
+   int16_t skip_x, skip_y;
+   if (!clip_rect(&x, &y, &w, &h, &skip_x, &skip_y))
+      return;
+
+   data += ((skip_y * stride) + skip_x) * 3;
+
+   if (_streaming)
+   {
+      uint16_t canvas_width = virtualWidth();
+      for (int16_t yy = 0; yy < h; yy++, data += stride * 3)
+      {
+         if (_indexed)
+         {
+            uint8_t *dst = &_index_frame[_draw_buffer][((y + yy) * canvas_width) + x];
+            for (int16_t xx = 0; xx < w; xx++)
+               dst[xx] = palette_index(data[xx * 3], data[(xx * 3) + 1], data[(xx * 3) + 2]);
+            continue;
+         }
+
+         uint16_t *dst = &_frame[_draw_buffer][((y + yy) * canvas_width) + x];
+         for (int16_t xx = 0; xx < w; xx++)
+            dst[xx] = color565(data[xx * 3], data[(xx * 3) + 1], data[(xx * 3) + 2]);
+      }
+      return;
+   }
+
+   shadow_rect888(x, y, w, h, data, stride);
+   uint8_t *buf = buffer[_draw_buffer];
+
+   for (int16_t yy = 0; yy < h; yy++, data += stride * 3)
+   {
+      const uint8_t *src = data;
+      int16_t xx = 0;
+      while (xx < w)
+      {
+         uint32_t offset;
+         uint8_t bit_select;
+         uint8_t rgb[8 * 3];
+         const uint8_t *pixels = src;
+         uint8_t count = 1;
+
+         // Whole bytes of 8 pixels are encoded at once
+         if (_byte_runs && !((x + xx) % 8) && (xx + 8 <= w))
+            count = 8;
+
+         // The source is const, dither a copy
+         if (_dither)
+         {
+            memcpy(rgb, src, count * 3);
+            dither_pixels(rgb, x + xx, y + yy, count);
+            pixels = rgb;
+         }
+
+         if (map_pixel(x + xx, y + yy, &offset, &bit_select))
+         {
+            if (8 == count)
+               encode_group(buf, offset, 7 == bit_select, pixels);
+            else
+               encode_pixel(buf, offset, bit_select, pixels[0], pixels[1], pixels[2]);
+         }
+
+         xx += count;
+         src += count * 3;
+      }
+   }
+}
+
+void PxMatrix::drawFrameRGB565(const uint16_t *data, uint16_t stride)
+{
+   drawRectRGB565(0, 0, virtualWidth(), virtualHeight(), data, stride);
+}
+
+void PxMatrix::drawFrameRGB888(const uint8_t *data, uint16_t stride)
+{
+   drawRectRGB888(0, 0, virtualWidth(), virtualHeight(), data, stride);
+}
+
+void PxMatrix::fill_pattern(uint8_t r, uint8_t g, uint8_t b, uint8_t pattern[3][PXMATRIX_COLOR_DEPTH])
+{
+   const uint8_t values[3] = {r, g, b};
+
+   memset(pattern, 0, 3 * PXMATRIX_COLOR_DEPTH);
+   for (uint8_t channel = 0; channel < 3; channel++)
+   {
+      uint8_t lit = _plane_lut[channel][values[channel]];
+      for (uint8_t slot = 0; slot < _color_depth; slot++)
+      {
+         if (lit & _BV(slot))
+            pattern[channel][(slot + _plane_rotate[channel]) % _color_depth] = 0xFF;
+      }
+   }
+}
+
+inline void PxMatrix::fill_byte(uint8_t *buf, uint32_t offset, uint8_t mask, const uint8_t pattern[3][PXMATRIX_COLOR_DEPTH])
+{
+   for (uint8_t channel = 0; channel < 3; channel++)
+   {
+      uint8_t *dst = &buf[offset - (channel * _pattern_color_bytes)];
+      for (uint8_t plane = 0; plane < _color_depth; plane++, dst += _buffer_size)
+         *dst = (*dst & ~mask) | (pattern[channel][plane] & mask);
+   }
+}
+
+void PxMatrix::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t r, uint8_t g, uint8_t b)
+{
+   int16_t skip_x, skip_y;
+   if (!clip_rect(&x, &y, &w, &h, &skip_x, &skip_y))
+      return;
+
+   uint16_t canvas_width = virtualWidth();
+   if (_streaming)
+   {
+      uint8_t index = _indexed ? palette_index(r, g, b) : 0;
+      uint16_t color = color565(r, g, b);
+
+      for (int16_t yy = y; yy < y + h; yy++)
+      {
+         if (_indexed)
+         {
+            if (NULL != _index_frame[_draw_buffer])
+               memset(&_index_frame[_draw_buffer][(yy * canvas_width) + x], index, w);
+            continue;
+         }
+
+         for (int16_t xx = x; (NULL != _frame[_draw_buffer]) && (xx < x + w); xx++)
+            _frame[_draw_buffer][(yy * canvas_width) + xx] = color;
+      }
+      return;
+   }
+
+   uint8_t *buf = buffer[_draw_buffer];
+   if (NULL == buf)
+      return;
+
+   // The dither differs from pixel to pixel
+   if (_dither)
+   {
+      for (int16_t yy = y; yy < y + h; yy++)
+      {
+         for (int16_t xx = x; xx < x + w; xx++)
+            fillMatrixBuffer(xx, yy, r, g, b, _draw_buffer);
+      }
+      return;
+   }
+
+   uint16_t *shadow = _shadow_frame[_draw_buffer];
+   for (int16_t yy = y; (NULL != shadow) && (yy < y + h); yy++)
+   {
+      for (int16_t xx = x; xx < x + w; xx++)
+         shadow[(yy * canvas_width) + xx] = color565(r, g, b);
+   }
+
+   uint8_t pattern[3][PXMATRIX_COLOR_DEPTH];
+   fill_pattern(r, g, b, pattern);
+
+   // Every bit of every row belongs to a pixel, so the whole canvas is each
+   // channel's pattern repeated
+   if ((0 == x) && (0 == y) && (width() == w) && (height() == h))
+   {
+      for (uint8_t plane = 0; plane < _color_depth; plane++)
+      {
+         uint8_t *row = &buf[plane * _buffer_size];
+         for (uint8_t line = 0; line < _row_pattern; line++, row += _send_buffer_size)
+         {
+            // Red is sent last, blue first
+            memset(row, pattern[2][plane], _pattern_color_bytes);
+            memset(row + _pattern_color_bytes, pattern[1][plane], _pattern_color_bytes);
+            memset(row + (2 * _pattern_color_bytes), pattern[0][plane], _pattern_color_bytes);
+         }
+      }
+      return;
+   }
+
+   for (int16_t yy = y; yy < y + h; yy++)
+   {
+      int16_t xx = x;
+      while (xx < x + w)
+      {
+         uint32_t offset;
+         uint8_t bit_select;
+         if (!map_pixel(xx, yy, &offset, &bit_select))
+         {
+            xx++;
+            continue;
+         }
+
+         // Whole bytes of 8 pixels are written at once
+         if (_byte_runs && !(xx % 8) && (xx + 8 <= x + w))
+         {
+            fill_byte(buf, offset, 0xFF, pattern);
+            xx += 8;
+         }
+         else
+         {
+            fill_byte(buf, offset, _BV(bit_select), pattern);
+            xx++;
+         }
+      }
+   }
+}
+
+void PxMatrix::fillScreen(uint8_t r, uint8_t g, uint8_t b)
+{
+   fillRect(0, 0, virtualWidth(), virtualHeight(), r, g, b);
+}
+
+void PxMatrix::shadow_rect565(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride)
+{
+   uint16_t *shadow = _shadow_frame[_draw_buffer];
+   if (NULL == shadow)
+      return;
+
+   for (int16_t yy = 0; yy < h; yy++, data += stride)
+      memcpy(&shadow[((y + yy) * width()) + x], data, w * sizeof(uint16_t));
+}
+
+void PxMatrix::shadow_rect888(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride)
+{
+   uint16_t *shadow = _shadow_frame[_draw_buffer];
+   if (NULL == shadow)
+      return;
+
+   for (int16_t yy = 0; yy < h; yy++, data += stride * 3)
+   {
+      uint16_t *dst = &shadow[((y + yy) * width()) + x];
+      for (int16_t xx = 0; xx < w; xx++)
+         dst[xx] = color565(data[xx * 3], data[(xx * 3) + 1], data[(xx * 3) + 2]);
+   }
+}
+
+void PxMatrix::shadow_pixel(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t buffer_idx)
+{
+   if (NULL != _shadow_frame[buffer_idx])
+      _shadow_frame[buffer_idx][(y * width()) + x] = color565(r, g, b);
+}
+
+void PxMatrix::encode_draw_buffer()
+{
+   uint8_t idx = _draw_buffer;
+   if (NULL == buffer[idx])
+      return;
+
+   // Without a shadow it takes the new tables as it is redrawn
+   if (NULL == _shadow_frame[idx])
+   {
+      _buffer_depth[idx] = _color_depth;
+      _buffer_serial[idx] = _plane_serial;
+      return;
+   }
+
+   // Double buffering shows the draw buffer from the end of the colour cycle,
+   // the other one isn't shown until the next swap
+   if (!_triple_buffer && (idx == _active_buffer))
+   {
+      idx ^= 1;
+      memcpy(_shadow_frame[idx], _shadow_frame[_draw_buffer], width() * height() * sizeof(uint16_t));
+      _buffer_frame[idx] = _buffer_frame[_draw_buffer];
+   }
+
+   encode_rect565(buffer[idx], 0, 0, width(), height(), _shadow_frame[idx], width());
+   _buffer_depth[idx] = _color_depth;
+   _buffer_serial[idx] = _plane_serial;
+   _draw_buffer = idx;
+}
+
+uint16_t PxMatrix::getPixel(int16_t x, int16_t y)
+{
+   if ((x < 0) || (x >= virtualWidth()) || (y < 0) || (y >= virtualHeight()))
+      return 0;
+
+   uint32_t pixel = (y * virtualWidth()) + x;
+   if (_indexed && (NULL != _index_frame[_draw_buffer]))
+   {
+      uint32_t color = _palette[_index_frame[_draw_buffer][pixel]];
+      return color565(color >> 16, color >> 8, color);
+   }
+   if (_streaming && (NULL != _frame[_draw_buffer]))
+      return _frame[_draw_buffer][pixel];
+   if (NULL != _shadow_frame[_draw_buffer])
+      return _shadow_frame[_draw_buffer][pixel];
+   return 0;
+}
+
+void PxMatrix::drawPixelIndexed(int16_t x, int16_t y, uint8_t index)
+{
+   if (!_indexed)
+   {
+      uint32_t color = _palette[index];
+      fillMatrixBuffer(x, y, color >> 16, color >> 8, color, _draw_buffer);
+      return;
+   }
+
+   if ((x < 0) || (x >= virtualWidth()) || (y < 0) || (y >= virtualHeight()))
+      return;
+
+   _index_frame[_draw_buffer][(y * virtualWidth()) + x] = index;
+}
+
+void PxMatrix::drawFrameIndexed(const uint8_t *data, uint16_t stride)
+{
+   drawRectIndexed(0, 0, virtualWidth(), virtualHeight(), data, stride);
+}
+
+void PxMatrix::drawRectIndexed(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride)
+{
+   int16_t skip_x, skip_y;
+   if (!clip_rect(&x, &y, &w, &h, &skip_x, &skip_y))
+      return;
+
+   data += (skip_y * stride) + skip_x;
+   uint16_t canvas_width = virtualWidth();
+
+   for (int16_t yy = 0; yy < h; yy++, data += stride)
+   {
+      if (_indexed)
+      {
+         memcpy(&_index_frame[_draw_buffer][((y + yy) * canvas_width) + x], data, w);
+         continue;
+      }
+
+      for (int16_t xx = 0; xx < w; xx++)
+      {
+         uint32_t color = _palette[data[xx]];
+         fillMatrixBuffer(x + xx, y + yy, color >> 16, color >> 8, color, _draw_buffer);
+      }
+   }
+}
+
+bool PxMatrix::readPixel(int16_t x, int16_t y, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+   if ((NULL == _row_offset) || (x < 0) || (x >= width()) || (y < 0) || (y >= height()))
+      return false;
+
+   uint32_t entry = compute_pixel(x, y);
+   uint32_t offset = entry >> 3;
+   uint8_t bit_select = entry & 0x07;
+   uint8_t row = offset / _send_buffer_size;
+   uint32_t local = offset % _send_buffer_size;
+   uint8_t *encoded = NULL;
+   uint32_t lit[3] = {0, 0, 0};
+   uint32_t total = 0;
+
+   // A streamed frame is only encoded as it is sent, encode a copy of the row
+   if (_streaming)
+   {
+      encoded = (uint8_t *)malloc(_send_buffer_size);
+      if (NULL == encoded)
+         return false;
+   }
+
+   for (uint8_t plane = 0; plane < _display_depth; plane++)
+   {
+      const uint8_t *src;
+      if (_streaming)
+      {
+         encode_stream_row(plane, row, encoded);
+         src = encoded;
+      }
+      else
+      {
+         src = &(buffer[_active_buffer][(plane * _buffer_size) + (row * _send_buffer_size)]);
+      }
+
+      // Binary code modulation lights plane n for 2^n times as long
+      uint32_t weight = (BCM == _color_mode) ? _BV(plane) : 1;
+      for (uint8_t channel = 0; channel < 3; channel++)
+      {
+         if (src[local - (channel * _pattern_color_bytes)] & _BV(bit_select))
+            lit[channel] += weight;
+      }
+      total += weight;
+   }
+   free(encoded);
+
+   *r = (lit[0] * 255) / total;
+   *g = (lit[1] * 255) / total;
+   *b = (lit[2] * 255) / total;
+   return true;
+}
+
+void PxMatrix::drawPixelRGB565(int16_t x, int16_t y, uint16_t color, bool selected_buffer) {
+  uint8_t r = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
+  uint8_t g = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
+  uint8_t b = (((color & 0x1F) * 527) + 23) >> 6;
+  fillMatrixBuffer( x,  y, r, g, b, selected_buffer ? 1 : 0);
+}
+
+void PxMatrix::drawPixelRGB565(int16_t x, int16_t y, uint16_t color) {
+  uint8_t r = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
+  uint8_t g = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
+  uint8_t b = (((color & 0x1F) * 527) + 23) >> 6;
+  fillMatrixBuffer( x,  y, r, g, b, _draw_buffer);
+}
+
+void PxMatrix::drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, bool selected_buffer) {
+  fillMatrixBuffer(x, y, r, g, b, selected_buffer ? 1 : 0);
+}
+
+void PxMatrix::drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b) {
+  fillMatrixBuffer(x, y, r, g, b, _draw_buffer);
+}
+
+bool PxMatrix::begin()
+{
+  return begin(8);
+}
+
+bool PxMatrix::begin(uint8_t row_pattern)
+{
+   return begin(row_pattern, THRESHOLD);
+}
+
+void *PxMatrix::alloc_buffer(size_t count, size_t size, uint32_t caps)
+{
+   void *mem = heap_caps_calloc(count, size, caps);
+   if (NULL == mem)
+   {
+      printf("Failed to allocate %u bytes\n", (unsigned)(count * size));
+      return NULL;
+   }
+
+   if (caps & MALLOC_CAP_SPIRAM)
+      _memory.psram += count * size;
+   else if (caps & MALLOC_CAP_DMA)
+      _memory.dma += count * size;
+   else
+      _memory.other += count * size;
+   return mem;
+}
+
+void *PxMatrix::alloc_frame(size_t count, size_t size, uint32_t caps)
+{
+   // Fall back to internal memory when PSRAM is missing or full
+   if ((0 != _psram_threshold) && ((count * size) >= _psram_threshold) &&
+       (heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) >= (count * size)))
+      return alloc_buffer(count, size, MALLOC_CAP_SPIRAM);
+
+   return alloc_buffer(count, size, caps);
+}
+
+// Whether a quad SPI lane lands on a pin the panel or its supply uses
+bool PxMatrix::quad_spi_collides()
+{
+   const uint8_t lanes[PXMATRIX_QSPI_LANES] = {SPI_BUS_MOSI, SPI_BUS_MISO, _WP_PIN, _HD_PIN};
+   uint8_t pins[8] = {_LATCH_PIN, _OE_PIN, _A_PIN, _B_PIN, _POWER_PIN, PXMATRIX_NO_PIN, PXMATRIX_NO_PIN, PXMATRIX_NO_PIN};
+
+   if (_row_pattern >= 8)
+      pins[5] = _C_PIN;
+   if (_row_pattern >= 16)
+      pins[6] = _D_PIN;
+   if (_row_pattern >= 32)
+      pins[7] = _E_PIN;
+
+   for (uint8_t lane = 0; lane < PXMATRIX_QSPI_LANES; lane++)
+   {
+      for (uint8_t pin = 0; pin < sizeof(pins); pin++)
+      {
+         if (lanes[lane] == pins[pin])
+         {
+            printf("Quad SPI lane %d shares GPIO%d with the panel, using one\n", lane, lanes[lane]);
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+bool PxMatrix::begin_spi()
+{
+   esp_err_t ret;
+
+   spi_bus_config_t cfg;
+   memset(&cfg, 0, sizeof(spi_bus_config_t));
+   cfg.miso_io_num = SPI_BUS_MISO;
+   cfg.mosi_io_num = SPI_BUS_MOSI;
+   cfg.sclk_io_num = SPI_BUS_CLK;
+   cfg.quadwp_io_num = -1;
+   cfg.quadhd_io_num = -1;
+   cfg.max_transfer_sz = _send_buffer_size;
+
+   // Each lane carries a quarter of the row, so the row has to split evenly
+   if (_quad_spi && (_send_buffer_size % PXMATRIX_QSPI_LANES))
+   {
+      printf("Row of %d bytes can't be split over %d lanes, using one\n", _send_buffer_size, PXMATRIX_QSPI_LANES);
+      _quad_spi = false;
+   }
+
+   // Driving a lane would fight the latch, OE, address or power pin
+   if (_quad_spi && quad_spi_collides())
+      _quad_spi = false;
+
+   if (_quad_spi)
+   {
+      cfg.quadwp_io_num = _WP_PIN;
+      cfg.quadhd_io_num = _HD_PIN;
+      _qspi_rows = (uint8_t *)alloc_buffer(_send_buffer_size, 2, MALLOC_CAP_DMA);
+      if (NULL == _qspi_rows)
+         return false;
+   }
+
+//#define buffer_size max_matrix_width * max_matrix_height * 3 / 8
+
+   spi_device_interface_config_t dev; 
+   memset(&dev, 0, sizeof(spi_device_interface_config_t));
+   dev.mode = 0;
+   dev.clock_speed_hz = SPI_CLOCK_SPEED;
    dev.spics_io_num = SPI_BUS_SS;
    dev.flags = SPI_TRANS_USE_RXDATA;
    dev.queue_size=2;
+   if (SPI_PIPELINED == _output_mode)
+      dev.post_cb = &PxMatrix::spi_post_cb;
+
+   // Quad transfers are half duplex only, and the chip select pin may be a lane
+   if (_quad_spi)
+   {
+      dev.flags |= SPI_DEVICE_HALFDUPLEX;
+      dev.spics_io_num = -1;
+   }
    
    // Set Up The SPI on ESP32
    ret = spi_bus_initialize(SPI_HOST_TYPE, &cfg, 2);
@@ -306,6 +2114,48 @@ void PxMatrix::begin(uint8_t row_pattern)
    // set_data_mode = SPI_MODE0
    // set_bit_order = MSBFIRST
    // set_frequency = 20000000
+   return true;
+}
+
+bool PxMatrix::begin(uint8_t row_pattern, color_modes color_mode)
+{
+   _color_mode = color_mode;
+   _row_pattern = row_pattern;
+   build_plane_lut();
+   _display_depth = _color_depth;
+   for (uint8_t idx = 0; idx < PXMATRIX_BUFFERS; idx++)
+   {
+      _buffer_depth[idx] = _color_depth;
+      _buffer_serial[idx] = _plane_serial;
+   }
+   if ((4 == _row_pattern) && (CUSTOM != _scan_pattern))
+      _scan_pattern = ZIGZAG;
+
+   _buffer_size = ((_width * _height * 3) / 8);
+   _pattern_color_bytes = (_height / _row_pattern) * (_width / 8);
+   _send_buffer_size = _pattern_color_bytes * 3;
+
+   // The DMA driven modes send straight from the encoded buffers
+   if (_streaming && (SPI_BLOCKING != _output_mode) && (SPI_PIPELINED != _output_mode))
+   {
+      printf("Streaming only works with SPI_BLOCKING and SPI_PIPELINED\n");
+      _streaming = false;
+      _indexed = false;
+      _virtual_width = 0;
+      _virtual_height = 0;
+   }
+
+   // A virtual canvas is at least the panel
+   if (_virtual_width || _virtual_height)
+   {
+      if (_virtual_width < width())
+         _virtual_width = width();
+      if (_virtual_height < height())
+         _virtual_height = height();
+   }
+
+   if ((SPI_DMA_CHAIN != _output_mode) && (I2S_PARALLEL != _output_mode) && !begin_spi())
+      return false;
 
    gpio_pad_select_gpio(_OE_PIN);
    gpio_pad_select_gpio(_LATCH_PIN);
@@ -343,132 +2193,919 @@ void PxMatrix::begin(uint8_t row_pattern)
    }
 
    // Precompute row offset values
-   for (uint8_t yy=0; yy<_height;yy++) {
+   _row_offset = (uint32_t *)alloc_buffer(_height, sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   if (NULL == _row_offset)
+      return false;
+   for (uint16_t yy=0; yy<_height;yy++) {
       _row_offset[yy]=((yy)%_row_pattern)*_send_buffer_size+_send_buffer_size-1;
    }
 
-   // Allocate The Stuff
-   buffer[0] = (uint8_t *)heap_caps_calloc(_buffer_size, color_depth, MALLOC_CAP_DMA);
-   buffer[1] = (uint8_t *)heap_caps_calloc(_buffer_size, color_depth, MALLOC_CAP_DMA);
-   flushBuffer = (uint8_t *)heap_caps_calloc(_send_buffer_size, 1, MALLOC_CAP_DMA);
-
-   // Create The Event Group
-   xDisplayEventGroup = xEventGroupCreate();
+   if (_streaming)
+   {
+      // Two rows in DMA memory, one being sent while the next is encoded
+      _stream_rows = (uint8_t *)alloc_buffer(_send_buffer_size, 2, MALLOC_CAP_DMA);
+      if (NULL == _stream_rows)
+         return false;
+      for (uint8_t idx = 0; idx < (_triple_buffer ? 3 : 2); idx++)
+      {
+         if (_indexed)
+            _index_frame[idx] = (uint8_t *)alloc_frame(virtualWidth() * virtualHeight(), 1, MALLOC_CAP_8BIT);
+         else
+            _frame[idx] = (uint16_t *)alloc_frame(virtualWidth() * virtualHeight(), sizeof(uint16_t), MALLOC_CAP_8BIT);
+         if ((NULL == _index_frame[idx]) && (NULL == _frame[idx]))
+            return false;
+      }
+
+      _stream_map = (uint32_t *)alloc_buffer(_width * _height, sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+      if ((NULL == _stream_map) || !build_pixel_map())
+         return false;
+   }
+   else
+   {
+      // Precompute where every pixel lands in a colour plane
+      _pixel_map = (uint32_t *)alloc_buffer(_width * _height, sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+      if ((NULL == _pixel_map) || !build_pixel_map())
+         return false;
+
+      // Allocate The Stuff
+      // Room for every plane, so the colour depth can change without reallocating.
+      // SPI_DMA_CHAIN sends straight from the buffers, so they stay internal
+      for (uint8_t idx = 0; idx < (_triple_buffer ? 3 : 2); idx++)
+      {
+         if (SPI_DMA_CHAIN == _output_mode)
+            buffer[idx] = (uint8_t *)alloc_buffer(_buffer_size, PXMATRIX_COLOR_DEPTH, MALLOC_CAP_DMA);
+         else
+            buffer[idx] = (uint8_t *)alloc_frame(_buffer_size, PXMATRIX_COLOR_DEPTH, MALLOC_CAP_DMA);
+         if (NULL == buffer[idx])
+            return false;
+
+         if (esp_ptr_external_ram(buffer[idx]))
+            _bounce = true;
+
+         // Dithering moves on by encoding the buffer again from the shadow
+         if (_shadow || _dither)
+         {
+            _shadow_frame[idx] = (uint16_t *)alloc_frame(width() * height(), sizeof(uint16_t), MALLOC_CAP_8BIT);
+            if (NULL == _shadow_frame[idx])
+               return false;
+         }
+      }
+
+      // I2S_PARALLEL packs rows with the CPU, the SPI modes copy them to
+      // internal memory first
+      if (_bounce && (I2S_PARALLEL != _output_mode))
+      {
+         _stream_rows = (uint8_t *)alloc_buffer(_send_buffer_size, 2, MALLOC_CAP_DMA);
+         if (NULL == _stream_rows)
+            return false;
+      }
+   }
+
+   if (_triple_buffer)
+   {
+      // Draw into 0 and show 2, 1 waits in the handoff
+      _draw_buffer = 0;
+      _frame_handoff = 1;
+      _active_buffer = 2;
+   }
+   flushBuffer = (uint8_t *)alloc_buffer(_send_buffer_size, 1, MALLOC_CAP_DMA);
+   if (NULL == flushBuffer)
+      return false;
+
+   // Create The Event Group
+   xDisplayEventGroup = xEventGroupCreate();
+   if (NULL == xDisplayEventGroup)
+      return false;
+
+   if ((SPI_DMA_CHAIN == _output_mode) && !begin_dma_chain())
+      return false;
+
+   if ((I2S_PARALLEL == _output_mode) && !begin_i2s())
+      return false;
+
+   if (_rmt_oe && !begin_rmt())
+      return false;
+
+   if (SPI_PIPELINED == _output_mode)
+      begin_pipe_timer();
+   return true;
+}
+
+void PxMatrix::begin_pipe_timer()
+{
+   // Free running, every row sets its alarm that many ticks on from the count
+   timer_config_t config;
+   memset(&config, 0, sizeof(timer_config_t));
+   config.alarm_en = TIMER_ALARM_DIS;
+   config.counter_en = TIMER_PAUSE;
+   config.intr_type = TIMER_INTR_LEVEL;
+   config.counter_dir = TIMER_COUNT_UP;
+   config.auto_reload = TIMER_AUTORELOAD_DIS;
+   config.divider = PXMATRIX_PIPE_TIMER_DIVIDER;
+
+   ESP_ERROR_CHECK(timer_init(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER, &config));
+   ESP_ERROR_CHECK(timer_set_counter_value(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER, 0));
+   ESP_ERROR_CHECK(timer_enable_intr(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER));
+   ESP_ERROR_CHECK(timer_isr_register(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER, &PxMatrix::pipe_timer_isr, this, ESP_INTR_FLAG_IRAM, NULL));
+   ESP_ERROR_CHECK(timer_start(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER));
+}
+
+bool PxMatrix::begin_rmt()
+{
+   // The other modes light rows from their own callbacks or DMA streams
+   if (SPI_BLOCKING != _output_mode)
+   {
+      printf("RMT timed OE only works with SPI_BLOCKING\n");
+      _rmt_oe = false;
+      return true;
+   }
+
+   rmt_config_t config;
+   memset(&config, 0, sizeof(rmt_config_t));
+   config.rmt_mode = RMT_MODE_TX;
+   config.channel = PXMATRIX_OE_CHANNEL;
+   config.gpio_num = (gpio_num_t)_OE_PIN;
+   config.clk_div = PXMATRIX_OE_CLK_DIV;
+   config.mem_block_num = 1;
+   config.tx_config.idle_level = RMT_IDLE_LEVEL_HIGH;
+   config.tx_config.idle_output_en = true;
+
+   ESP_ERROR_CHECK(rmt_config(&config));
+   ESP_ERROR_CHECK(rmt_driver_install(PXMATRIX_OE_CHANNEL, 0, 0));
+
+   _oe_items = (rmt_item32_t *)alloc_buffer(PXMATRIX_OE_MAX_ITEMS, sizeof(rmt_item32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   return (NULL != _oe_items);
+}
+
+bool PxMatrix::begin_i2s()
+{
+   i2s_dev_t *hw = &I2S_HW;
+   uint8_t pins[PXMATRIX_I2S_BITS] = {
+      _R1_PIN, _G1_PIN, _B1_PIN, _R2_PIN, _G2_PIN, _B2_PIN,
+      _A_PIN, _B_PIN, _C_PIN, _D_PIN, _E_PIN, _LATCH_PIN, _OE_PIN
+   };
+
+   // Address lines that the row pattern does not use are left alone
+   uint8_t address_bits = 2;
+   if (_row_pattern >= 8)
+      address_bits = 3;
+   if (_row_pattern >= 16)
+      address_bits = 4;
+   if (_row_pattern >= 32)
+      address_bits = 5;
+
+   for (uint8_t bit = 0; bit < PXMATRIX_I2S_BITS; bit++)
+   {
+      if (bit >= PXMATRIX_I2S_BIT_A + address_bits && bit < PXMATRIX_I2S_BIT_LAT)
+         continue;
+
+      gpio_pad_select_gpio(pins[bit]);
+      gpio_set_direction((gpio_num_t)pins[bit], GPIO_MODE_OUTPUT);
+      gpio_matrix_out(pins[bit], I2S1O_DATA_OUT8_IDX + bit, false, false);
+   }
+
+   gpio_pad_select_gpio(_CLK_PIN);
+   gpio_set_direction((gpio_num_t)_CLK_PIN, GPIO_MODE_OUTPUT);
+   gpio_matrix_out(_CLK_PIN, I2S1O_WS_OUT_IDX, true, false);
+
+   // Which lane every bit of a row goes out on, worked out with the pixel map
+   _i2s_row_samples = PXMATRIX_I2S_ROW_SAMPLES(_pattern_color_bytes);
+   _i2s_lanes = (uint16_t *)alloc_buffer(_i2s_row_samples * 2, sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   if ((NULL == _i2s_lanes) || !build_pixel_map())
+      return false;
+
+   // Rows lit longer than they take to shift are held from the hold buffer
+   // of their address
+   _i2s_hold = (uint16_t *)alloc_buffer(_row_pattern * PXMATRIX_I2S_HOLD_SAMPLES, sizeof(uint16_t), MALLOC_CAP_DMA);
+   if (NULL == _i2s_hold)
+      return false;
+   for (uint8_t row = 0; row < _row_pattern; row++)
+      pxmatrix_i2s_pack_hold(_i2s_hold + (row * PXMATRIX_I2S_HOLD_SAMPLES), row);
+
+   size_t repeats = 0;
+   for (uint8_t plane = 0; plane < _color_depth; plane++)
+   {
+      _i2s_repeat[plane] = 1;
+      if (BCM == _color_mode && plane >= I2S_BCM_REPEAT_PLANE)
+         _i2s_repeat[plane] = 1 << (plane - I2S_BCM_REPEAT_PLANE);
+      repeats += _i2s_repeat[plane];
+      _i2s_hold_lit[plane] = 0;
+   }
+
+   // Each row is sent as a block with the previous address and a block with
+   // its own. There are two copies of the samples and the chain, display()
+   // packs the one the DMA isn't walking
+   _i2s_chain_size = repeats * _row_pattern *
+      (PXMATRIX_DMA_DESC_COUNT(_i2s_row_samples * sizeof(uint16_t), PXMATRIX_DMA_MAX_DESC_SIZE) + PXMATRIX_I2S_HOLD_DESC);
+   for (uint8_t copy = 0; copy < 2; copy++)
+   {
+      _i2s_samples[copy] = (uint16_t *)alloc_buffer(_color_depth * _row_pattern * 2 * _i2s_row_samples,
+                                                    sizeof(uint16_t), MALLOC_CAP_DMA);
+      _i2s_chain[copy] = (lldesc_t *)alloc_buffer(_i2s_chain_size, sizeof(lldesc_t), MALLOC_CAP_DMA);
+      if ((NULL == _i2s_samples[copy]) || (NULL == _i2s_chain[copy]))
+         return false;
+   }
+
+   // Blank until display() has packed the samples
+   _i2s_shown = 1;
+   for (uint8_t plane = 0; plane < _color_depth; plane++)
+   {
+      for (uint8_t row = 0; row < _row_pattern; row++)
+         pack_i2s_row(plane, row, 0);
+   }
+   _i2s_shown = 0;
+   _i2s_chain_used[0] = pxmatrix_build_i2s_chain(_i2s_chain[0], _i2s_chain_size, _i2s_samples[0], _i2s_row_samples,
+                                                 _row_pattern, _color_depth, _i2s_repeat, _i2s_hold, _i2s_hold_lit);
+
+   // 16 bit LCD mode, following the ESP32 parallel I2S set up
+   periph_module_enable(PERIPH_I2S1_MODULE);
+
+   hw->conf.tx_reset = 1;
+   hw->conf.tx_reset = 0;
+   hw->lc_conf.out_rst = 1;
+   hw->lc_conf.out_rst = 0;
+   hw->conf.tx_fifo_reset = 1;
+   hw->conf.tx_fifo_reset = 0;
+
+   hw->conf2.val = 0;
+   hw->conf2.lcd_en = 1;
+
+   hw->sample_rate_conf.val = 0;
+   hw->sample_rate_conf.tx_bits_mod = 16;
+   hw->sample_rate_conf.tx_bck_div_num = 4;
+
+   hw->clkm_conf.val = 0;
+   hw->clkm_conf.clka_en = 0;
+   hw->clkm_conf.clkm_div_a = 63;
+   hw->clkm_conf.clkm_div_b = 63;
+   hw->clkm_conf.clkm_div_num = APB_CLK_FREQ / I2S_CLOCK_SPEED;
+
+   hw->fifo_conf.val = 0;
+   hw->fifo_conf.tx_fifo_mod_force_en = 1;
+   hw->fifo_conf.tx_fifo_mod = 1;
+   hw->fifo_conf.tx_data_num = 32;
+   hw->fifo_conf.dscr_en = 1;
+
+   hw->conf1.val = 0;
+   hw->conf1.tx_stop_en = 0;
+   hw->conf1.tx_pcm_bypass = 1;
+
+   hw->conf_chan.val = 0;
+   hw->conf_chan.tx_chan_mod = 1;
+
+   hw->conf.tx_right_first = 1;
+   hw->timing.val = 0;
+
+   // The chain is circular, so once started the panel refreshes without the CPU
+   hw->lc_conf.val = I2S_OUT_DATA_BURST_EN | I2S_OUTDSCR_BURST_EN;
+   hw->out_link.addr = (uint32_t)(uintptr_t)_i2s_chain[0] & 0xFFFFF;
+   hw->out_link.start = 1;
+   hw->conf.tx_start = 1;
+   return true;
+}
+
+bool PxMatrix::map_i2s_lanes()
+{
+   uint16_t bits = _pattern_color_bytes * 8;
+   uint8_t *upper = (uint8_t *)calloc(bits, 1);
+   if (NULL == upper)
+      return false;
+
+   // Rows of every scan row sit in the same places, so scan row 0 will do.
+   // Bits are counted from the data input there and in the order they are
+   // sent here
+   for (int16_t y = 0; y < _height; y += _row_pattern)
+   {
+      for (int16_t x = 0; x < _width; x++)
+         upper[bits - 1 - scan_position(x, y)] = (y < (_height / 2));
+   }
+
+   bool split = pxmatrix_i2s_map_lanes(_i2s_lanes, upper, _pattern_color_bytes);
+   free(upper);
+   return split;
+}
+
+uint32_t PxMatrix::i2s_lit(uint8_t plane, uint16_t show_time)
+{
+   uint32_t lit = show_time * I2S_SAMPLES_PER_US;
+
+   if (BCM == _color_mode && plane < I2S_BCM_REPEAT_PLANE)
+      lit = (lit << plane) >> I2S_BCM_REPEAT_PLANE;
+   return lit;
+}
+
+// Splits the time a block lights the row latched before between the shift
+// and the hold before it
+static void split_i2s_lit(uint32_t lit, uint16_t row_samples, uint16_t *shift_lit, uint16_t *hold_lit)
+{
+   uint32_t shift_max = PXMATRIX_I2S_SHIFT_LIT(row_samples);
+   uint32_t held = 0;
+
+   *hold_lit = 0;
+   if (lit > shift_max)
+   {
+      *hold_lit = ((lit - shift_max) > PXMATRIX_I2S_HOLD_LIT) ? PXMATRIX_I2S_HOLD_LIT : (lit - shift_max);
+      held = pxmatrix_i2s_hold_lit(*hold_lit);
+   }
+
+   // Holds light an odd number of samples, the shift makes up the difference
+   if (lit > shift_max + held)
+      lit = shift_max + held;
+   *shift_lit = lit - held;
+}
+
+void PxMatrix::pack_i2s_row(uint8_t plane, uint8_t row, uint16_t show_time)
+{
+   uint8_t buffer_idx = _active_buffer;
+   uint16_t shift_lit;
+   uint16_t first_lit;
+   uint16_t hold_lit;
+
+   // The first block of a plane lights the last row of the plane before
+   uint8_t shown = (0 == row) ? (plane + _color_depth - 1) % _color_depth : plane;
+   split_i2s_lit(i2s_lit(shown, show_time), _i2s_row_samples, &first_lit, &hold_lit);
+   split_i2s_lit(i2s_lit(plane, show_time), _i2s_row_samples, &shift_lit, &hold_lit);
+   _i2s_hold_lit[plane] = hold_lit;
+
+   const uint8_t *src = &(buffer[buffer_idx][(plane * _buffer_size) + (row * _send_buffer_size)]);
+   uint16_t *dst = _i2s_samples[_i2s_shown ^ 1] + ((plane * _row_pattern) + row) * 2 * _i2s_row_samples;
+   uint8_t previous = (row + _row_pattern - 1) % _row_pattern;
+
+   pxmatrix_i2s_pack_row(dst, src, _pattern_color_bytes, _i2s_lanes, previous, first_lit);
+   pxmatrix_i2s_pack_row(dst + _i2s_row_samples, src, _pattern_color_bytes, _i2s_lanes, row, shift_lit);
+}
+
+void PxMatrix::swap_i2s_chain()
+{
+   uint8_t idle = _i2s_shown ^ 1;
+
+   _i2s_chain_used[idle] = pxmatrix_build_i2s_chain(_i2s_chain[idle], _i2s_chain_size, _i2s_samples[idle], _i2s_row_samples,
+                                                    _row_pattern, _color_depth, _i2s_repeat, _i2s_hold, _i2s_hold_lit);
+
+   // The DMA carries on into the new copy at the end of the frame it is on,
+   // and stays there as the new chain loops on itself
+   _i2s_chain[_i2s_shown][_i2s_chain_used[_i2s_shown] - 1].qe.stqe_next = &_i2s_chain[idle][0];
+   _i2s_shown = idle;
+   _i2s_swapping = true;
+}
+
+void PxMatrix::wait_i2s_swap()
+{
+   const lldesc_t *first = _i2s_chain[_i2s_shown];
+   const lldesc_t *end = first + _i2s_chain_used[_i2s_shown];
+
+   // Every block ends with eof set, one in the new chain means the DMA has
+   // left the old one
+   while (_i2s_swapping)
+   {
+      const lldesc_t *done = (const lldesc_t *)(uintptr_t)I2S_HW.out_eof_des_addr;
+      if ((done >= first) && (done < end))
+         _i2s_swapping = false;
+      else
+         ets_delay_us(1);
+   }
+}
+
+// One register write per pin. gpio_set_level lives in flash, so it can't be
+// called from the interrupts that latch rows
+static inline void IRAM_ATTR write_pin(uint8_t pin, uint32_t level)
+{
+   if (pin < 32)
+   {
+      if (level)
+         GPIO.out_w1ts = 1UL << pin;
+      else
+         GPIO.out_w1tc = 1UL << pin;
+   }
+   else
+   {
+      if (level)
+         GPIO.out1_w1ts.val = 1UL << (pin - 32);
+      else
+         GPIO.out1_w1tc.val = 1UL << (pin - 32);
+   }
+}
+
+bool PxMatrix::begin_dma_chain()
+{
+   spi_dev_t *hw = &SPI_HW;
+
+   // The chain backend drives the SPI peripheral directly rather than through
+   // the spi_master driver, so that each row can be started from the ISR
+   periph_module_enable(SPI_PERIPH_MODULE);
+   periph_module_enable(PERIPH_SPI_DMA_MODULE);
+   DPORT_SET_PERI_REG_BITS(DPORT_SPI_DMA_CHAN_SEL_REG, 3, SPI_DMA_CHANNEL, (SPI_HOST_TYPE * 2));
+
+   gpio_pad_select_gpio(SPI_BUS_MOSI);
+   gpio_set_direction((gpio_num_t)SPI_BUS_MOSI, GPIO_MODE_OUTPUT);
+   gpio_matrix_out(SPI_BUS_MOSI, SPI_MOSI_OUT_IDX, false, false);
+
+   gpio_pad_select_gpio(SPI_BUS_CLK);
+   gpio_set_direction((gpio_num_t)SPI_BUS_CLK, GPIO_MODE_OUTPUT);
+   gpio_matrix_out(SPI_BUS_CLK, SPI_CLK_OUT_IDX, false, false);
+
+   // Master, mode 0, MSB first, write only, no chip select
+   hw->slave.val = 0;
+   hw->pin.val = 0;
+   hw->pin.cs0_dis = 1;
+   hw->pin.cs1_dis = 1;
+   hw->pin.cs2_dis = 1;
+   hw->user.val = 0;
+   hw->user.usr_mosi = 1;
+   hw->user1.val = 0;
+   hw->user2.val = 0;
+   hw->ctrl.val = 0;
+   hw->ctrl2.val = 0;
+
+   // 80MHz APB divided by 4
+   hw->clock.val = 0;
+   hw->clock.clkcnt_n = (APB_CLK_FREQ / SPI_CLOCK_SPEED) - 1;
+   hw->clock.clkcnt_h = ((APB_CLK_FREQ / SPI_CLOCK_SPEED) / 2) - 1;
+   hw->clock.clkcnt_l = (APB_CLK_FREQ / SPI_CLOCK_SPEED) - 1;
+
+   hw->dma_conf.val = 0;
+   hw->dma_conf.out_data_burst_en = 1;
+   hw->dma_conf.outdscr_burst_en = 1;
+   hw->dma_int_ena.val = 0;
+   hw->slave.trans_inten = 1;
+
+   // Room for every row of every plane split in two or followed by up to
+   // DMA_HOLD_MAX_SIZE of padding, and the dark shift and hold of a frame
+   _dma_chain_size = ((_color_depth * _row_pattern) + 1) *
+      (PXMATRIX_DMA_DESC_COUNT(_send_buffer_size, PXMATRIX_DMA_MAX_DESC_SIZE) + 1 +
+       PXMATRIX_DMA_DESC_COUNT(DMA_HOLD_MAX_SIZE, DMA_PADDING_SIZE));
+   _dma_chain[0] = (lldesc_t *)alloc_buffer(_dma_chain_size, sizeof(lldesc_t), MALLOC_CAP_DMA);
+   _dma_chain[1] = (lldesc_t *)alloc_buffer(_dma_chain_size, sizeof(lldesc_t), MALLOC_CAP_DMA);
+   if (_triple_buffer)
+      _dma_chain[2] = (lldesc_t *)alloc_buffer(_dma_chain_size, sizeof(lldesc_t), MALLOC_CAP_DMA);
+   _dma_padding = (uint8_t *)alloc_buffer(DMA_PADDING_SIZE, 1, MALLOC_CAP_DMA);
+
+   // Every chain has the same shape, one set of actions does for all
+   _dma_actions = (uint8_t *)alloc_buffer(PXMATRIX_DMA_SEGMENTS(_row_pattern, _color_depth), 1,
+                                          MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   if ((NULL == _dma_chain[0]) || (NULL == _dma_chain[1]) || (_triple_buffer && (NULL == _dma_chain[2])) ||
+       (NULL == _dma_padding) || (NULL == _dma_actions))
+      return false;
+
+   update_dma_chain();
+
+   // In IRAM so rows keep being latched while the flash is busy
+   ESP_ERROR_CHECK(esp_intr_alloc(SPI_INTR_SOURCE, ESP_INTR_FLAG_IRAM, &PxMatrix::dma_isr, this, &_dma_intr));
+   return true;
+}
+
+void PxMatrix::update_dma_chain()
+{
+   // Rows are lit while this many bytes go out after they are latched
+   for (uint8_t plane = 0; plane < _color_depth; plane++)
+   {
+      uint32_t plane_time = _show_time;
+      if (BCM == _color_mode)
+         plane_time = ((uint32_t)_show_time * _color_depth << plane) / ((1 << _color_depth) - 1);
+
+      uint32_t hold = plane_time * (SPI_CLOCK_SPEED / 1000000) / 8;
+      _dma_hold_size[plane] = (hold > DMA_HOLD_MAX_SIZE) ? DMA_HOLD_MAX_SIZE : hold;
+   }
+
+   for (uint8_t idx = 0; (idx < PXMATRIX_BUFFERS) && (NULL != buffer[idx]); idx++)
+   {
+      pxmatrix_build_dma_chain(_dma_chain[idx], _dma_chain_size,
+                               _dma_actions, PXMATRIX_DMA_SEGMENTS(_row_pattern, _color_depth),
+                               buffer[idx], _buffer_size,
+                               _send_buffer_size, _row_pattern, _color_depth,
+                               _dma_padding, DMA_PADDING_SIZE, _dma_hold_size);
+   }
+   _dma_show_time = _show_time;
+}
+
+void PxMatrix::stop_dma_chain()
+{
+   _dma_stop = true;
+   while (_dma_running)
+      vTaskDelay(1);
+   _dma_stop = false;
+}
+
+void IRAM_ATTR PxMatrix::dma_start_transfer()
+{
+   spi_dev_t *hw = &SPI_HW;
+   lldesc_t *desc = _dma_desc;
+   uint32_t bits = 0;
+
+   // A transfer runs to the end of the current segment
+   while (true)
+   {
+      bits += desc->length << 3;
+      if (desc->eof)
+         break;
+      desc = desc->qe.stqe_next;
+   }
+   _dma_next = desc->qe.stqe_next;
+
+   hw->dma_conf.val |= SPI_OUT_RST | SPI_AHBM_RST | SPI_AHBM_FIFO_RST;
+   hw->dma_conf.val &= ~(SPI_OUT_RST | SPI_AHBM_RST | SPI_AHBM_FIFO_RST);
+   hw->dma_out_link.addr = (uint32_t)(uintptr_t)_dma_desc & 0xFFFFF;
+   hw->dma_out_link.start = 1;
+   hw->mosi_dlen.usr_mosi_dbitlen = bits - 1;
+   hw->cmd.usr = 1;
+}
+
+void IRAM_ATTR PxMatrix::dma_isr(void *arg)
+{
+   PxMatrix *matrix = (PxMatrix *)arg;
+   spi_dev_t *hw = &SPI_HW;
+
+   if (!hw->slave.trans_done)
+      return;
+   hw->slave.trans_done = 0;
+
+   // The segment that just went out was shifting the next row, or holding
+   // the lit one
+   uint8_t action = matrix->_dma_actions[matrix->_dma_step++];
+   write_pin(matrix->_OE_PIN, 1);
+   if (action & PXMATRIX_DMA_LATCH)
+   {
+      matrix->set_mux(matrix->_dma_row);
+      write_pin(matrix->_LATCH_PIN, 1);
+      write_pin(matrix->_LATCH_PIN, 0);
+      if (action & PXMATRIX_DMA_LIGHT)
+         write_pin(matrix->_OE_PIN, 0);
+
+      matrix->_dma_row++;
+      if (matrix->_dma_row >= matrix->_row_pattern)
+      {
+         matrix->_dma_row = 0;
+         matrix->_display_color++;
+      }
+   }
+
+   matrix->_dma_desc = matrix->_dma_next;
+
+   if (action & PXMATRIX_DMA_FRAME)
+   {
+      BaseType_t woken = pdFALSE;
+
+      // Frame boundary, pick up buffer swaps. The chains are rebuilt from
+      // display() once this has stopped
+      matrix->_dma_step = 0;
+      matrix->_display_color = 0;
+      matrix->next_frame();
+      matrix->_dma_desc = matrix->_dma_chain[matrix->_active_buffer];
+
+      if (!matrix->_triple_buffer)
+      {
+         xEventGroupSetBitsFromISR(matrix->xDisplayEventGroup, BIT_BUFFER_SWAP_OK, &woken);
+         if (woken)
+            portYIELD_FROM_ISR();
+      }
+
+      if (matrix->_dma_stop)
+      {
+         matrix->_dma_running = false;
+         return;
+      }
+   }
+
+   matrix->dma_start_transfer();
 }
 
-void PxMatrix::set_mux(uint8_t value)
+void IRAM_ATTR PxMatrix::set_mux(uint8_t value)
 {
    if (BINARY == _mux_pattern)
    {
-      if (value & 0x01)
-         gpio_set_level((gpio_num_t)_A_PIN, 1);
-      else
-         gpio_set_level((gpio_num_t)_A_PIN, 0);
-
-      if (value & 0x02)
-         gpio_set_level((gpio_num_t)_B_PIN, 1);
-      else
-         gpio_set_level((gpio_num_t)_B_PIN, 0);
+      write_pin(_A_PIN, value & 0x01);
+      write_pin(_B_PIN, value & 0x02);
 
       if (_row_pattern >= 8)
-      {
-         if (value & 0x04)
-            gpio_set_level((gpio_num_t)_C_PIN, 1);
-         else
-            gpio_set_level((gpio_num_t)_C_PIN, 0);
-      }
+         write_pin(_C_PIN, value & 0x04);
 
       if (_row_pattern >= 16)
-      {
-         if (value & 0x08)
-            gpio_set_level((gpio_num_t)_D_PIN, 1);
-         else
-            gpio_set_level((gpio_num_t)_D_PIN, 0);
-      }
+         write_pin(_D_PIN, value & 0x08);
 
       if (_row_pattern >= 32)
-      {
-         if (value & 0x10)
-            gpio_set_level((gpio_num_t)_E_PIN, 1);
-         else
-            gpio_set_level((gpio_num_t)_E_PIN, 0);
-      }
+         write_pin(_E_PIN, value & 0x10);
    }
 
    if (STRAIGHT == _mux_pattern)
    {
-      if (value == 0)
-         gpio_set_level((gpio_num_t)_A_PIN, 0);
-      else
-         gpio_set_level((gpio_num_t)_A_PIN, 1);
+      write_pin(_A_PIN, value != 0);
+      write_pin(_B_PIN, value != 1);
+      write_pin(_C_PIN, value != 2);
+      write_pin(_D_PIN, value != 3);
+   }
+}
 
-      if (value == 1)
-         gpio_set_level((gpio_num_t)_B_PIN, 0);
-      else
-         gpio_set_level((gpio_num_t)_B_PIN, 1);
+void PxMatrix::latch(uint32_t show_time_ns)
+{
+   uint32_t start = xthal_get_ccount();
 
-      if (value == 2)
-         gpio_set_level((gpio_num_t)_C_PIN, 0);
-      else
-         gpio_set_level((gpio_num_t)_C_PIN, 1);
+   if (_rmt_oe)
+   {
+      wait_oe();
+      gpio_set_level((gpio_num_t)_LATCH_PIN, 1);
+      gpio_set_level((gpio_num_t)_LATCH_PIN, 0);
 
-      if (value == 3)
-         gpio_set_level((gpio_num_t)_D_PIN, 0);
-      else
-         gpio_set_level((gpio_num_t)_D_PIN, 1);
+      size_t count = pxmatrix_oe_pulse(_oe_items, PXMATRIX_OE_MAX_ITEMS, show_time_ns);
+      if (count > 0)
+         rmt_write_items(PXMATRIX_OE_CHANNEL, _oe_items, count, false);
    }
+   else
+   {
+      gpio_set_level((gpio_num_t)_LATCH_PIN, 1);
+      gpio_set_level((gpio_num_t)_LATCH_PIN, 0);
+      gpio_set_level((gpio_num_t)_OE_PIN, 0);
+      // delay microseconds
+      ets_delay_us(show_time_ns / 1000);
+      gpio_set_level((gpio_num_t)_OE_PIN, 1);
+   }
+
+   pxmatrix_stats_add(&_timings[PXMATRIX_TIME_LATCH], xthal_get_ccount() - start);
 }
 
-void PxMatrix::latch(uint16_t show_time)
+void PxMatrix::wait_oe()
 {
-   gpio_set_level((gpio_num_t)_LATCH_PIN, 1);
-   gpio_set_level((gpio_num_t)_LATCH_PIN, 0);
-   gpio_set_level((gpio_num_t)_OE_PIN, 0);
-   // delay microseconds
-   ets_delay_us(show_time);
-   gpio_set_level((gpio_num_t)_OE_PIN, 1);
+   if (_rmt_oe)
+      rmt_wait_tx_done(PXMATRIX_OE_CHANNEL, portMAX_DELAY);
+}
+
+void IRAM_ATTR PxMatrix::latch_row(uint8_t row)
+{
+   uint32_t start = xthal_get_ccount();
+
+   write_pin(_OE_PIN, 1);
+   set_mux(row);
+   write_pin(_LATCH_PIN, 1);
+   write_pin(_LATCH_PIN, 0);
+   write_pin(_OE_PIN, 0);
+
+   // The timer blanks the row or latches the next one once it has been shown
+   uint64_t count = timer_group_get_counter_value_in_isr(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER);
+   timer_group_set_alarm_value_in_isr(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER, count + _pipe_ticks);
+   timer_group_enable_alarm_in_isr(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER);
+   _pipe_lit = true;
+   _pipe_latched++;
+
+   pxmatrix_stats_add(&_timings[PXMATRIX_TIME_LATCH], xthal_get_ccount() - start);
+}
+
+void IRAM_ATTR PxMatrix::spi_post_cb(spi_transaction_t *trans)
+{
+   PxMatrix *matrix = (PxMatrix *)trans->user;
+   if (NULL == matrix)
+      return;
+
+   // Nothing waits in here, a row shifted while the last one is still lit is
+   // latched by the timer when that one is done
+   uint8_t slot = (trans == &matrix->_transactions[0]) ? 0 : 1;
+   bool latched = false;
+   portENTER_CRITICAL_ISR(&matrix->_pipe_lock);
+   if (matrix->_pipe_lit)
+   {
+      matrix->_pipe_pending = matrix->_transaction_row[slot];
+   }
+   else
+   {
+      matrix->latch_row(matrix->_transaction_row[slot]);
+      latched = true;
+   }
+   portEXIT_CRITICAL_ISR(&matrix->_pipe_lock);
+
+   if (latched)
+      matrix->notify_pipe();
+}
+
+void IRAM_ATTR PxMatrix::pipe_timer_isr(void *arg)
+{
+   PxMatrix *matrix = (PxMatrix *)arg;
+   timer_group_intr_clr_in_isr(PXMATRIX_PIPE_TIMER_GROUP, PXMATRIX_PIPE_TIMER);
+
+   portENTER_CRITICAL_ISR(&matrix->_pipe_lock);
+   if (matrix->_pipe_pending >= 0)
+   {
+      uint8_t row = matrix->_pipe_pending;
+      matrix->_pipe_pending = -1;
+      matrix->latch_row(row);
+   }
+   else
+   {
+      write_pin(matrix->_OE_PIN, 1);
+      matrix->_pipe_lit = false;
+   }
+   portEXIT_CRITICAL_ISR(&matrix->_pipe_lock);
+
+   // Either a row was latched or the last one went dark
+   matrix->notify_pipe();
+}
+
+void IRAM_ATTR PxMatrix::notify_pipe()
+{
+   BaseType_t woken = pdFALSE;
+
+   if (NULL == _pipe_task)
+      return;
+
+   xTaskNotifyFromISR(_pipe_task, PXMATRIX_PIPE_NOTIFY, eSetBits, &woken);
+   if (woken)
+      portYIELD_FROM_ISR();
+}
+
+void PxMatrix::wait_pipe(uint8_t latched)
+{
+   // Other notifications wake the task too, so look again every time
+   while (_pipe_latched < latched)
+      xTaskNotifyWait(0, PXMATRIX_PIPE_NOTIFY, NULL, portMAX_DELAY);
+}
+
+void PxMatrix::wait_pipe_dark()
+{
+   while (_pipe_lit)
+      xTaskNotifyWait(0, PXMATRIX_PIPE_NOTIFY, NULL, portMAX_DELAY);
+
+   // The bit of a notification the task didn't have to wait for is still
+   // set, it mustn't show up in a count the task keeps itself
+   xTaskNotifyWait(0, PXMATRIX_PIPE_NOTIFY, NULL, 0);
+}
+
+const uint8_t *PxMatrix::row_data(const uint8_t *row, uint8_t slot)
+{
+   if (!_quad_spi)
+      return row;
+
+   uint8_t *lanes = &_qspi_rows[slot * _send_buffer_size];
+   pxmatrix_qspi_interleave(lanes, row, _send_buffer_size);
+   return lanes;
 }
 
 void PxMatrix::display(uint16_t show_time)
 {
+   displayNs((uint32_t)show_time * 1000);
+}
+
+void PxMatrix::displayNs(uint32_t show_time_ns)
+{
+   uint16_t show_time = show_time_ns / 1000;
    spi_transaction_t *rtrans;
    esp_err_t ret;
-   unsigned long start_time = 0;
-   xEventGroupClearBits(xDisplayEventGroup, BIT_BUFFER_SWAP_OK);
+   int64_t start_time = esp_timer_get_time();
+   if (!_triple_buffer)
+      xEventGroupClearBits(xDisplayEventGroup, BIT_BUFFER_SWAP_OK);
+
+   if (SPI_DMA_CHAIN == _output_mode)
+   {
+      // Rows are driven from the SPI interrupt, a new show time stops it at
+      // the end of a frame to rebuild the chains here
+      _show_time = show_time;
+      if (_dma_running && (_dma_show_time != _show_time))
+         stop_dma_chain();
+      if (!_dma_running)
+      {
+         _dma_row = 0;
+         _dma_step = 0;
+         _display_color = 0;
+         update_dma_chain();
+         _dma_desc = _dma_chain[_active_buffer];
+         _dma_running = true;
+         dma_start_transfer();
+      }
+      return;
+   }
+
+   // Binary code modulation weights plane n by 2^n, scaled so that a full
+   // cycle is lit for as long as color_depth threshold slots would be
+   if (BCM == _color_mode && I2S_PARALLEL != _output_mode)
+   {
+      show_time_ns = ((uint64_t)show_time_ns * _display_depth << _display_color) / ((1 << _display_depth) - 1);
+      show_time = show_time_ns / 1000;
+   }
+
+   _show_time = show_time;
+   _pipe_ticks = ((uint64_t)show_time_ns * PXMATRIX_PIPE_TICKS_PER_US) / 1000;
+   if (_pipe_ticks < PXMATRIX_PIPE_MIN_TICKS)
+      _pipe_ticks = PXMATRIX_PIPE_MIN_TICKS;
+   _pipe_latched = 0;
+   if (SPI_PIPELINED == _output_mode)
+      _pipe_task = xTaskGetCurrentTaskHandle();
+   uint8_t *row = NULL;
+
+   uint32_t row_start = xthal_get_ccount();
+   if (0 == _display_color)
+   {
+      if (0 != _cycle_start)
+         pxmatrix_stats_add(&_timings[PXMATRIX_TIME_CYCLE], row_start - _cycle_start);
+      _cycle_start = row_start;
+
+      // Every plane of a cycle is sent through the same viewport
+      _viewport_shown = _viewport;
+   }
+
    for (uint8_t i = 0; i < _row_pattern; i++)
    {
       //if (2 < i)
       //  continue;
 
-      if (_fast_update) {
-         printf("fast update\n");
-         fflush(stdout);
-      } 
+      if (SPI_PIPELINED == _output_mode)
+      {
+         // Fill the row into the slot the row before last has finished with
+         uint8_t slot = i & 1;
+         row = fill_row(_display_color, i, slot);
+
+         // It would shift over the last row in the panel before that is latched
+         if (i >= 1)
+         {
+            ret = spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
+            ESP_ERROR_CHECK(ret);
+            wait_pipe(i);
+         }
+
+         _transaction_row[slot] = i;
+         _transactions[slot].length = _send_buffer_size << 3;
+         _transactions[slot].rxlength = 0;
+         _transactions[slot].flags = SPI_TRANS_USE_RXDATA | (_quad_spi ? SPI_TRANS_MODE_QIO : 0);
+         _transactions[slot].tx_buffer = row_data(row, slot);
+         _transactions[slot].user = this;
+
+         ret = spi_device_queue_trans(spi, &_transactions[slot], portMAX_DELAY);
+         ESP_ERROR_CHECK(ret);
+      }
+      else if (I2S_PARALLEL == _output_mode)
+      {
+         // The DMA loops over the samples by itself, the idle copy is packed
+         // and swapped in at the end of the cycle
+         if ((0 == i) && (0 == _display_color))
+            wait_i2s_swap();
+         pack_i2s_row(_display_color, i, show_time);
+      }
       else 
       {
-	 uint8_t buffer_idx = _active_buffer ? 1 : 0;
-         uint32_t offset = (_display_color * _buffer_size) + (i * _send_buffer_size);
-         set_mux(i);
+         if (0 == i)
+            row = fill_row(_display_color, 0, 0);
+
+         // With RMT timed OE the previous row stays lit while this one shifts
+         if (!_rmt_oe)
+            set_mux(i);
          _transactions[0].length = _send_buffer_size << 3;
          _transactions[0].rxlength = 0;
-         _transactions[0].flags = SPI_TRANS_USE_RXDATA;
-         _transactions[0].tx_buffer = &(buffer[buffer_idx][offset]);
+         _transactions[0].flags = SPI_TRANS_USE_RXDATA | (_quad_spi ? SPI_TRANS_MODE_QIO : 0);
+         _transactions[0].tx_buffer = row_data(row, 0);
 
 	 //ets_delay_us(100);
          ret = spi_device_queue_trans(spi, &_transactions[0], portMAX_DELAY);
          ESP_ERROR_CHECK(ret);
+
+         // Fill the next row into the other slot while this one shifts
+         if (i + 1 < _row_pattern)
+            row = fill_row(_display_color, i + 1, (i + 1) & 1);
+
          ret = spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
          ESP_ERROR_CHECK(ret);
-         latch(show_time);
+
+         if (_rmt_oe)
+         {
+            wait_oe();
+            set_mux(i);
+         }
+         latch(show_time_ns);
       }
+
+      uint32_t row_end = xthal_get_ccount();
+      pxmatrix_stats_add(&_timings[PXMATRIX_TIME_ROW], row_end - row_start);
+      row_start = row_end;
+   }
+
+   if (SPI_PIPELINED == _output_mode)
+   {
+      // The timer blanks the last row once it has been shown, the next plane
+      // must not start before
+      ret = spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
+      ESP_ERROR_CHECK(ret);
+      wait_pipe(_row_pattern);
+      wait_pipe_dark();
    }
+
+   _row_time = (esp_timer_get_time() - start_time) / _row_pattern;
+
+   if ((I2S_PARALLEL == _output_mode) && (_display_color + 1 >= _display_depth))
+      swap_i2s_chain();
+
    _display_color++;
-   if (_display_color >= color_depth)
+   if (_display_color >= _display_depth)
    {
       _display_color = 0;
 // Flip the Buffer?
-      _active_buffer = _selected_buffer;
-      xEventGroupSetBits(xDisplayEventGroup, BIT_BUFFER_SWAP_OK);
+      next_frame();
+
+      // Streamed frames have no encoded buffers, take up a new depth here
+      if (_pending_depth)
+      {
+         _color_depth = _pending_depth;
+         _pending_depth = 0;
+         build_plane_lut();
+         for (uint8_t idx = 0; idx < PXMATRIX_BUFFERS; idx++)
+            _buffer_depth[idx] = _color_depth;
+         _display_depth = _color_depth;
+      }
+      if (!_triple_buffer)
+         xEventGroupSetBits(xDisplayEventGroup, BIT_BUFFER_SWAP_OK);
    }
 
 }
@@ -479,13 +3116,16 @@ void PxMatrix::displayTestPattern(uint16_t show_time)
    spi_transaction_t *rtrans;
    esp_err_t ret;
 
+   uint8_t *scratch = (NULL != _stream_rows) ? _stream_rows : buffer[0];
+
    if ((time - _test_last_call) > 500000)
    {
-      buffer[0][0] = 0xff;
+      scratch[0] = 0xff;
       _transactions[0].length = 8;
       _transactions[0].rxlength = 0;
       _transactions[0].flags = SPI_TRANS_USE_RXDATA;
-      _transactions[0].tx_buffer = buffer[0];
+      _transactions[0].tx_buffer = scratch;
+      _transactions[0].user = NULL;
       ret = spi_device_queue_trans(spi, &_transactions[0], portMAX_DELAY);
       ESP_ERROR_CHECK(ret);
       ret = spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
@@ -520,9 +3160,10 @@ void PxMatrix::displayTestPattern(uint16_t show_time)
    //gpio_set_level((gpio_num_t)_D_PIN, 0);
    //gpio_set_level((gpio_num_t)_E_PIN, 0); 
 
+   wait_oe();
    set_mux(_test_line_counter);
 
-   latch(show_time);
+   latch((uint32_t)show_time * 1000);
 }
 
 void PxMatrix::displayTestPixel(uint16_t show_time)
@@ -534,19 +3175,22 @@ void PxMatrix::displayTestPixel(uint16_t show_time)
    printf("test_pixel_counter: %u\n", _test_pixel_counter);
    fflush(stdout);
 
+   uint8_t *scratch = (NULL != _stream_rows) ? _stream_rows : buffer[0];
+
    if ((time-_test_last_call) > 500000)
    {
       flushDisplay();
       uint16_t blanks = _test_pixel_counter / 8;
-      buffer[0][0] = (1 << _test_pixel_counter % 8);
+      scratch[0] = (1 << _test_pixel_counter % 8);
 
       if (blanks > 0)
-         memset(&buffer[0][1], 0x00, blanks);
+         memset(&scratch[1], 0x00, blanks);
 
       _transactions[0].length = (blanks + 1) << 3;
       _transactions[0].rxlength = 0;
       _transactions[0].flags = SPI_TRANS_USE_RXDATA;
-      _transactions[0].tx_buffer = buffer[0];
+      _transactions[0].tx_buffer = scratch;
+      _transactions[0].user = NULL;
       ret = spi_device_queue_trans(spi, &_transactions[0], portMAX_DELAY);
       ESP_ERROR_CHECK(ret);
       ret = spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
@@ -577,35 +3221,81 @@ void PxMatrix::displayTestPixel(uint16_t show_time)
    //gpio_set_level((gpio_num_t)_D_PIN, 0);
    //gpio_set_level((gpio_num_t)_E_PIN, 0); 
 
+   wait_oe();
    set_mux(_test_line_counter);
 
-   latch(show_time);
+   latch((uint32_t)show_time * 1000);
 }
 
 inline PxMatrix* real(pxmatrix *m) { return static_cast<PxMatrix*>(m); }
 
-pxmatrix* Create_PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B) {
+pxmatrix* Create_PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B) {
    return new PxMatrix(width, height, LATCH, OE, A, B);
 }
 
-pxmatrix* Create_PxMatrix3(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C)
+pxmatrix* Create_PxMatrix3(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C)
 {
    return new PxMatrix(width, height, LATCH, OE, A, B, C);
 }
 
-pxmatrix* Create_PxMatrix4(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D)
+pxmatrix* Create_PxMatrix4(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D)
 {
    return new PxMatrix(width, height, LATCH, OE, A, B, C, D);
 }
 
-pxmatrix* Create_PxMatrix5(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
+pxmatrix* Create_PxMatrix5(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
 {
    return new PxMatrix(width, height, LATCH, OE, A, B, C, D, E);
 }
 
-void pxmatrix_begin(pxmatrix *matrix, uint8_t steps)
+// A geometry specialised for every scan pattern but CUSTOM
+template <uint16_t W, uint16_t H, uint8_t RowPattern>
+static PxMatrix *create_fixed(scan_patterns scan_pattern, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
+{
+   switch (scan_pattern)
+   {
+   case LINE:
+      return new PxMatrixT<W, H, RowPattern, LINE>(LATCH, OE, A, B, C, D, E);
+   case ZIGZAG:
+      return new PxMatrixT<W, H, RowPattern, ZIGZAG>(LATCH, OE, A, B, C, D, E);
+   case ZAGGIZ:
+      return new PxMatrixT<W, H, RowPattern, ZAGGIZ>(LATCH, OE, A, B, C, D, E);
+   default:
+      return new PxMatrix(W, H, LATCH, OE, A, B, C, D, E);
+   }
+}
+
+pxmatrix* Create_PxMatrixFixed(uint16_t width, uint16_t height, uint8_t row_pattern, scan_patterns scan_pattern, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
 {
-   real(matrix)->begin(steps);
+   PxMatrix *matrix;
+
+   // Geometries with a compile time specialisation, anything else runs on PxMatrix
+   if ((32 == width) && (16 == height) && (4 == row_pattern))
+      matrix = create_fixed<32, 16, 4>(scan_pattern, LATCH, OE, A, B, C, D, E);
+   else if ((32 == width) && (16 == height) && (8 == row_pattern))
+      matrix = create_fixed<32, 16, 8>(scan_pattern, LATCH, OE, A, B, C, D, E);
+   else if ((32 == width) && (32 == height) && (16 == row_pattern))
+      matrix = create_fixed<32, 32, 16>(scan_pattern, LATCH, OE, A, B, C, D, E);
+   else if ((64 == width) && (32 == height) && (16 == row_pattern))
+      matrix = create_fixed<64, 32, 16>(scan_pattern, LATCH, OE, A, B, C, D, E);
+   else if ((64 == width) && (64 == height) && (32 == row_pattern))
+      matrix = create_fixed<64, 64, 32>(scan_pattern, LATCH, OE, A, B, C, D, E);
+   else
+      matrix = new PxMatrix(width, height, LATCH, OE, A, B, C, D, E);
+
+   // Set before begin, so the map isn't built for another pattern first
+   matrix->setScanPattern(scan_pattern);
+   return matrix;
+}
+
+bool pxmatrix_begin(pxmatrix *matrix, uint8_t steps)
+{
+   return real(matrix)->begin(steps);
+}
+
+bool pxmatrix_beginColorMode(pxmatrix *matrix, uint8_t steps, color_modes color_mode)
+{
+   return real(matrix)->begin(steps, color_mode);
 }
 
 void pxmatrix_clearDisplay(pxmatrix *matrix)
@@ -618,6 +3308,11 @@ void pxmatrix_display(pxmatrix *matrix, uint16_t show_time)
    real(matrix)->display(show_time);
 }
 
+void pxmatrix_displayNs(pxmatrix *matrix, uint32_t show_time_ns)
+{
+   real(matrix)->displayNs(show_time_ns);
+}
+
 void pxmatrix_drawPixelRGB565(pxmatrix *matrix, int16_t x, int16_t y, uint16_t color)
 {
    real(matrix)->drawPixelRGB565(x, y, color);
@@ -633,11 +3328,76 @@ void pxmatrix_drawPixelRGB888(pxmatrix *matrix, int16_t x, int16_t y, uint8_t r,
    real(matrix)->drawPixelRGB888(x, y, r, g, b);
 }
 
+void pxmatrix_drawFrameRGB565(pxmatrix *matrix, const uint16_t *data, uint16_t stride)
+{
+   real(matrix)->drawFrameRGB565(data, stride);
+}
+
+void pxmatrix_drawFrameRGB888(pxmatrix *matrix, const uint8_t *data, uint16_t stride)
+{
+   real(matrix)->drawFrameRGB888(data, stride);
+}
+
+void pxmatrix_drawRectRGB565(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride)
+{
+   real(matrix)->drawRectRGB565(x, y, w, h, data, stride);
+}
+
+void pxmatrix_drawRectRGB888(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride)
+{
+   real(matrix)->drawRectRGB888(x, y, w, h, data, stride);
+}
+
+void pxmatrix_fillRect(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, uint8_t r, uint8_t g, uint8_t b)
+{
+   real(matrix)->fillRect(x, y, w, h, r, g, b);
+}
+
+void pxmatrix_fillScreen(pxmatrix *matrix, uint8_t r, uint8_t g, uint8_t b)
+{
+   real(matrix)->fillScreen(r, g, b);
+}
+
+void pxmatrix_drawPixelIndexed(pxmatrix *matrix, int16_t x, int16_t y, uint8_t index)
+{
+   real(matrix)->drawPixelIndexed(x, y, index);
+}
+
+void pxmatrix_drawFrameIndexed(pxmatrix *matrix, const uint8_t *data, uint16_t stride)
+{
+   real(matrix)->drawFrameIndexed(data, stride);
+}
+
+void pxmatrix_drawRectIndexed(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride)
+{
+   real(matrix)->drawRectIndexed(x, y, w, h, data, stride);
+}
+
+void pxmatrix_setPaletteColor(pxmatrix *matrix, uint8_t index, uint8_t r, uint8_t g, uint8_t b)
+{
+   real(matrix)->setPaletteColor(index, r, g, b);
+}
+
+void pxmatrix_setPalette(pxmatrix *matrix, const uint8_t *rgb, uint8_t first, uint16_t count)
+{
+   real(matrix)->setPalette(rgb, first, count);
+}
+
+void pxmatrix_rotatePalette(pxmatrix *matrix, uint8_t first, uint16_t count, int16_t steps)
+{
+   real(matrix)->rotatePalette(first, count, steps);
+}
+
 uint16_t pxmatrix_color565(pxmatrix *matrix, uint8_t r, uint8_t g, uint8_t b)
 {
    return real(matrix)->color565(r, g, b);
 }
 
+bool pxmatrix_readPixel(pxmatrix *matrix, int16_t x, int16_t y, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+   return real(matrix)->readPixel(x, y, r, g, b);
+}
+
 void pxmatrix_displayTestPattern(pxmatrix *matrix, uint16_t show_time)
 {
    real(matrix)->displayTestPattern(show_time);
@@ -648,6 +3408,41 @@ void pxmatrix_displayTestPixel(pxmatrix *matrix, uint16_t show_time)
    real(matrix)->displayTestPixel(show_time);
 }
 
+bool pxmatrix_setColorDepth(pxmatrix *matrix, uint8_t color_depth)
+{
+   return real(matrix)->setColorDepth(color_depth);
+}
+
+uint8_t pxmatrix_getColorDepth(pxmatrix *matrix)
+{
+   return real(matrix)->getColorDepth();
+}
+
+bool pxmatrix_setScanPattern(pxmatrix *matrix, enum scan_patterns scan_pattern)
+{
+   return real(matrix)->setScanPattern(scan_pattern);
+}
+
+bool pxmatrix_setScanTable(pxmatrix *matrix, const struct pxmatrix_scan_table *table)
+{
+   return real(matrix)->setScanTable(table);
+}
+
+void pxmatrix_setDither(pxmatrix *matrix, bool dither)
+{
+   real(matrix)->setDither(dither);
+}
+
+void pxmatrix_setTileLayout(pxmatrix *matrix, uint8_t tiles_x, uint8_t tiles_y, enum tile_layouts layout)
+{
+   real(matrix)->setTileLayout(tiles_x, tiles_y, layout);
+}
+
+void pxmatrix_setTileRotation(pxmatrix *matrix, uint8_t tile, enum tile_rotations rotation)
+{
+   real(matrix)->setTileRotation(tile, rotation);
+}
+
 void pxmatrix_setFastUpdate(pxmatrix *matrix, bool fast_update)
 {
    real(matrix)->setFastUpdate(fast_update);
@@ -662,3 +3457,128 @@ void pxmatrix_swapBuffer(pxmatrix *matrix)
 {
    real(matrix)->swapBuffer();
 }
+
+void pxmatrix_setTripleBuffer(pxmatrix *matrix, bool triple_buffer)
+{
+   real(matrix)->setTripleBuffer(triple_buffer);
+}
+
+uint32_t pxmatrix_present(pxmatrix *matrix)
+{
+   return real(matrix)->present();
+}
+
+uint32_t pxmatrix_getShownFrame(pxmatrix *matrix, int64_t *shown_time)
+{
+   return real(matrix)->getShownFrame(shown_time);
+}
+
+uint32_t pxmatrix_getDroppedFrames(pxmatrix *matrix)
+{
+   return real(matrix)->getDroppedFrames();
+}
+
+void pxmatrix_setPresentCallback(pxmatrix *matrix, pxmatrix_present_cb callback, void *arg)
+{
+   real(matrix)->setPresentCallback(callback, arg);
+}
+
+void pxmatrix_setOutputMode(pxmatrix *matrix, output_modes output_mode)
+{
+   real(matrix)->setOutputMode(output_mode);
+}
+
+void pxmatrix_setStreaming(pxmatrix *matrix, bool streaming)
+{
+   real(matrix)->setStreaming(streaming);
+}
+
+void pxmatrix_setIndexed(pxmatrix *matrix, bool indexed)
+{
+   real(matrix)->setIndexed(indexed);
+}
+
+void pxmatrix_setShadow(pxmatrix *matrix, bool shadow)
+{
+   real(matrix)->setShadow(shadow);
+}
+
+uint16_t pxmatrix_getPixel(pxmatrix *matrix, int16_t x, int16_t y)
+{
+   return real(matrix)->getPixel(x, y);
+}
+
+void pxmatrix_setVirtualSize(pxmatrix *matrix, uint16_t width, uint16_t height)
+{
+   real(matrix)->setVirtualSize(width, height);
+}
+
+uint16_t pxmatrix_virtualWidth(pxmatrix *matrix)
+{
+   return real(matrix)->virtualWidth();
+}
+
+uint16_t pxmatrix_virtualHeight(pxmatrix *matrix)
+{
+   return real(matrix)->virtualHeight();
+}
+
+void pxmatrix_setViewport(pxmatrix *matrix, int16_t x, int16_t y)
+{
+   real(matrix)->setViewport(x, y);
+}
+
+void pxmatrix_setPsramThreshold(pxmatrix *matrix, uint32_t threshold)
+{
+   real(matrix)->setPsramThreshold(threshold);
+}
+
+void *pxmatrix_allocFrame(pxmatrix *matrix, size_t size)
+{
+   return real(matrix)->allocFrame(size);
+}
+
+void pxmatrix_setParallelPins(pxmatrix *matrix, uint8_t R1, uint8_t G1, uint8_t B1, uint8_t R2, uint8_t G2, uint8_t B2, uint8_t CLK)
+{
+   real(matrix)->setParallelPins(R1, G1, B1, R2, G2, B2, CLK);
+}
+
+void pxmatrix_setQuadSpi(pxmatrix *matrix, bool quad_spi)
+{
+   real(matrix)->setQuadSpi(quad_spi);
+}
+
+void pxmatrix_setQuadSpiPins(pxmatrix *matrix, uint8_t WP, uint8_t HD)
+{
+   real(matrix)->setQuadSpiPins(WP, HD);
+}
+
+void pxmatrix_setPowerPin(pxmatrix *matrix, uint8_t POWER)
+{
+   real(matrix)->setPowerPin(POWER);
+}
+
+void pxmatrix_setRmtOe(pxmatrix *matrix, bool rmt_oe)
+{
+   real(matrix)->setRmtOe(rmt_oe);
+}
+
+uint32_t pxmatrix_getRowTime(pxmatrix *matrix)
+{
+   return real(matrix)->getRowTime();
+}
+
+void pxmatrix_getMemoryUsage(pxmatrix *matrix, struct pxmatrix_memory *memory)
+{
+   real(matrix)->getMemoryUsage(memory);
+}
+
+bool pxmatrix_getTiming(pxmatrix *matrix, enum pxmatrix_timings timing, struct pxmatrix_timing *summary)
+{
+   return real(matrix)->getTiming(timing, summary);
+}
+
+void pxmatrix_resetTimings(pxmatrix *matrix)
+{
+   real(matrix)->resetTimings();
+}
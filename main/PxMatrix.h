@@ -9,19 +9,113 @@
 #define PXMATRIX_H__
 #include <inttypes.h>
 #include "driver/spi_master.h"
+#include "esp_intr_alloc.h"
+#include "esp32/rom/lldesc.h"
+#include "soc/rmt_struct.h"
 #include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "PxMatrixStats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Largest number of colour planes in the encoded buffer
+#define PXMATRIX_COLOR_DEPTH 8
+
+// Encoded buffers with triple buffering
+#define PXMATRIX_BUFFERS 3
+
+// Pin number for a pin that isn't connected
+#define PXMATRIX_NO_PIN 0xFF
+
+// Colours drawn in indexed mode remembered with the entry they matched, a
+// power of two
+#define PXMATRIX_PALETTE_CACHE 64
+
 // Either the panel handles the multiplexing and we feed BINARY to A-E pins
 // or we handle the multiplexing and activate one of A-D pins (STRAIGHT)
 enum mux_patterns { BINARY, STRAIGHT };
 
 // This is how the scanning is implemented. LINE just scans it left to right,
-// ZIGZAG jumps 4 rows after every byte, ZAGGII alse revereses every second byte
-enum scan_patterns {LINE, ZIGZAG, ZAGGIZ};
+// ZIGZAG jumps 4 rows after every byte, ZAGGII alse revereses every second byte,
+// CUSTOM follows a table loaded with setScanTable
+enum scan_patterns {LINE, ZIGZAG, ZAGGIZ, CUSTOM};
+
+// Largest number of entries in a scan table
+#define PXMATRIX_SCAN_TABLE_SIZE 128
+
+// Set in a scan table entry when its block is shifted in back to front
+#define PXMATRIX_SCAN_REVERSE 0x80
+
+// Where pixels sit in the shift chain of their scan row, with columns counted
+// from the data input. The panel is cut into bands of rows by columns blocks
+// of block_width pixels. Each band fills the next stretch of the chain, going
+// across the panel and then down, and holds rows / row_pattern * columns
+// blocks of every scan row. Entry [row * columns + column] is the position of
+// a block within its band's stretch, optionally or'ed with PXMATRIX_SCAN_REVERSE
+struct pxmatrix_scan_table {
+   uint8_t block_width;
+   uint8_t columns;
+   uint8_t rows;
+   uint8_t entries[PXMATRIX_SCAN_TABLE_SIZE];
+};
+
+// This is how colour is modulated. THRESHOLD lights every slot for the same
+// time and compares the colour against evenly spaced thresholds, BCM stores
+// one bit of the colour per plane and weights the OE time of plane n by 2^n
+enum color_modes {THRESHOLD, BCM};
+
+// This is how rows are pushed out. SPI_BLOCKING shifts a row, latches it and
+// then holds it, SPI_PIPELINED shifts the next row while the current one is
+// lit and latches from the SPI post transaction callback or the hardware
+// timer ending the current row, SPI_DMA_CHAIN walks
+// a descriptor chain of the whole frame, shifting each row while the one
+// before is lit, and latches from the SPI interrupt,
+// I2S_PARALLEL shifts both panel halves in parallel with address, latch and
+// OE carried in the same I2S DMA stream
+enum output_modes {SPI_BLOCKING, SPI_PIPELINED, SPI_DMA_CHAIN, I2S_PARALLEL};
+
+// This is how panels in a chain are arranged on the canvas. TILE_ROW_MAJOR
+// chains every row of panels left to right, TILE_SERPENTINE runs every second
+// row right to left
+enum tile_layouts {TILE_ROW_MAJOR, TILE_SERPENTINE};
+
+// How a panel is mounted, turned clockwise. TILE_90 and TILE_270 need square
+// panels
+enum tile_rotations {TILE_0, TILE_90, TILE_180, TILE_270};
+
+// Called once a presented frame is first shown, with the esp_timer time in
+// microseconds of the colour cycle it started. Runs from display() or the
+// SPI_DMA_CHAIN interrupt, so keep it short (notify a task, say). That
+// interrupt is in IRAM, in SPI_DMA_CHAIN the callback has to be IRAM_ATTR too
+typedef void (*pxmatrix_present_cb)(uint32_t frame_id, int64_t shown_time, void *arg);
+
+// Memory allocated by begin and allocFrame, in bytes
+struct pxmatrix_memory {
+   uint32_t dma;        // Internal DMA capable, encoded buffers, rows and descriptors
+   uint32_t other;      // Other internal, pixel maps and RGB565 frames
+   uint32_t psram;      // External, buffers and frames over the PSRAM threshold
+};
+
+// Refresh timings kept by display(). PXMATRIX_TIME_ROW is from starting a row
+// until it is latched (SPI_BLOCKING) or handed to the SPI driver (otherwise),
+// PXMATRIX_TIME_LATCH is latch and OE, PXMATRIX_TIME_CYCLE the time between
+// the starts of colour cycles and PXMATRIX_TIME_SWAP_WAIT how long
+// swapBuffer waited for the display to let go of a buffer. SPI_DMA_CHAIN
+// refreshes from its interrupt and only counts swap waits
+enum pxmatrix_timings {PXMATRIX_TIME_ROW, PXMATRIX_TIME_LATCH, PXMATRIX_TIME_CYCLE, PXMATRIX_TIME_SWAP_WAIT, PXMATRIX_TIMINGS};
+
+// Summary of one timing since the last reset, in nanoseconds
+struct pxmatrix_timing {
+   uint32_t count;
+   uint32_t min;
+   uint32_t avg;
+   uint32_t max;
+   uint32_t p50;
+   uint32_t p90;
+   uint32_t p99;
+};
 
 #ifdef __cplusplus
 }
@@ -33,18 +127,26 @@ struct pxmatrix {};
 class PxMatrix : public pxmatrix {
 
 public:
-   PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B);
-   PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C);
-   PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D);
-   PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E);
-
-   void begin(uint8_t steps);
-   void begin();
-
+   PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B);
+   PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C);
+   PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D);
+   PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E);
+   virtual ~PxMatrix();
+
+   // False when the buffers or drivers couldn't be set up, the matrix can't
+   // display then and should be deleted
+   bool begin(uint8_t steps);
+   bool begin(uint8_t steps, color_modes color_mode);
+   bool begin();
+
+   // Clear the buffer being drawn
    void clearDisplay(void);
 
    void display(uint16_t show_time);
 
+   // As display, with the show time in nanoseconds
+   void displayNs(uint32_t show_time_ns);
+
    void drawPixelRGB565(int16_t x, int16_t y, uint16_t color);
    void drawPixelRGB565(int16_t x, int16_t y, uint16_t color, bool selected_buffer);
 
@@ -54,8 +156,44 @@ public:
    void drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b);
    void drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, bool selected_buffer);
 
-   // Does nothing for now
-   uint8_t getPixel(int8_t x, int8_t y);
+   // Draw a whole frame in one pass, stride is the number of pixels between
+   // the start of each source row
+   void drawFrameRGB565(const uint16_t *data, uint16_t stride);
+   void drawFrameRGB888(const uint8_t *data, uint16_t stride);
+
+   // Draw a w x h block at x, y in one pass, clipped to the canvas
+   virtual void drawRectRGB565(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride);
+   virtual void drawRectRGB888(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride);
+
+   // Fill a block or the whole canvas with one colour. The encoded bytes for
+   // the colour are worked out once and written whole, bit by bit only at
+   // the edges of a block, so a full screen fill is a memset per row
+   void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t r, uint8_t g, uint8_t b);
+   void fillScreen(uint8_t r, uint8_t g, uint8_t b);
+
+   // Draw palette indices. Without setIndexed the palette colour is drawn
+   void drawPixelIndexed(int16_t x, int16_t y, uint8_t index);
+   void drawFrameIndexed(const uint8_t *data, uint16_t stride);
+   void drawRectIndexed(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride);
+
+   // Set count palette entries from first, rgb holds 3 bytes per entry. The
+   // panel picks the change up from the next plane sent
+   void setPaletteColor(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+   void setPalette(const uint8_t *rgb, uint8_t first, uint16_t count);
+
+   // Colour cycling, moves the colours of the count entries from first up by
+   // steps places, those pushed off the end wrap round. Only the entries in
+   // the range are touched and none have to be encoded again
+   void rotatePalette(uint8_t first, uint16_t count, int16_t steps);
+
+   // RGB565 colour last drawn to a pixel of the buffer being drawn, from the
+   // shadow or the streamed frame. 0 off the canvas or without either
+   uint16_t getPixel(int16_t x, int16_t y);
+
+   // Colour of a pixel as the panel shows it, worked back from the bits sent
+   // for the frame on display and how long each plane is lit. For checking
+   // the encoding, false if the pixel is off the canvas or before begin
+   bool readPixel(int16_t x, int16_t y, uint8_t *r, uint8_t *g, uint8_t *b);
 
    // Converts RGB888 to RGB565
    uint16_t color565(uint8_t r, uint8_t g, uint8_t b);
@@ -69,33 +207,172 @@ public:
    // Flush the buffer of the display
    void flushDisplay();
 
-   // Rotate display
+   // Rotate display. With a virtual canvas, not after begin if the canvas
+   // doesn't cover the panel turned
    void setRotate(bool rotate);
 
-   // Help reduce display update latency on larger displays
+   // Help reduce display update latency on larger displays, drops to one colour plane
    void setFastUpdate(bool fast_update);
 
+   // Number of colour planes or slots, 1 to 8. Fewer planes refresh faster.
+   // Drawing moves to the new depth straight away and the draw buffer is
+   // encoded again from its shadow, without one redraw it. display() keeps
+   // showing each buffer at the depth it was encoded for, switching at the end
+   // of a colour cycle, streamed frames switch there too. Returns false if out
+   // of range, or after begin in SPI_DMA_CHAIN and I2S_PARALLEL modes.
+   // getColorDepth is the depth display() is cycling through
+   bool setColorDepth(uint8_t color_depth);
+   uint8_t getColorDepth();
+
+   // Add an ordered dither offset to every pixel, moving on with the colour
+   // cycles. Over 16 phases a pixel averages out to its exact value instead
+   // of the nearest colour level. Streamed rows are dithered as they are sent.
+   // Encoded buffers move on a phase with every frame swapBuffer or present
+   // hands over, being encoded again from the shadow as they come back for
+   // drawing, so hand frames over even when nothing changed. Set before
+   // begin to get a shadow
+   void setDither(bool dither);
+
    // Select active buffer to update display from
    void selectBuffer(bool selected_buffer);
 
+   // With double buffering this waits for the end of a colour cycle and
+   // flips buffers, with triple buffering it hands the finished frame to the
+   // display and returns straight away with a free buffer to draw into
    void swapBuffer();
+
+   // Draw into a third buffer, so swapBuffer never waits for the display.
+   // The display picks up the newest finished frame at the end of a colour
+   // cycle (call before begin)
+   void setTripleBuffer(bool triple_buffer);
+
+   // Swap buffers like swapBuffer, tagging the frame just drawn. Returns its
+   // id, ids count up from 1
+   uint32_t present();
+
+   // Id of the newest frame shown and when it first appeared, 0 if none yet.
+   // Not from an interrupt that can cut in on the display on the same core
+   uint32_t getShownFrame(int64_t *shown_time);
+
+   // Presented frames that were replaced before they could be shown
+   uint32_t getDroppedFrames();
+
+   // Call back when a presented frame is first shown, NULL to stop
+   void setPresentCallback(pxmatrix_present_cb callback, void *arg);
    
-   // Control the minimum colour values that result in an active pixel
+   // Control the minimum colour values that result in an active pixel. With
+   // a shadow, the draw buffer is encoded again for them straight away and
+   // the others when swapBuffer or present hands them back for drawing
    void setColorOffset(uint8_t r, uint8_t g, uint8_t b);
 
    // Set the multiplex pattern
    void setMuxPattern(mux_patterns mux_pattern);
 
-   // Set the multiplex pattern
-   void setScanPattern(scan_patterns scan_pattern);
-
-private:
+   // Set the scan pattern. False, keeping the one before, when it doesn't
+   // fit the panel
+   bool setScanPattern(scan_patterns scan_pattern);
+
+   // Load the layout of a panel that none of the scan patterns describe, the
+   // table is copied and checked against the panel now or at begin, which
+   // fail when it doesn't fit
+   bool setScanTable(const pxmatrix_scan_table *table);
+
+   // Set how rows are pushed to the display (call before begin)
+   void setOutputMode(output_modes output_mode);
+
+   // Shift rows over four SPI lanes, each feeding a quarter of the panel
+   // shift chain (SPI_BLOCKING and SPI_PIPELINED only, call before begin)
+   void setQuadSpi(bool quad_spi);
+
+   // Set the WP and HD lane pins of quad SPI. begin falls back to one lane
+   // when any lane shares a pin with the latch, OE, address or power pin
+   // (call before begin)
+   void setQuadSpiPins(uint8_t WP, uint8_t HD);
+
+   // Set the pin switching the panel supply, only so nothing else drives it
+   // (call before begin)
+   void setPowerPin(uint8_t POWER);
+
+   // Time the OE pulses with the RMT peripheral, so rows are lit while the
+   // next one shifts instead of the CPU waiting (SPI_BLOCKING only, call before begin)
+   void setRmtOe(bool rmt_oe);
+
+   // Keep RGB565 frames and encode each row and plane just before it is sent,
+   // instead of keeping every plane encoded. Needs a fraction of the DMA
+   // memory for a little CPU per row (SPI_BLOCKING and SPI_PIPELINED only,
+   // call before begin)
+   void setStreaming(bool streaming);
+
+   // Keep an RGB565 copy of what is drawn into each encoded buffer, so
+   // getPixel can read it back and colour offset, depth and dither changes
+   // encode it again as it comes up for drawing. Streamed frames already are
+   // one (call before begin)
+   void setShadow(bool shadow);
+
+   // Stream from frames of 8 bit palette indices, a third of an RGB888 frame.
+   // Each entry's planes are worked out when it is set, so changing or
+   // rotating the palette recolours the frame without drawing it again. The
+   // palette starts as RGB332 and other colours drawn are matched to the
+   // nearest entry. Turns on streaming (call before begin)
+   void setIndexed(bool indexed);
+
+   // Keep buffers of threshold bytes or more in PSRAM when it has room, 0
+   // keeps everything internal. Encoded rows are copied into internal DMA
+   // memory as they are sent, SPI_DMA_CHAIN buffers always stay internal
+   // (call before begin)
+   void setPsramThreshold(uint32_t threshold);
+
+   // Allocate zeroed memory for frames or caches to draw from, in PSRAM when
+   // it is over the threshold. Counted in getMemoryUsage
+   void *allocFrame(size_t size);
+
+   // Set the colour data and clock pins used by I2S_PARALLEL (call before begin)
+   void setParallelPins(uint8_t R1, uint8_t G1, uint8_t B1, uint8_t R2, uint8_t G2, uint8_t B2, uint8_t CLK);
+
+   // Arrange the panels of the chain as a tiles_x by tiles_y canvas. The
+   // width given to the constructor is the whole chain, the height one panel
+   void setTileLayout(uint8_t tiles_x, uint8_t tiles_y, tile_layouts layout);
+
+   // Set how a tile is mounted, tiles are numbered left to right, top to bottom
+   void setTileRotation(uint8_t tile, tile_rotations rotation);
+
+   // Size of the drawing canvas, after tiling and rotation
+   uint16_t width();
+   uint16_t height();
+
+   // Draw into a canvas bigger than the panel and scroll the panel over it.
+   // Sizes are after rotation, 0 keeps the panel's. Turns on streaming
+   // (call before begin)
+   void setVirtualSize(uint16_t width, uint16_t height);
+
+   // Size of the canvas drawn into, the virtual size when one is set
+   uint16_t virtualWidth();
+   uint16_t virtualHeight();
+
+   // Show the virtual canvas from x, y, wrapping round its edges. Taken up at
+   // the start of the next colour cycle, so moving costs nothing but drawing
+   // what scrolls in. That goes into the buffer being drawn as usual, so
+   // double buffered it has to be drawn before each swap
+   void setViewport(int16_t x, int16_t y);
+
+   // Average time in microseconds to output one row during the last display()
+   uint32_t getRowTime();
+
+   // Memory held by the driver since begin
+   void getMemoryUsage(pxmatrix_memory *memory);
+
+   // Summarise one of the refresh timings, false if it has no samples yet
+   bool getTiming(pxmatrix_timings timing, pxmatrix_timing *summary);
+   void resetTimings();
+
+protected:
    // SPI Device
    spi_device_handle_t spi;
    spi_transaction_t _transactions[2];
+   uint8_t _transaction_row[2];
    EventGroupHandle_t xDisplayEventGroup;
 
-   uint8_t *buffer[2];
+   uint8_t *buffer[PXMATRIX_BUFFERS];
    uint8_t *flushBuffer;
 
    // GPIO Pins
@@ -106,45 +383,218 @@ private:
    uint8_t _C_PIN;
    uint8_t _D_PIN;
    uint8_t _E_PIN;
-   uint8_t _width;
-   uint8_t _height;
+   uint8_t _R1_PIN;
+   uint8_t _G1_PIN;
+   uint8_t _B1_PIN;
+   uint8_t _R2_PIN;
+   uint8_t _G2_PIN;
+   uint8_t _B2_PIN;
+   uint8_t _CLK_PIN;
+   uint8_t _WP_PIN;
+   uint8_t _HD_PIN;
+   uint8_t _POWER_PIN;
+   uint16_t _width;
+   uint16_t _height;
+
+   // Panel arrangement, _tile_rotation is NULL while the chain is one canvas row
+   uint16_t _canvas_width;
+   uint16_t _canvas_height;
+   uint8_t _tiles_x;
+   uint8_t _tiles_y;
+   tile_layouts _tile_layout;
+   tile_rotations *_tile_rotation;
    
    // Colour Offsets
    uint8_t _color_R_offset;
    uint8_t _color_G_offset;
    uint8_t _color_B_offset;
 
+   // Planes lit by each colour value and the plane rotation of each colour,
+   // always less than the colour depth
+   uint8_t _plane_lut[3][256];
+   uint8_t _plane_rotate[3];
+
    // Colour pattern that is pushed to the display
    uint8_t _display_color;
    
    // Holds the pre-computed vaues for faster pixel drawing
-   uint32_t _row_offset[64];
+   uint32_t *_row_offset;
+
+   // Red byte offset << 3 | bit for every pixel, in drawing coordinates.
+   // Left unfilled while map_needed says so, pixels are worked out instead
+   uint32_t *_pixel_map;
+   bool _pixel_map_filled;
+
+   // Whether 8 aligned pixels of a canvas row always share one byte
+   bool _byte_runs;
 
    // Holds the display row pattern type
    uint8_t _row_pattern;
 
    // Number of bytes in one colour
-   uint8_t _pattern_color_bytes;
+   uint16_t _pattern_color_bytes;
 
    // Total number of bytes that is pushed to the display at a time
    // 3 * _pattern_color_bytes
    uint16_t _send_buffer_size;
 
-   uint16_t _buffer_size;
+   uint32_t _buffer_size;
 
-   // This is for double buffering
-   bool _selected_buffer;
-   bool _active_buffer;
+   // This is for double buffering, the buffers being drawn and shown
+   uint8_t _draw_buffer;
+   volatile uint8_t _active_buffer;
+
+   // With triple buffering the third buffer sits in _frame_handoff between
+   // drawing and display, flagged once it holds a frame not shown yet
+   bool _triple_buffer;
+   volatile uint32_t _frame_handoff;
+
+   // Used by present, the frame id each buffer holds and the last one shown.
+   // _shown_seq is odd while the display updates the last two
+   uint32_t _next_frame_id;
+   uint32_t _buffer_frame[PXMATRIX_BUFFERS];
+   volatile uint32_t _shown_seq;
+   volatile uint32_t _shown_frame;
+   volatile int64_t _shown_time;
+   volatile uint32_t _dropped_frames;
+   pxmatrix_present_cb _present_cb;
+   void *_present_arg;
 
    // Hols configuration
    bool _rotate;
    bool _fast_update;
 
+   // Colour depth drawing encodes for, and the one asked for when fast update
+   // is off. display() cycles through the depth the buffer it shows was
+   // encoded for, streamed frames pick up _pending_depth between cycles
+   uint8_t _color_depth;
+   uint8_t _color_depth_setting;
+   volatile uint8_t _display_depth;
+   volatile uint8_t _buffer_depth[PXMATRIX_BUFFERS];
+   volatile uint8_t _pending_depth;
+
+   // Bumped whenever the plane tables or the dither phase change, and the
+   // value each buffer was last encoded in full with
+   uint32_t _plane_serial;
+   uint32_t _buffer_serial[PXMATRIX_BUFFERS];
+
+   // Used for dithering, the frame phase, the colour cycles display() counts
+   // and how many of them hand_over last saw, and the offset for each of the
+   // 16 dither levels at the current depth
+   bool _dither;
+   uint8_t _dither_frame;
+   volatile uint8_t _dither_cycle;
+   uint8_t _dither_seen;
+   int16_t _dither_offset[16];
+
    // Holds multiplex pattern
    mux_patterns _mux_pattern;
 
-   // Holds the scan pattern
+   // Holds the scan pattern, and the table it is compiled from
    scan_patterns _scan_pattern;
+   pxmatrix_scan_table _scan_table;
+
+   // Holds the colour modulation
+   color_modes _color_mode;
+
+   // Holds the output mode
+   output_modes _output_mode;
+
+   // Used for pipelined output. Rows are latched from the SPI interrupt, or
+   // from the timer once the row before has been shown for _pipe_ticks.
+   // Both notify _pipe_task, the task sending the plane
+   uint16_t _show_time;
+   uint32_t _pipe_ticks;
+   volatile bool _pipe_lit;
+   volatile int16_t _pipe_pending;
+   volatile uint8_t _pipe_latched;
+   TaskHandle_t _pipe_task;
+   portMUX_TYPE _pipe_lock;
+
+   // Used for row timing
+   uint32_t _row_time;
+
+   // Used for DMA chain output, one chain per buffer
+   lldesc_t *_dma_chain[PXMATRIX_BUFFERS];
+   size_t _dma_chain_size;
+   uint8_t *_dma_padding;
+   uint16_t _dma_hold_size[8];
+   uint16_t _dma_show_time;
+   intr_handle_t _dma_intr;
+   lldesc_t *_dma_desc;
+   lldesc_t *_dma_next;
+   uint8_t *_dma_actions;
+   uint16_t _dma_step;
+   volatile bool _dma_running;
+   volatile bool _dma_stop;
+   uint8_t _dma_row;
+
+   // Used for quad SPI output, one interleaved row per transaction slot
+   bool _quad_spi;
+   uint8_t *_qspi_rows;
+
+   // Used for streaming output, a frame per buffer, two rows being encoded
+   // or copied out of PSRAM and sent, and the canvas y << 16 | x of every
+   // bit of every row in send order
+   bool _streaming;
+   uint16_t *_frame[PXMATRIX_BUFFERS];
+   uint8_t *_stream_rows;
+   uint32_t *_stream_map;
+
+   // Used for encoded output, an RGB565 shadow of each buffer
+   bool _shadow;
+   uint16_t *_shadow_frame[PXMATRIX_BUFFERS];
+
+   // Used for scrolling, the size of the frames drawn into, 0 when they are
+   // the panel's, and the viewport as y << 16 | x, asked for and shown
+   uint16_t _virtual_width;
+   uint16_t _virtual_height;
+   uint32_t _viewport;
+   uint32_t _viewport_shown;
+   uint8_t _plane_lut565[3][64];
+
+   // Used for indexed streaming, a frame of indices per buffer, the palette
+   // as 0xRRGGBB and the red, green and blue plane masks of each entry in
+   // bytes 0, 1 and 2 so the display reads an entry in one load. Colours
+   // drawn as RGB are matched once and then found by a hash of the colour,
+   // UINT32_MAX marks a free slot
+   bool _indexed;
+   uint8_t *_index_frame[PXMATRIX_BUFFERS];
+   uint32_t _palette[256];
+   uint32_t _palette_planes[256];
+   uint32_t _palette_cache[PXMATRIX_PALETTE_CACHE];
+   uint8_t _palette_cache_index[PXMATRIX_PALETTE_CACHE];
+
+   // Memory allocated by begin
+   pxmatrix_memory _memory;
+
+   // Refresh timings in CPU cycles, and the cycle count the current colour
+   // cycle started at
+   pxmatrix_stats_t _timings[PXMATRIX_TIMINGS];
+   uint32_t _cycle_start;
+
+   // Size from which buffers go to PSRAM, and whether any encoded buffer has
+   // so rows have to bounce through _stream_rows
+   uint32_t _psram_threshold;
+   bool _bounce;
+
+   // Used for RMT timed OE pulses
+   bool _rmt_oe;
+   rmt_item32_t *_oe_items;
+
+   // Used for I2S parallel output, two copies of the samples and the chain
+   // so one can be packed while the DMA walks the other
+   uint16_t *_i2s_samples[2];
+   uint16_t _i2s_row_samples;
+   lldesc_t *_i2s_chain[2];
+   size_t _i2s_chain_size;
+   size_t _i2s_chain_used[2];
+   uint8_t _i2s_shown;
+   bool _i2s_swapping;
+   uint8_t _i2s_repeat[8];
+   uint16_t _i2s_hold_lit[8];
+   uint16_t *_i2s_hold;
+   uint16_t *_i2s_lanes;
 
    // Used for test pattern
    uint16_t _test_pixel_counter;
@@ -152,17 +602,190 @@ private:
    int64_t _test_last_call;
 
    // Generic function that draws one pixel
-   void fillMatrixBuffer(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, bool selected_buffer);
+   virtual void fillMatrixBuffer(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t buffer_idx);
+
+   // At the end of a colour cycle, switch to the buffer to show next
+   void next_frame();
+
+   // Hand the buffer drawn over to the display, tagged or not by present
+   void hand_over();
+
+   // Find the red byte offset and bit of a pixel, false if it is off the display
+   bool map_pixel(int16_t x, int16_t y, uint32_t *offset, uint8_t *bit);
+
+   // Work out a pixel map entry for a pixel on the display
+   uint32_t compute_pixel(int16_t x, int16_t y);
+
+   // Position of a panel pixel in the shift chain of its scan row, counted
+   // from the data input
+   uint32_t scan_position(int16_t x, int16_t y);
+
+   // Move a canvas pixel to its place in the chain
+   void map_tile(int16_t *x, int16_t *y);
+
+   // Describe the scan patterns as tables for the current row pattern
+   void build_scan_table();
+
+   // Check the scan table covers the panel and every scan row exactly
+   bool scan_table_fits();
+
+   // Switch scan pattern, or back to the one before when it doesn't fit
+   bool set_scan(scan_patterns scan_pattern, const pxmatrix_scan_table *table);
+
+   // Fill the pixel map for the current rotation and scan pattern. False,
+   // leaving it as it was, when the scan table doesn't fit the panel
+   bool build_pixel_map();
+
+   // Whether drawing goes through the pixel map, a subclass that works
+   // pixels out itself can do without
+   virtual bool map_needed();
+
+   // Write one pixel into every plane of buf at a mapped position
+   void encode_pixel(uint8_t *buf, uint32_t offset, uint8_t bit_select, uint8_t r, uint8_t g, uint8_t b);
+
+   // Dither count RGB pixels of one row starting at x, y in place
+   void dither_pixels(uint8_t *rgb, int16_t x, int16_t y, uint8_t count);
+
+   // Write 8 horizontally adjacent pixels sharing one byte with plain stores
+   void encode_group(uint8_t *buf, uint32_t offset, bool reverse, const uint8_t *rgb);
+
+   // Build the value to plane mask tables used by encode_group and streaming
+   void build_plane_lut();
+
+   // The byte each plane of each channel gets where a colour is drawn
+   void fill_pattern(uint8_t r, uint8_t g, uint8_t b, uint8_t pattern[3][PXMATRIX_COLOR_DEPTH]);
+
+   // Write the bits in mask of the red byte at offset, and the same bits of
+   // green and blue, in every plane
+   void fill_byte(uint8_t *buf, uint32_t offset, uint8_t mask, const uint8_t pattern[3][PXMATRIX_COLOR_DEPTH]);
+
+   // Encode a block of RGB565 pixels into buf, which is laid out like buffer
+   void encode_rect565(uint8_t *buf, int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride);
+
+   // Keep the shadow in step with a clipped block or pixel drawn to the
+   // draw buffer or buffer_idx
+   void shadow_rect565(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride);
+   void shadow_rect888(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride);
+   void shadow_pixel(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t buffer_idx);
+
+   // Encode the draw buffer again from its shadow after the plane tables
+   // changed, into the other buffer when double buffering shows it. The
+   // buffers shown are left to hand_over
+   void encode_draw_buffer();
+
+   // Work out the plane masks of count palette entries from first
+   void resolve_palette(uint8_t first, uint16_t count);
+
+   // The palette entry nearest to a colour, from the cache or searched for
+   uint8_t palette_index(uint8_t r, uint8_t g, uint8_t b);
+
+   // Forget the colours matched, after the palette changes
+   void clear_palette_cache();
+
+   // Encode one row of one plane of the active frame into out
+   void encode_stream_row(uint8_t plane, uint8_t row, uint8_t *out);
+
+   // Allocate and zero for begin, counting it in _memory
+   void *alloc_buffer(size_t count, size_t size, uint32_t caps);
+
+   // As alloc_buffer, in PSRAM when over the threshold
+   void *alloc_frame(size_t count, size_t size, uint32_t caps);
+
+   // Row of the active buffer to send from a transaction slot, encoded or
+   // copied into the slot's row of _stream_rows when it can't be sent directly
+   uint8_t *fill_row(uint8_t plane, uint8_t row, uint8_t slot);
+
+   // Whether the colour depth can change in the current output mode
+   bool depth_changeable();
+
+   // Switch to the colour depth selected by setColorDepth and setFastUpdate
+   void apply_color_depth();
+
+   // Clip a block to the display, skip_x / skip_y return how much of the source was cut off
+   bool clip_rect(int16_t *x, int16_t *y, int16_t *w, int16_t *h, int16_t *skip_x, int16_t *skip_y);
 
    // Init code common to both constructors
-   void init(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B);
+   void init(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B);
+
+   // Light up LEDs and hold for show_time_ns nanoseconds, with RMT timed OE
+   // this returns as soon as the pulse has started
+   void latch(uint32_t show_time_ns);
 
-   // Light up LEDs and hold for show_time microseconds
-   void latch(uint16_t show_time);
+   // Wait for the last RMT timed OE pulse to finish
+   void wait_oe();
 
    // Set row multiplexer
    void set_mux(uint8_t value);
 
+   // Latch a pipelined row and start the timer on its show time. Interrupts
+   // only, with _pipe_lock held
+   void latch_row(uint8_t row);
+
+   // Called by the SPI driver once a pipelined row has been shifted out
+   static void spi_post_cb(spi_transaction_t *trans);
+
+   // Ends the show time of the lit pipelined row
+   static void pipe_timer_isr(void *arg);
+
+   // Wakes the task sending the plane from either interrupt
+   void notify_pipe();
+
+   // Block until that many pipelined rows of the plane have been latched
+   void wait_pipe(uint8_t latched);
+
+   // Block until the last pipelined row has been shown
+   void wait_pipe_dark();
+
+   // Set up the timer that ends the show time of pipelined rows
+   void begin_pipe_timer();
+
+   // Whether a quad SPI lane shares a pin with the panel or its supply
+   bool quad_spi_collides();
+
+   // Set up the SPI bus and device for the spi_master based output modes
+   bool begin_spi();
+
+   // Hand the OE pin to an RMT channel for setRmtOe
+   bool begin_rmt();
+
+   // Set up the SPI peripheral, descriptor chains and interrupt for SPI_DMA_CHAIN
+   bool begin_dma_chain();
+
+   // Rebuild the descriptor chains for the current show time, only while the
+   // interrupt isn't walking them
+   void update_dma_chain();
+
+   // Let the interrupt finish the frame it is on and wait for it to stop
+   void stop_dma_chain();
+
+   // Start the transfer of the next segment of the chain
+   void dma_start_transfer();
+
+   // SPI transfer done interrupt for SPI_DMA_CHAIN
+   static void dma_isr(void *arg);
+
+   // Row data to send from a transaction slot, interleaved for quad SPI
+   const uint8_t *row_data(const uint8_t *row, uint8_t slot);
+
+   // Set up the pins, sample buffer, descriptor chain and I2S for I2S_PARALLEL
+   bool begin_i2s();
+
+   // Work out the I2S lane of every bit of a row from the scan table, false
+   // if it doesn't split the panel in two halves
+   bool map_i2s_lanes();
+
+   // Samples a row of plane is lit for by one I2S block
+   uint32_t i2s_lit(uint8_t plane, uint16_t show_time);
+
+   // Pack one row of one plane of the active buffer into the idle I2S copy
+   void pack_i2s_row(uint8_t plane, uint8_t row, uint16_t show_time);
+
+   // Chain the idle I2S copy in after the frame the DMA is on
+   void swap_i2s_chain();
+
+   // Wait until the DMA has moved on to the copy swapped in
+   void wait_i2s_swap();
+
 };
 
 #endif //__cplusplus
@@ -173,31 +796,103 @@ extern "C" {
 
 typedef struct pxmatrix pxmatrix;
 
-extern pxmatrix* Create_PxMatrix(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B);
-extern pxmatrix* Create_PxMatrix3(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C);
-extern pxmatrix* Create_PxMatrix4(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D);
-extern pxmatrix* Create_PxMatrix5(uint8_t width, uint8_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E);
+extern pxmatrix* Create_PxMatrix(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B);
+extern pxmatrix* Create_PxMatrix3(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C);
+extern pxmatrix* Create_PxMatrix4(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D);
+extern pxmatrix* Create_PxMatrix5(uint16_t width, uint16_t height, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E);
+
+// Uses a compile time specialised driver when one exists for the geometry
+// and scan pattern. A CUSTOM table still has to be loaded with setScanTable
+extern pxmatrix* Create_PxMatrixFixed(uint16_t width, uint16_t height, uint8_t row_pattern, enum scan_patterns scan_pattern, uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E);
 
-extern void pxmatrix_begin(pxmatrix *matrix, uint8_t steps);
+extern bool pxmatrix_begin(pxmatrix *matrix, uint8_t steps);
+extern bool pxmatrix_beginColorMode(pxmatrix *matrix, uint8_t steps, enum color_modes color_mode);
 extern void pxmatrix_clearDisplay(pxmatrix *matrix);
 extern void pxmatrix_display(pxmatrix *matrix, uint16_t show_time);
+extern void pxmatrix_displayNs(pxmatrix *matrix, uint32_t show_time_ns);
 
 extern void pxmatrix_drawPixelRGB565(pxmatrix *matrix, int16_t x, int16_t y, uint16_t color);
 extern void pxmatrix_drawPixel(pxmatrix *matrix, int16_t x, int16_t y, uint16_t color);
 extern void pxmatrix_drawPixelRGB888(pxmatrix *matrix, int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b);
 
+extern void pxmatrix_drawFrameRGB565(pxmatrix *matrix, const uint16_t *data, uint16_t stride);
+extern void pxmatrix_drawFrameRGB888(pxmatrix *matrix, const uint8_t *data, uint16_t stride);
+extern void pxmatrix_drawRectRGB565(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride);
+extern void pxmatrix_drawRectRGB888(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride);
+
+extern void pxmatrix_fillRect(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, uint8_t r, uint8_t g, uint8_t b);
+extern void pxmatrix_fillScreen(pxmatrix *matrix, uint8_t r, uint8_t g, uint8_t b);
+
+extern void pxmatrix_drawPixelIndexed(pxmatrix *matrix, int16_t x, int16_t y, uint8_t index);
+extern void pxmatrix_drawFrameIndexed(pxmatrix *matrix, const uint8_t *data, uint16_t stride);
+extern void pxmatrix_drawRectIndexed(pxmatrix *matrix, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride);
+
+extern void pxmatrix_setPaletteColor(pxmatrix *matrix, uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+extern void pxmatrix_setPalette(pxmatrix *matrix, const uint8_t *rgb, uint8_t first, uint16_t count);
+extern void pxmatrix_rotatePalette(pxmatrix *matrix, uint8_t first, uint16_t count, int16_t steps);
+
 extern uint16_t pxmatrix_color565(pxmatrix *matrix, uint8_t r, uint8_t g, uint8_t b);
 
+extern bool pxmatrix_readPixel(pxmatrix *matrix, int16_t x, int16_t y, uint8_t *r, uint8_t *g, uint8_t *b);
+
 extern void pxmatrix_displayTestPattern(pxmatrix *matrix, uint16_t show_time);
 
 extern void pxmatrix_displayTestPixel(pxmatrix *matrix, uint16_t show_time);
 
 extern void pxmatrix_setFastUpdate(pxmatrix *matrix, bool fast_update);
 
+extern bool pxmatrix_setColorDepth(pxmatrix *matrix, uint8_t color_depth);
+extern uint8_t pxmatrix_getColorDepth(pxmatrix *matrix);
+
+extern void pxmatrix_setDither(pxmatrix *matrix, bool dither);
+
+extern bool pxmatrix_setScanPattern(pxmatrix *matrix, enum scan_patterns scan_pattern);
+extern bool pxmatrix_setScanTable(pxmatrix *matrix, const struct pxmatrix_scan_table *table);
+
+extern void pxmatrix_setTileLayout(pxmatrix *matrix, uint8_t tiles_x, uint8_t tiles_y, enum tile_layouts layout);
+extern void pxmatrix_setTileRotation(pxmatrix *matrix, uint8_t tile, enum tile_rotations rotation);
+
 extern void pxmatrix_selectBuffer(pxmatrix *matrix, bool selected_buffer);
 
 extern void pxmatrix_swapBuffer(pxmatrix *matrix);
 
+extern void pxmatrix_setTripleBuffer(pxmatrix *matrix, bool triple_buffer);
+
+extern uint32_t pxmatrix_present(pxmatrix *matrix);
+extern uint32_t pxmatrix_getShownFrame(pxmatrix *matrix, int64_t *shown_time);
+extern uint32_t pxmatrix_getDroppedFrames(pxmatrix *matrix);
+extern void pxmatrix_setPresentCallback(pxmatrix *matrix, pxmatrix_present_cb callback, void *arg);
+
+extern void pxmatrix_setOutputMode(pxmatrix *matrix, enum output_modes output_mode);
+
+extern void pxmatrix_setQuadSpi(pxmatrix *matrix, bool quad_spi);
+
+extern void pxmatrix_setQuadSpiPins(pxmatrix *matrix, uint8_t WP, uint8_t HD);
+extern void pxmatrix_setPowerPin(pxmatrix *matrix, uint8_t POWER);
+extern void pxmatrix_setRmtOe(pxmatrix *matrix, bool rmt_oe);
+
+extern void pxmatrix_setStreaming(pxmatrix *matrix, bool streaming);
+extern void pxmatrix_setIndexed(pxmatrix *matrix, bool indexed);
+extern void pxmatrix_setShadow(pxmatrix *matrix, bool shadow);
+extern uint16_t pxmatrix_getPixel(pxmatrix *matrix, int16_t x, int16_t y);
+
+extern void pxmatrix_setVirtualSize(pxmatrix *matrix, uint16_t width, uint16_t height);
+extern uint16_t pxmatrix_virtualWidth(pxmatrix *matrix);
+extern uint16_t pxmatrix_virtualHeight(pxmatrix *matrix);
+extern void pxmatrix_setViewport(pxmatrix *matrix, int16_t x, int16_t y);
+
+extern void pxmatrix_setPsramThreshold(pxmatrix *matrix, uint32_t threshold);
+extern void *pxmatrix_allocFrame(pxmatrix *matrix, size_t size);
+
+extern void pxmatrix_setParallelPins(pxmatrix *matrix, uint8_t R1, uint8_t G1, uint8_t B1, uint8_t R2, uint8_t G2, uint8_t B2, uint8_t CLK);
+
+extern uint32_t pxmatrix_getRowTime(pxmatrix *matrix);
+
+extern void pxmatrix_getMemoryUsage(pxmatrix *matrix, struct pxmatrix_memory *memory);
+
+extern bool pxmatrix_getTiming(pxmatrix *matrix, enum pxmatrix_timings timing, struct pxmatrix_timing *summary);
+extern void pxmatrix_resetTimings(pxmatrix *matrix);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,132 @@
+/****************************************************************
+ * DMA descriptor chain helpers for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <string.h>
+#include "PxMatrixDma.h"
+
+size_t pxmatrix_dma_add_segment(lldesc_t *chain, size_t count, size_t max_desc,
+                                const uint8_t *data, uint16_t data_size, uint32_t size,
+                                bool repeat)
+{
+   size_t used = 0;
+
+   while (size > 0)
+   {
+      uint16_t chunk = (size > data_size) ? data_size : size;
+      if (chunk > PXMATRIX_DMA_MAX_DESC_SIZE)
+         chunk = PXMATRIX_DMA_MAX_DESC_SIZE;
+
+      if (count + used >= max_desc)
+         return 0;
+
+      lldesc_t *desc = &chain[count + used];
+      memset(desc, 0, sizeof(lldesc_t));
+      desc->size = (chunk + 3) & ~3;
+      desc->length = chunk;
+      desc->owner = 1;
+      desc->buf = (uint8_t *)data;
+
+      // Link to the next one, the caller fixes up the very last link
+      desc->qe.stqe_next = &chain[count + used + 1];
+
+      size -= chunk;
+      if (!repeat)
+         data += chunk;
+      used++;
+   }
+
+   chain[count + used - 1].eof = 1;
+   return used;
+}
+
+// One segment of size - row_size bytes of padding if size is longer than the
+// row, followed by the row so that is what the panel has when it ends
+static size_t add_row(lldesc_t *chain, size_t count, size_t max_desc,
+                      const uint8_t *row_data, uint16_t row_size, uint32_t size,
+                      const uint8_t *padding, uint16_t padding_size)
+{
+   size_t held = 0;
+
+   if (size > row_size)
+   {
+      held = pxmatrix_dma_add_segment(chain, count, max_desc, padding, padding_size, size - row_size, true);
+      if (0 == held)
+         return 0;
+      chain[count + held - 1].eof = 0;
+   }
+
+   size_t used = pxmatrix_dma_add_segment(chain, count + held, max_desc, row_data, row_size, row_size, false);
+   return (0 == used) ? 0 : held + used;
+}
+
+size_t pxmatrix_build_dma_chain(lldesc_t *chain, size_t max_desc,
+                                uint8_t *actions, size_t max_actions,
+                                const uint8_t *buffer, uint32_t plane_size,
+                                uint16_t row_size, uint8_t rows, uint8_t planes,
+                                const uint8_t *padding, uint16_t padding_size,
+                                const uint16_t *hold_size)
+{
+   uint32_t total = (uint32_t)rows * planes;
+   size_t count = 0;
+   size_t segments = 0;
+   size_t used;
+
+   if ((0 == total) || (max_actions < (size_t)PXMATRIX_DMA_SEGMENTS(rows, planes)))
+      return 0;
+
+   // Row 0 of plane 0 goes in with nothing lit
+   used = pxmatrix_dma_add_segment(chain, count, max_desc, buffer, row_size, row_size, false);
+   if (0 == used)
+      return 0;
+   count += used;
+   actions[segments++] = PXMATRIX_DMA_LATCH | ((0 != hold_size[0]) ? PXMATRIX_DMA_LIGHT : 0);
+
+   // Every other row shifts in while the one before it is lit
+   for (uint32_t idx = 1; idx < total; idx++)
+   {
+      uint8_t plane = idx / rows;
+      uint16_t hold = hold_size[(idx - 1) / rows];
+      const uint8_t *row_data = buffer + (plane * plane_size) + ((idx % rows) * row_size);
+      uint8_t latch = PXMATRIX_DMA_LATCH | ((0 != hold_size[plane]) ? PXMATRIX_DMA_LIGHT : 0);
+
+      // Split where the hold ends, on a word so the rest starts aligned
+      uint16_t split = hold & ~3;
+      if (split < 4)
+         split = 4;
+
+      if ((0 != hold) && (split < row_size))
+      {
+         used = pxmatrix_dma_add_segment(chain, count, max_desc, row_data, split, split, false);
+         if (0 == used)
+            return 0;
+         count += used;
+         actions[segments++] = PXMATRIX_DMA_BLANK;
+
+         used = pxmatrix_dma_add_segment(chain, count, max_desc, row_data + split, row_size - split, row_size - split, false);
+      }
+      else
+      {
+         used = add_row(chain, count, max_desc, row_data, row_size, hold, padding, padding_size);
+      }
+      if (0 == used)
+         return 0;
+      count += used;
+      actions[segments++] = latch;
+   }
+
+   // The last row is held by padding alone, then the frame is over
+   uint16_t hold = hold_size[planes - 1];
+   used = pxmatrix_dma_add_segment(chain, count, max_desc, padding, padding_size, (hold < 4) ? 4 : hold, true);
+   if (0 == used)
+      return 0;
+   count += used;
+   actions[segments++] = PXMATRIX_DMA_BLANK | PXMATRIX_DMA_FRAME;
+
+   // Close the loop so the chain can be walked forever
+   chain[count - 1].qe.stqe_next = &chain[0];
+   return count;
+}
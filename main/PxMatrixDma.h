@@ -0,0 +1,64 @@
+/****************************************************************
+ * DMA descriptor chain helpers for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_DMA_H__
+#define PXMATRIX_DMA_H__
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp32/rom/lldesc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest number of bytes a single DMA descriptor can carry
+#define PXMATRIX_DMA_MAX_DESC_SIZE 4092
+
+// Number of descriptors needed to carry size bytes in chunks of chunk_size
+#define PXMATRIX_DMA_DESC_COUNT(size, chunk_size) (((size) + (chunk_size) - 1) / (chunk_size))
+
+// Appends one segment of size bytes taken from data to the chain at index
+// count. If repeat is set the same data_size bytes are sent over and over,
+// otherwise the data is walked. The last descriptor has eof set and every
+// descriptor links to the next slot. Returns the number of descriptors
+// written, or 0 if max_desc is too small.
+size_t pxmatrix_dma_add_segment(lldesc_t *chain, size_t count, size_t max_desc,
+                                const uint8_t *data, uint16_t data_size, uint32_t size,
+                                bool repeat);
+
+// What the SPI interrupt does at the end of a segment. LATCH turns OE off,
+// selects the next row and latches it, LIGHT then turns OE on for it. BLANK
+// only turns OE off. FRAME ends the frame, the first segment of a chain
+// shifts row 0 of plane 0 in the dark
+#define PXMATRIX_DMA_BLANK 1
+#define PXMATRIX_DMA_LATCH 2
+#define PXMATRIX_DMA_LIGHT 4
+#define PXMATRIX_DMA_FRAME 8
+
+// Segments a chain of rows rows and planes planes can take, for the actions
+#define PXMATRIX_DMA_SEGMENTS(rows, planes) ((2 * (rows) * (planes)) + 2)
+
+// Builds one circular descriptor chain covering every row of every plane of an
+// encoded buffer. A row is lit for hold_size[plane] bytes, while zeroed
+// padding from padding and then the next row shift in. A hold shorter than a
+// row is blanked partway through the shift. Every segment ends
+// with eof set so it is one transfer, and actions gets what the interrupt
+// does after each. Returns the number of descriptors used, or 0 if max_desc
+// or max_actions is too small.
+size_t pxmatrix_build_dma_chain(lldesc_t *chain, size_t max_desc,
+                                uint8_t *actions, size_t max_actions,
+                                const uint8_t *buffer, uint32_t plane_size,
+                                uint16_t row_size, uint8_t rows, uint8_t planes,
+                                const uint8_t *padding, uint16_t padding_size,
+                                const uint16_t *hold_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //PXMATRIX_DMA_H__
@@ -0,0 +1,182 @@
+/****************************************************************
+ * I2S parallel output helpers for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include "PxMatrixI2s.h"
+#include "PxMatrixDma.h"
+
+#define _BV(x) (1 << (x))
+
+bool pxmatrix_i2s_map_lanes(uint16_t *lanes, const uint8_t *upper, uint16_t color_bytes)
+{
+   uint16_t count = PXMATRIX_I2S_ROW_SAMPLES(color_bytes);
+   uint16_t top = 0;
+   uint16_t bottom = 0;
+
+   for (uint16_t bit = 0; bit < color_bytes * 8; bit++)
+   {
+      if (upper[bit])
+      {
+         if (top >= count)
+            return false;
+         lanes[2 * top++] = bit;
+      }
+      else
+      {
+         if (bottom >= count)
+            return false;
+         lanes[(2 * bottom++) + 1] = bit;
+      }
+   }
+   return true;
+}
+
+void pxmatrix_i2s_pack_row(uint16_t *samples, const uint8_t *row, uint16_t color_bytes,
+                           const uint16_t *lanes, uint8_t address, uint16_t lit)
+{
+   uint16_t count = PXMATRIX_I2S_ROW_SAMPLES(color_bytes);
+   const uint8_t *b = row;
+   const uint8_t *g = b + color_bytes;
+   const uint8_t *r = g + color_bytes;
+
+   // Keep OE off while the address changes and while latching
+   if (lit > PXMATRIX_I2S_SHIFT_LIT(count))
+      lit = PXMATRIX_I2S_SHIFT_LIT(count);
+
+   for (uint16_t k = 0; k < count; k++)
+   {
+      uint16_t top = lanes[2 * k];
+      uint16_t bottom = lanes[(2 * k) + 1];
+      uint8_t top_mask = 0x80 >> (top & 7);
+      uint8_t bottom_mask = 0x80 >> (bottom & 7);
+      uint16_t sample = (uint16_t)address << PXMATRIX_I2S_BIT_A;
+
+      top >>= 3;
+      bottom >>= 3;
+      if (r[top] & top_mask)
+         sample |= _BV(PXMATRIX_I2S_BIT_R1);
+      if (g[top] & top_mask)
+         sample |= _BV(PXMATRIX_I2S_BIT_G1);
+      if (b[top] & top_mask)
+         sample |= _BV(PXMATRIX_I2S_BIT_B1);
+      if (r[bottom] & bottom_mask)
+         sample |= _BV(PXMATRIX_I2S_BIT_R2);
+      if (g[bottom] & bottom_mask)
+         sample |= _BV(PXMATRIX_I2S_BIT_G2);
+      if (b[bottom] & bottom_mask)
+         sample |= _BV(PXMATRIX_I2S_BIT_B2);
+
+      if ((0 == k) || (k > lit))
+         sample |= _BV(PXMATRIX_I2S_BIT_OE);
+
+      if (count - 1 == k)
+         sample |= _BV(PXMATRIX_I2S_BIT_LAT);
+
+      samples[k ^ 1] = sample;
+   }
+}
+
+void pxmatrix_i2s_pack_hold(uint16_t *samples, uint8_t address)
+{
+   for (uint16_t k = 0; k < PXMATRIX_I2S_HOLD_SAMPLES; k++)
+   {
+      uint16_t sample = (uint16_t)address << PXMATRIX_I2S_BIT_A;
+      if (0 == k)
+         sample |= _BV(PXMATRIX_I2S_BIT_OE);
+      samples[k ^ 1] = sample;
+   }
+}
+
+// Samples the next hold descriptor takes to light lit more, whole words
+static uint16_t hold_samples(uint16_t lit)
+{
+   if (lit >= PXMATRIX_I2S_HOLD_SAMPLES - 1)
+      return PXMATRIX_I2S_HOLD_SAMPLES;
+   return (lit + 2) & ~1;
+}
+
+uint16_t pxmatrix_i2s_hold_lit(uint16_t lit)
+{
+   uint16_t held = 0;
+
+   if (lit > PXMATRIX_I2S_HOLD_LIT)
+      lit = PXMATRIX_I2S_HOLD_LIT;
+
+   while (lit > 0)
+   {
+      uint16_t samples = hold_samples(lit);
+      held += samples - 1;
+      lit -= (samples - 1 > lit) ? lit : samples - 1;
+   }
+   return held;
+}
+
+// Appends the hold descriptors of pxmatrix_i2s_hold_lit
+static size_t add_hold(lldesc_t *chain, size_t count, size_t max_desc, const uint16_t *hold, uint16_t lit)
+{
+   size_t used = 0;
+
+   if (lit > PXMATRIX_I2S_HOLD_LIT)
+      lit = PXMATRIX_I2S_HOLD_LIT;
+
+   while (lit > 0)
+   {
+      uint16_t samples = hold_samples(lit);
+      uint16_t size = samples * sizeof(uint16_t);
+
+      if (0 == pxmatrix_dma_add_segment(chain, count + used, max_desc, (const uint8_t *)hold, size, size, false))
+         return 0;
+      used++;
+      lit -= (samples - 1 > lit) ? lit : samples - 1;
+   }
+   return used;
+}
+
+size_t pxmatrix_build_i2s_chain(lldesc_t *chain, size_t max_desc,
+                                const uint16_t *samples, uint16_t row_samples,
+                                uint8_t rows, uint8_t planes, const uint8_t *repeat,
+                                const uint16_t *hold, const uint16_t *hold_lit)
+{
+   uint16_t block_size = row_samples * sizeof(uint16_t);
+   size_t count = 0;
+
+   for (uint8_t plane = 0; plane < planes; plane++)
+   {
+      for (uint8_t row = 0; row < rows; row++)
+      {
+         const uint8_t *block = (const uint8_t *)(samples + ((plane * rows) + row) * 2 * row_samples);
+         uint8_t previous = (row + rows - 1) % rows;
+
+         for (uint8_t idx = 0; idx < repeat[plane]; idx++)
+         {
+            // The hold lights the row latched before, with the block's address
+            uint8_t address = (0 == idx) ? previous : row;
+            uint8_t shown = ((0 == idx) && (0 == row)) ? (plane + planes - 1) % planes : plane;
+            const uint8_t *data = (0 == idx) ? block : block + block_size;
+            size_t used = 0;
+
+            if (0 != hold_lit[shown])
+            {
+               used = add_hold(chain, count, max_desc, hold + (address * PXMATRIX_I2S_HOLD_SAMPLES), hold_lit[shown]);
+               if (0 == used)
+                  return 0;
+               count += used;
+            }
+
+            used = pxmatrix_dma_add_segment(chain, count, max_desc, data, block_size, block_size, false);
+            if (0 == used)
+               return 0;
+            count += used;
+         }
+      }
+   }
+
+   if (0 == count)
+      return 0;
+
+   chain[count - 1].qe.stqe_next = &chain[0];
+   return count;
+}
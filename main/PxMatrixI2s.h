@@ -0,0 +1,91 @@
+/****************************************************************
+ * I2S parallel output helpers for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_I2S_H__
+#define PXMATRIX_I2S_H__
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp32/rom/lldesc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bit positions of the panel signals within one 16 bit parallel sample
+#define PXMATRIX_I2S_BIT_R1   0
+#define PXMATRIX_I2S_BIT_G1   1
+#define PXMATRIX_I2S_BIT_B1   2
+#define PXMATRIX_I2S_BIT_R2   3
+#define PXMATRIX_I2S_BIT_G2   4
+#define PXMATRIX_I2S_BIT_B2   5
+#define PXMATRIX_I2S_BIT_A    6
+#define PXMATRIX_I2S_BIT_LAT  11
+#define PXMATRIX_I2S_BIT_OE   12
+#define PXMATRIX_I2S_BITS     13
+
+// Number of samples needed to shift one row of color_bytes per colour
+#define PXMATRIX_I2S_ROW_SAMPLES(color_bytes) ((color_bytes) * 4)
+
+// Longest time a block can be lit while it shifts, the first and last
+// samples keep OE off for the address change and the latch
+#define PXMATRIX_I2S_SHIFT_LIT(row_samples) ((row_samples) - 2)
+
+// Samples in the hold buffer of every address, and hold descriptors at most
+// after a block. Each hold descriptor lights all but its first sample
+#define PXMATRIX_I2S_HOLD_SAMPLES 256
+#define PXMATRIX_I2S_HOLD_DESC 2
+#define PXMATRIX_I2S_HOLD_LIT (PXMATRIX_I2S_HOLD_DESC * (PXMATRIX_I2S_HOLD_SAMPLES - 1))
+
+// Works out which clock of which lane carries every bit of a colour section
+// of color_bytes. upper[n] is set when bit n, counted in the order serial
+// output sends it, is in the top half of the panel. The top half goes to
+// the R1, G1 and B1 lane and the bottom half to R2, G2 and B2, each in the
+// order serial output sends it. lanes receives, for every clock, the bit
+// of the top half then the bit of the bottom half. Returns false unless
+// exactly half the bits are in the top half.
+bool pxmatrix_i2s_map_lanes(uint16_t *lanes, const uint8_t *upper, uint16_t color_bytes);
+
+// Packs one encoded row into parallel samples. row points at the B, G and R
+// sections of color_bytes each, laid out as for serial output, lanes is the
+// map from pxmatrix_i2s_map_lanes. Every sample carries the address of the
+// row currently latched, OE is active for samples 1 to lit, at most
+// PXMATRIX_I2S_SHIFT_LIT, and LAT is raised on the last sample. The I2S
+// outputs the two 16 bit halves of each 32 bit word swapped, so samples are
+// stored pairwise swapped.
+void pxmatrix_i2s_pack_row(uint16_t *samples, const uint8_t *row, uint16_t color_bytes,
+                           const uint16_t *lanes, uint8_t address, uint16_t lit);
+
+// Samples hold descriptors light to hold a row lit for lit samples more,
+// at most PXMATRIX_I2S_HOLD_LIT. A descriptor lights an odd number of
+// samples, so this can be one more than lit
+uint16_t pxmatrix_i2s_hold_lit(uint16_t lit);
+
+// Fills the PXMATRIX_I2S_HOLD_SAMPLES samples that keep the row latched with
+// address lit. OE is off for the first sample, while the address settles
+void pxmatrix_i2s_pack_hold(uint16_t *samples, uint8_t address);
+
+// Builds the circular descriptor chain for a sample buffer laid out as, for
+// every plane and row, a block with the previous row address followed by a
+// block with the row's own address. Each row of plane n is sent once with
+// the first block and then repeat[n] - 1 times with the second. Every block
+// is preceded by hold descriptors from the hold buffer of its address,
+// taken from hold at PXMATRIX_I2S_HOLD_SAMPLES per address. They hold the
+// row latched before lit for hold_lit[n] samples more, where n is the plane
+// of that row, so the last row of a plane before the first block of the
+// next. Returns the number of descriptors used, or 0 if max_desc is too
+// small.
+size_t pxmatrix_build_i2s_chain(lldesc_t *chain, size_t max_desc,
+                                const uint16_t *samples, uint16_t row_samples,
+                                uint8_t rows, uint8_t planes, const uint8_t *repeat,
+                                const uint16_t *hold, const uint16_t *hold_lit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //PXMATRIX_I2S_H__
@@ -0,0 +1,54 @@
+/****************************************************************
+ * RMT driven OE pulse helpers for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <string.h>
+#include "PxMatrixOe.h"
+
+size_t pxmatrix_oe_pulse(rmt_item32_t *items, size_t max_items, uint32_t show_time_ns)
+{
+   uint32_t ticks = (show_time_ns + (PXMATRIX_OE_TICK_NS / 2)) / PXMATRIX_OE_TICK_NS;
+   if (0 == ticks)
+      return 0;
+
+   // Every half item holds a stretch of the pulse, a zero length half ends it
+   size_t halves = ((ticks + PXMATRIX_OE_MAX_TICKS - 1) / PXMATRIX_OE_MAX_TICKS) + 1;
+   size_t count = (halves + 1) / 2;
+   if (count > max_items)
+      return 0;
+
+   memset(items, 0, count * sizeof(rmt_item32_t));
+   for (size_t half = 0; ticks > 0; half++)
+   {
+      uint32_t duration = (ticks > PXMATRIX_OE_MAX_TICKS) ? PXMATRIX_OE_MAX_TICKS : ticks;
+      ticks -= duration;
+
+      if (half & 1)
+         items[half / 2].duration1 = duration;
+      else
+         items[half / 2].duration0 = duration;
+   }
+
+   return count;
+}
+
+uint32_t pxmatrix_oe_pulse_ns(const rmt_item32_t *items, size_t count)
+{
+   uint32_t ticks = 0;
+
+   for (size_t item = 0; item < count; item++)
+   {
+      if ((0 == items[item].duration0) || (0 != items[item].level0))
+         break;
+      ticks += items[item].duration0;
+
+      if ((0 == items[item].duration1) || (0 != items[item].level1))
+         break;
+      ticks += items[item].duration1;
+   }
+
+   return ticks * PXMATRIX_OE_TICK_NS;
+}
@@ -0,0 +1,41 @@
+/****************************************************************
+ * RMT driven OE pulse helpers for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_OE_H__
+#define PXMATRIX_OE_H__
+#include <inttypes.h>
+#include <stddef.h>
+#include "soc/rmt_struct.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RMT clock divider for OE pulses, 80 MHz APB / 4 gives 50 ns ticks
+#define PXMATRIX_OE_CLK_DIV 4
+#define PXMATRIX_OE_TICK_NS 50
+
+// Longest duration one half of an RMT item can hold
+#define PXMATRIX_OE_MAX_TICKS 32767
+
+// Items in one RMT memory block, the longest pulse that fits is about 200 ms
+#define PXMATRIX_OE_MAX_ITEMS 64
+
+// Fills items with one active low OE pulse of show_time_ns, rounded to the
+// nearest tick and followed by the end marker. The line returns to its idle
+// level when the pulse ends. Returns the number of items written, or 0 if the
+// pulse is shorter than a tick or doesn't fit in max_items.
+size_t pxmatrix_oe_pulse(rmt_item32_t *items, size_t max_items, uint32_t show_time_ns);
+
+// Time in nanoseconds that OE is held low by the items, up to the end marker
+uint32_t pxmatrix_oe_pulse_ns(const rmt_item32_t *items, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //PXMATRIX_OE_H__
@@ -0,0 +1,34 @@
+/****************************************************************
+ * Quad SPI lane interleaving for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include "PxMatrixQspi.h"
+
+void pxmatrix_qspi_interleave(uint8_t *out, const uint8_t *row, uint16_t row_size)
+{
+   uint16_t quarter = row_size / PXMATRIX_QSPI_LANES;
+
+   for (uint16_t idx = 0; idx < quarter; idx++)
+   {
+      uint8_t lane0 = row[idx];
+      uint8_t lane1 = row[quarter + idx];
+      uint8_t lane2 = row[(2 * quarter) + idx];
+      uint8_t lane3 = row[(3 * quarter) + idx];
+
+      // Every byte sent carries two clocks, the high nibble goes first and
+      // nibble bit n is lane n
+      for (uint8_t bit = 0; bit < 8; bit += 2)
+      {
+         uint8_t hi = 7 - bit;
+         uint8_t lo = 6 - bit;
+
+         *out++ = (((lane0 >> hi) & 1) << 4) | (((lane1 >> hi) & 1) << 5) |
+                  (((lane2 >> hi) & 1) << 6) | (((lane3 >> hi) & 1) << 7) |
+                  ((lane0 >> lo) & 1) | (((lane1 >> lo) & 1) << 1) |
+                  (((lane2 >> lo) & 1) << 2) | (((lane3 >> lo) & 1) << 3);
+      }
+   }
+}
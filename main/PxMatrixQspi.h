@@ -0,0 +1,30 @@
+/****************************************************************
+ * Quad SPI lane interleaving for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_QSPI_H__
+#define PXMATRIX_QSPI_H__
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of data lanes used by quad SPI output
+#define PXMATRIX_QSPI_LANES 4
+
+// Spreads one single lane row over the four quad SPI lanes. The row is split
+// into four equal quarters and lane n (D, Q, WP, HD) shifts out quarter n MSB
+// first, so each lane feeds a quarter of the panel shift chain with exactly
+// the bits it would have seen from one lane. row_size must be a multiple of
+// four, out receives row_size bytes in the order the SPI sends them.
+void pxmatrix_qspi_interleave(uint8_t *out, const uint8_t *row, uint16_t row_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+/****************************************************************
+ * Refresh timing statistics for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <string.h>
+#include "PxMatrixStats.h"
+
+void pxmatrix_stats_reset(pxmatrix_stats_t *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+}
+
+uint32_t pxmatrix_stats_percentile(const pxmatrix_stats_t *stats, uint8_t percent)
+{
+   if (0 == stats->count)
+      return 0;
+
+   // Rank of the sample wanted, rounded up so 100% is the last one
+   uint64_t rank = ((uint64_t)stats->count * percent + 99) / 100;
+   if (0 == rank)
+      rank = 1;
+
+   uint64_t seen = 0;
+   uint8_t bucket = 0;
+   for (; bucket < PXMATRIX_STATS_BUCKETS - 1; bucket++)
+   {
+      seen += stats->buckets[bucket];
+      if (seen >= rank)
+         break;
+   }
+
+   uint64_t value = bucket;
+   if (bucket >= 8)
+   {
+      uint8_t shift = (bucket >> 2) - 1;
+      uint64_t low = (uint64_t)(4 | (bucket & 3)) << shift;
+      value = low + ((1ULL << shift) >> 1);
+   }
+
+   if (value < stats->min)
+      value = stats->min;
+   if (value > stats->max)
+      value = stats->max;
+   return value;
+}
@@ -0,0 +1,62 @@
+/****************************************************************
+ * Refresh timing statistics for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_STATS_H__
+#define PXMATRIX_STATS_H__
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Values below 8 get a bucket each, above that every power of two is split
+// into 4 buckets, so a percentile is within 25% of the true value
+#define PXMATRIX_STATS_BUCKETS 128
+
+// Samples of one measurement, in CPU cycles
+typedef struct {
+   uint32_t count;
+   uint32_t min;
+   uint32_t max;
+   uint64_t total;
+   uint32_t buckets[PXMATRIX_STATS_BUCKETS];
+} pxmatrix_stats_t;
+
+// Bucket holding value
+static inline __attribute__((always_inline)) uint8_t pxmatrix_stats_bucket(uint32_t value)
+{
+   if (value < 8)
+      return value;
+
+   uint8_t msb = 31 - __builtin_clz(value);
+   return ((msb - 1) << 2) | ((value >> (msb - 2)) & 3);
+}
+
+// Adds one sample, cheap enough to call for every row. Always inlined, so it
+// runs from IRAM in the interrupts that latch rows
+static inline __attribute__((always_inline)) void pxmatrix_stats_add(pxmatrix_stats_t *stats, uint32_t value)
+{
+   if (0 == stats->count || value < stats->min)
+      stats->min = value;
+   if (value > stats->max)
+      stats->max = value;
+   stats->count++;
+   stats->total += value;
+   stats->buckets[pxmatrix_stats_bucket(value)]++;
+}
+
+void pxmatrix_stats_reset(pxmatrix_stats_t *stats);
+
+// Value below which percent of the samples fall, the middle of the bucket it
+// lands in clamped to min and max. 0 if there are no samples
+uint32_t pxmatrix_stats_percentile(const pxmatrix_stats_t *stats, uint8_t percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
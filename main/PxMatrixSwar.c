@@ -0,0 +1,43 @@
+/****************************************************************
+ * Byte at a time encoder kernel for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#include <string.h>
+#include "PxMatrixSwar.h"
+
+void pxmatrix_swar_transpose8(uint8_t out[8], const uint8_t in[8])
+{
+   uint64_t x = 0;
+   uint64_t t;
+
+   for (uint8_t idx = 0; idx < 8; idx++)
+      x |= (uint64_t)in[idx] << (idx * 8);
+
+   // Swap 1x1, 2x2 then 4x4 blocks across the diagonal
+   t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+   x = x ^ t ^ (t << 7);
+   t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+   x = x ^ t ^ (t << 14);
+   t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+   x = x ^ t ^ (t << 28);
+
+   for (uint8_t idx = 0; idx < 8; idx++)
+      out[idx] = (uint8_t)(x >> (idx * 8));
+}
+
+void pxmatrix_swar_encode8(uint8_t slots[8], const uint8_t *values, size_t step,
+                           const uint8_t *lut, bool reverse)
+{
+   uint8_t masks[8];
+
+   for (uint8_t idx = 0; idx < 8; idx++)
+   {
+      uint8_t pixel = reverse ? 7 - idx : idx;
+      masks[pixel] = lut[values[idx * step]];
+   }
+
+   pxmatrix_swar_transpose8(slots, masks);
+}
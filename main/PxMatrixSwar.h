@@ -0,0 +1,32 @@
+/****************************************************************
+ * Byte at a time encoder kernel for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_SWAR_H__
+#define PXMATRIX_SWAR_H__
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Transposes an 8x8 bit matrix, bit j of out[i] is bit i of in[j]
+void pxmatrix_swar_transpose8(uint8_t out[8], const uint8_t in[8]);
+
+// Encodes one colour channel of 8 horizontally adjacent pixels. values are
+// read step bytes apart and lut maps each value to the mask of planes it
+// lights. slots[p] receives the byte for plane p, with pixel j in bit j, or
+// in bit 7 - j if reverse is set.
+void pxmatrix_swar_encode8(uint8_t slots[8], const uint8_t *values, size_t step,
+                           const uint8_t *lut, bool reverse);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,242 @@
+/****************************************************************
+ * Compile time specialised geometry for PxMatrix
+ *
+ * Written by David Smith
+ * BSD License
+ ***************************************************************/
+
+#ifndef PXMATRIX_T_H__
+#define PXMATRIX_T_H__
+#include "PxMatrix.h"
+#include "PxMatrixSwar.h"
+
+// PxMatrix with the panel geometry fixed at compile time. Offsets and buffer
+// sizes are constant expressions, so drawing needs no divides or pixel map
+// lookups. Anything outside the fixed geometry (rotation, or a different scan
+// or row pattern set at run time), dithering and streaming fall back to PxMatrix.
+template <uint16_t W, uint16_t H, uint8_t RowPattern, scan_patterns Scan>
+class PxMatrixT : public PxMatrix {
+
+public:
+   // Rows in one band of the scan table PxMatrix builds for Scan
+   static constexpr uint16_t ScanRows = (ZIGZAG == Scan) ? (RowPattern * 2) :
+                                        (((ZAGGIZ == Scan) && (RowPattern < 8)) ? 8 : RowPattern);
+
+   static_assert(0 == (W % 8), "Width must be a multiple of 8");
+   static_assert(CUSTOM != Scan, "Scan tables are only known at run time");
+   static_assert(0 == (RowPattern & (RowPattern - 1)), "Row pattern must be a power of 2");
+   static_assert(0 == (H % ScanRows), "Height must be a multiple of the scan table rows");
+
+   static constexpr uint32_t BufferSize = ((uint32_t)W * H * 3) / 8;
+   static constexpr uint16_t PatternColorBytes = (H / RowPattern) * (W / 8);
+   static constexpr uint16_t SendBufferSize = PatternColorBytes * 3;
+   static constexpr uint16_t BandLength = (ScanRows / RowPattern) * 8;
+
+   PxMatrixT(uint8_t LATCH, uint8_t OE, uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E)
+      : PxMatrix(W, H, LATCH, OE, A, B, C, D, E)
+   {
+   }
+
+   using PxMatrix::begin;
+
+   bool begin(color_modes color_mode)
+   {
+      setScanPattern(Scan);
+      if (!PxMatrix::begin(RowPattern, color_mode))
+         return false;
+
+      // begin picks ZIGZAG for 4 scan panels, the template knows better
+      return setScanPattern(Scan);
+   }
+
+   // Block of a row within its band, as build_scan_table lays it out
+   static constexpr uint8_t block(uint16_t y)
+   {
+      return (ZIGZAG == Scan) ? (((y % ScanRows) < RowPattern) ? 1 : 0) : ((y % ScanRows) / RowPattern);
+   }
+
+   // Position of a pixel in the shift chain of its scan row, x is in shift
+   // order (mirrored)
+   static constexpr uint32_t position(uint16_t x, uint16_t y)
+   {
+      return (((((uint32_t)y / ScanRows) * (W / 8)) + (x / 8)) * BandLength) + (block(y) * 8) +
+             (((ZAGGIZ == Scan) && ((y % 8) < 4)) ? 7 - (x % 8) : x % 8);
+   }
+
+   // Red byte offset of a pixel, x is in shift order (mirrored)
+   static constexpr uint32_t offset(uint16_t x, uint16_t y)
+   {
+      return ((y % RowPattern) * SendBufferSize) + SendBufferSize - 1 - (position(x, y) / 8);
+   }
+
+   // Bit of a pixel within its byte, x is in shift order (mirrored)
+   static constexpr uint8_t bit(uint16_t x, uint16_t y)
+   {
+      return position(x, y) % 8;
+   }
+
+   void drawRectRGB565(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *data, uint16_t stride) override
+   {
+      int16_t skip_x, skip_y;
+      uint8_t rgb[W * 3];
+
+      if (!fixed())
+      {
+         PxMatrix::drawRectRGB565(x, y, w, h, data, stride);
+         return;
+      }
+
+      if (!clip_rect(&x, &y, &w, &h, &skip_x, &skip_y))
+         return;
+
+      uint8_t *buf = buffer[_draw_buffer];
+      data += (skip_y * stride) + skip_x;
+      shadow_rect565(x, y, w, h, data, stride);
+
+      for (int16_t yy = 0; yy < h; yy++, data += stride)
+      {
+         for (int16_t xx = 0; xx < w; xx++)
+         {
+            uint16_t color = data[xx];
+            rgb[xx * 3] = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
+            rgb[xx * 3 + 1] = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
+            rgb[xx * 3 + 2] = (((color & 0x1F) * 527) + 23) >> 6;
+         }
+         draw_span(buf, x, y + yy, rgb, w);
+      }
+   }
+
+   void drawRectRGB888(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *data, uint16_t stride) override
+   {
+      int16_t skip_x, skip_y;
+
+      if (!fixed())
+      {
+         PxMatrix::drawRectRGB888(x, y, w, h, data, stride);
+         return;
+      }
+
+      if (!clip_rect(&x, &y, &w, &h, &skip_x, &skip_y))
+         return;
+
+      uint8_t *buf = buffer[_draw_buffer];
+      data += ((skip_y * stride) + skip_x) * 3;
+      shadow_rect888(x, y, w, h, data, stride);
+
+      for (int16_t yy = 0; yy < h; yy++, data += stride * 3)
+         draw_span(buf, x, y + yy, data, w);
+   }
+
+protected:
+   void fillMatrixBuffer(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t buffer_idx) override
+   {
+      if (!fixed())
+      {
+         PxMatrix::fillMatrixBuffer(x, y, r, g, b, buffer_idx);
+         return;
+      }
+
+      if ((x < 0) || (x >= W) || (y < 0) || (y >= H))
+         return;
+
+      shadow_pixel(x, y, r, g, b, buffer_idx);
+      uint16_t shift_x = W - 1 - x;
+      encode_fixed(buffer[buffer_idx], offset(shift_x, y), bit(shift_x, y), r, g, b);
+   }
+
+   // Pixels are worked out from the fixed layout while it holds
+   bool map_needed() override
+   {
+      return !fixed();
+   }
+
+private:
+   // The fixed layout only holds while the run time settings match it
+   bool fixed() const
+   {
+      return !_rotate && !_dither && !_streaming && (NULL == _tile_rotation) && (Scan == _scan_pattern) && (RowPattern == _row_pattern);
+   }
+
+   // Draw count pixels of one row, whole bytes of 8 pixels are encoded at once
+   void draw_span(uint8_t *buf, int16_t x, int16_t y, const uint8_t *rgb, int16_t count)
+   {
+      int16_t xx = 0;
+      while (xx < count)
+      {
+         uint16_t shift_x = W - 1 - (x + xx);
+
+         if (!((x + xx) % 8) && (xx + 8 <= count))
+         {
+            encode_group_fixed(buf, offset(shift_x, y), 7 == bit(shift_x, y), &rgb[xx * 3]);
+            xx += 8;
+         }
+         else
+         {
+            encode_fixed(buf, offset(shift_x, y), bit(shift_x, y), rgb[xx * 3], rgb[xx * 3 + 1], rgb[xx * 3 + 2]);
+            xx++;
+         }
+      }
+   }
+
+   void encode_fixed(uint8_t *buf, uint32_t offset, uint8_t bit_select, uint8_t r, uint8_t g, uint8_t b)
+   {
+      const uint8_t depth = _color_depth;
+      uint8_t mask = 1 << bit_select;
+      uint8_t lit_r = _plane_lut[0][r];
+      uint8_t lit_g = _plane_lut[1][g];
+      uint8_t lit_b = _plane_lut[2][b];
+      uint8_t *dst_r = buf + offset;
+      uint8_t *dst_g = dst_r - PatternColorBytes;
+      uint8_t *dst_b = dst_g - PatternColorBytes;
+
+      // Bit planes line up with the slots
+      if (BCM == _color_mode)
+      {
+         for (uint8_t slot = 0; slot < depth; slot++)
+         {
+            uint32_t plane = slot * BufferSize;
+            dst_r[plane] = (dst_r[plane] & ~mask) | (mask & (uint8_t)(0 - ((lit_r >> slot) & 1)));
+            dst_g[plane] = (dst_g[plane] & ~mask) | (mask & (uint8_t)(0 - ((lit_g >> slot) & 1)));
+            dst_b[plane] = (dst_b[plane] & ~mask) | (mask & (uint8_t)(0 - ((lit_b >> slot) & 1)));
+         }
+         return;
+      }
+
+      // Green and blue slots are turned round the planes, they wrap rather
+      // than taking a divide every slot
+      uint8_t plane_g = _plane_rotate[1];
+      uint8_t plane_b = _plane_rotate[2];
+      for (uint8_t slot = 0; slot < depth; slot++)
+      {
+         uint32_t plane = slot * BufferSize;
+         dst_r[plane] = (dst_r[plane] & ~mask) | (mask & (uint8_t)(0 - ((lit_r >> slot) & 1)));
+         plane = plane_g * BufferSize;
+         dst_g[plane] = (dst_g[plane] & ~mask) | (mask & (uint8_t)(0 - ((lit_g >> slot) & 1)));
+         plane = plane_b * BufferSize;
+         dst_b[plane] = (dst_b[plane] & ~mask) | (mask & (uint8_t)(0 - ((lit_b >> slot) & 1)));
+         plane_g = (plane_g + 1 == depth) ? 0 : plane_g + 1;
+         plane_b = (plane_b + 1 == depth) ? 0 : plane_b + 1;
+      }
+   }
+
+   void encode_group_fixed(uint8_t *buf, uint32_t offset, bool reverse, const uint8_t *rgb)
+   {
+      uint8_t slots[8];
+
+      for (uint8_t channel = 0; channel < 3; channel++)
+      {
+         uint8_t *dst = buf + offset - (channel * PatternColorBytes);
+         uint8_t plane = _plane_rotate[channel];
+
+         pxmatrix_swar_encode8(slots, rgb + channel, 3, _plane_lut[channel], reverse);
+         for (uint8_t slot = 0; slot < _color_depth; slot++)
+         {
+            dst[plane * BufferSize] = slots[slot];
+            if (++plane == _color_depth)
+               plane = 0;
+         }
+      }
+   }
+};
+
+#endif
@@ -48,6 +48,136 @@ static int set_brightness(int argc, char **argv)
    return 0;
 }
 
+static struct {
+   struct arg_int *x;
+   struct arg_int *y;
+   struct arg_end *end;
+} readback_args;
+
+static int read_pixel(int argc, char **argv)
+{
+   int nerrors = arg_parse(argc, argv, (void **) &readback_args);
+   if (nerrors != 0) {
+      arg_print_errors(stderr, readback_args.end, argv[0]);
+      return 1;
+   }
+
+   uint8_t r, g, b;
+   size_t x = (size_t)readback_args.x->ival[0];
+   size_t y = (size_t)readback_args.y->ival[0];
+   if (!display_readPixel(x, y, &r, &g, &b)) {
+      printf("pixel %u,%u is off the display\n", x, y);
+      return 1;
+   }
+
+   printf("pixel %u,%u shows %u %u %u\n", x, y, r, g, b);
+   return 0;
+}
+
+static struct {
+   struct arg_int *depth;
+   struct arg_end *end;
+} depth_args;
+
+static int set_depth(int argc, char **argv)
+{
+   int nerrors = arg_parse(argc, argv, (void **) &depth_args);
+   if (nerrors != 0) {
+      arg_print_errors(stderr, depth_args.end, argv[0]);
+      return 1;
+   }
+
+   if (0 == depth_args.depth->count) {
+      printf("colour depth: %u\n", display_getColorDepth());
+      return 0;
+   }
+
+   int depth = depth_args.depth->ival[0];
+   if (COLOR_DEPTH_MIN > depth || COLOR_DEPTH_MAX < depth) {
+      printf("depth must be %d-%d\n", COLOR_DEPTH_MIN, COLOR_DEPTH_MAX);
+      return 1;
+   }
+
+   display_setColorDepth(depth);
+   return 0;
+}
+
+static struct {
+   struct arg_lit *reset;
+   struct arg_end *end;
+} refresh_args;
+
+static int show_refresh(int argc, char **argv)
+{
+   int nerrors = arg_parse(argc, argv, (void **) &refresh_args);
+   if (nerrors != 0) {
+      arg_print_errors(stderr, refresh_args.end, argv[0]);
+      return 1;
+   }
+
+   refresh_stats_t stats;
+   display_getRefreshStats(&stats);
+
+   printf("periods: %u, overruns: %u, missed ticks: %u, max jitter: %uus\n",
+          stats.periods, stats.overruns, stats.missed, stats.maxJitter);
+   printf("frame latency: %uus, dropped frames: %u\n", stats.frameLatency, stats.droppedFrames);
+   printf("jitter        periods\n");
+   printf("    <1us %12u\n", stats.buckets[0]);
+   for (int bucket = 1; bucket < REFRESH_JITTER_BUCKETS - 1; bucket++) {
+      printf("%4u-%3uus %10u\n", 1 << (bucket - 1), (1 << bucket) - 1, stats.buckets[bucket]);
+   }
+   printf("  >=%3uus %11u\n", 1 << (REFRESH_JITTER_BUCKETS - 2), stats.buckets[REFRESH_JITTER_BUCKETS - 1]);
+
+   if (refresh_args.reset->count) {
+      display_resetRefreshStats();
+   }
+   return 0;
+}
+
+static struct {
+   struct arg_lit *reset;
+   struct arg_end *end;
+} timing_args;
+
+static int show_timing(int argc, char **argv)
+{
+   int nerrors = arg_parse(argc, argv, (void **) &timing_args);
+   if (nerrors != 0) {
+      arg_print_errors(stderr, timing_args.end, argv[0]);
+      return 1;
+   }
+
+   static const char *names[DISPLAY_TIMING_END] = {"row", "latch", "cycle", "swap wait"};
+
+   printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n", "ns", "count", "min", "avg", "max", "p50", "p90", "p99");
+   for (int timing = 0; timing < DISPLAY_TIMING_END; timing++) {
+      display_timing_t stats;
+      display_getTiming((display_timing_e)timing, &stats);
+      printf("%-10s %10u %10u %10u %10u %10u %10u %10u\n", names[timing], stats.count,
+             stats.min, stats.avg, stats.max, stats.p50, stats.p90, stats.p99);
+   }
+
+   refresh_stats_t refresh;
+   display_getRefreshStats(&refresh);
+   printf("missed ticks: %u of %u periods\n", refresh.missed, refresh.periods);
+
+   if (timing_args.reset->count) {
+      display_resetRefreshStats();
+   }
+   return 0;
+}
+
+static int show_memory(int argc, char **argv)
+{
+   display_memory_t memory;
+   display_getMemory(&memory);
+
+   printf("internal: %u bytes DMA, %u bytes other, %u bytes free\n", memory.dma, memory.other, memory.internalFree);
+   printf("psram: %u bytes, %u bytes free\n", memory.psram, memory.psramFree);
+   printf("row time: %uus, colour cycles: %u/s\n", memory.rowTime, memory.cycleRate);
+   return 0;
+}
+
 static int set_display(int argc, char **argv)
 {
    if (argc != 2) {
@@ -526,4 +656,61 @@ void register_display()
    };
    ESP_ERROR_CHECK( esp_console_cmd_register(&set_pixel_cmd) );
 
+   readback_args.x = arg_int1(NULL, NULL, "<x>", "x coordinate");
+   readback_args.y = arg_int1(NULL, NULL, "<y>", "y coordinate");
+   readback_args.end = arg_end(3);
+
+   const esp_console_cmd_t readback_cmd = {
+      .command = "readback",
+      .help = "Show the colour a pixel is lit with, decoded from the data sent to the panel",
+      .hint = NULL,
+      .func = &read_pixel,
+      .argtable = &readback_args
+   };
+   ESP_ERROR_CHECK( esp_console_cmd_register(&readback_cmd) );
+
+   depth_args.depth = arg_int0(NULL, NULL, "<depth>", "colour planes (1-8)");
+   depth_args.end = arg_end(2);
+
+   const esp_console_cmd_t depth_cmd = {
+      .command = "depth",
+      .help = "Set the colour depth, fewer planes refresh faster",
+      .hint = NULL,
+      .func = &set_depth,
+      .argtable = &depth_args
+   };
+   ESP_ERROR_CHECK( esp_console_cmd_register(&depth_cmd) );
+
+   refresh_args.reset = arg_lit0("r", "reset", "clear the statistics once shown");
+   refresh_args.end = arg_end(1);
+
+   const esp_console_cmd_t refresh_cmd = {
+      .command = "refresh",
+      .help = "Show the display refresh period jitter and overruns",
+      .hint = NULL,
+      .func = &show_refresh,
+      .argtable = &refresh_args
+   };
+   ESP_ERROR_CHECK( esp_console_cmd_register(&refresh_cmd) );
+
+   timing_args.reset = arg_lit0("r", "reset", "clear the statistics once shown");
+   timing_args.end = arg_end(1);
+
+   const esp_console_cmd_t timing_cmd = {
+      .command = "refresh-stats",
+      .help = "Show row, latch, colour cycle and buffer swap timings of the refresh",
+      .hint = NULL,
+      .func = &show_timing,
+      .argtable = &timing_args
+   };
+   ESP_ERROR_CHECK( esp_console_cmd_register(&timing_cmd) );
+
+   const esp_console_cmd_t memory_cmd = {
+      .command = "memory",
+      .help = "Show the memory held by the display driver and the refresh it reaches",
+      .hint = NULL,
+      .func = &show_memory,
+   };
+   ESP_ERROR_CHECK( esp_console_cmd_register(&memory_cmd) );
+
 }
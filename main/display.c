@@ -8,6 +8,9 @@
 #include "display.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
+#include "driver/timer.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -26,7 +29,15 @@
 #define P_E CONFIG_DISPLAY_GPIO_E
 #endif
 #define P_OE CONFIG_DISPLAY_GPIO_P_OE
-#define P_POWER 22
+#define P_POWER CONFIG_DISPLAY_GPIO_POWER
+
+#if defined(CONFIG_DISPLAY_SCAN_PATTERN_ZIGZAG)
+#define DISPLAY_SCAN_PATTERN ZIGZAG
+#elif defined(CONFIG_DISPLAY_SCAN_PATTERN_ZAGGIZ)
+#define DISPLAY_SCAN_PATTERN ZAGGIZ
+#else
+#define DISPLAY_SCAN_PATTERN LINE
+#endif
 
 #define MATRIX_WIDTH 32
 #define MATRIX_HEIGHT 16
@@ -56,11 +67,14 @@ static QueueHandle_t xCommandQueue = NULL;
  *   indicates the file to display, sends a pointer to a string. if an existing pointer exists,
  *   it will need to be freed
  * DISPLAY_UPDATE:
- *   in manual mode, indicates that the display needs to be updated
+ *   in manual mode, indicates that the display needs to be updated from the
+ *   interleaved RGB888 frame the drawing commands fill in
  * DISPLAY_FILL
  *   fills the selected area with the given colour
  * DISPLAY_SET_PIXEL
  *   sets a specific pixel to a certain colour
+ * DISPLAY_DEPTH
+ *   sets the number of colour planes (.u), fewer planes give a faster refresh
  */
 
 typedef enum {
@@ -78,7 +92,8 @@ typedef enum {
    DISPLAY_FILL_CIRCLE,
    DISPLAY_SET_PIXEL,
    DISPLAY_SET_FONT,
-   DISPLAY_PRINT
+   DISPLAY_PRINT,
+   DISPLAY_DEPTH
 } display_cmd_e;
 
 typedef enum {
@@ -161,7 +176,8 @@ const uint8_t animation_lengths[]={
 
 const size_t animation_count = sizeof(animation_lengths) / sizeof(uint8_t);
 
-const uint8_t animations[] = {
+// Frames are read as RGB565 words so keep them aligned
+const uint8_t animations[] __attribute__((aligned(4))) = {
 #ifdef ANIM0
    #include "anim0.h"
 #endif //ANIM0
@@ -186,7 +202,11 @@ char *currentFile = NULL;
 int currentFd = -1;
 file_type_e currentFileType = FILE_TYPE_RGB;
 
+// The manual mode frame, blitted whole on DISPLAY_UPDATE. Interleaved
+// RGB888, 3 bytes per pixel row by row, where it used to hold all the red,
+// then all the green, then all the blue
 static uint8_t *nextFrame;
+static uint8_t *fileFrame;
 
 static int16_t currentBrightness = 0;
 static int16_t targetBrightness = 0;
@@ -196,18 +216,101 @@ static int16_t dimRate = 0;
 #define _swap_size_t(a, b) { size_t t = a; a = b; b = t; }
 #endif
 
-static void _display_timer_cb(void *arg)
+//#define DISPLAY_TIMER_PERIOD_US        500
+#define DISPLAY_TIMER_PERIOD_US        1000
+//#define DISPLAY_TIMER_PERIOD_US        2000
+
+// Refresh runs on the core WiFi is not pinned to, woken by a hardware timer
+#ifdef CONFIG_ESP32_WIFI_TASK_PINNED_TO_CORE_1
+#define DISPLAY_REFRESH_CORE 0
+#else
+#define DISPLAY_REFRESH_CORE 1
+#endif
+
+#define DISPLAY_REFRESH_TIMER_GROUP TIMER_GROUP_0
+#define DISPLAY_REFRESH_TIMER TIMER_0
+// 80MHz APB clock / 80 gives 1us timer ticks
+#define DISPLAY_REFRESH_TIMER_DIVIDER 80
+
+static TaskHandle_t refreshTask = NULL;
+static volatile uint32_t presentedFrame = 0;
+static volatile int64_t presentedTime = 0;
+static volatile uint32_t frameLatency = 0;
+static volatile bool refreshRestart = true;
+static refresh_stats_t refreshStats;
+static portMUX_TYPE refreshStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR _display_refresh_isr(void *arg)
 {
-   static uint8_t cnt = 0;
-   pxmatrix *display = (pxmatrix *)arg;
-   //pxmatrix_display(display, 15);
-   //pxmatrix_display(display, 35);
-   //pxmatrix_display(display, 70);
-   //
-   //
+   BaseType_t woken = pdFALSE;
+
+   timer_group_intr_clr_in_isr(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER);
+   timer_group_enable_alarm_in_isr(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER);
+
+   vTaskNotifyGiveFromISR(refreshTask, &woken);
+   if (woken) {
+      portYIELD_FROM_ISR();
+   }
+}
+
+static void _display_record_refresh(int64_t period, int64_t busy, uint32_t missed)
+{
+   uint32_t jitter = (period > DISPLAY_TIMER_PERIOD_US) ? period - DISPLAY_TIMER_PERIOD_US : DISPLAY_TIMER_PERIOD_US - period;
+
+   // Bucket 0 is under 1us, bucket n holds 2^(n-1) up to 2^n us
+   uint8_t bucket = 0;
+   while (jitter >> bucket && bucket < REFRESH_JITTER_BUCKETS - 1) {
+      bucket++;
+   }
+
+   portENTER_CRITICAL(&refreshStatsMux);
+   refreshStats.periods++;
+   refreshStats.buckets[bucket]++;
+   if (jitter > refreshStats.maxJitter) {
+      refreshStats.maxJitter = jitter;
+   }
+   if (busy > DISPLAY_TIMER_PERIOD_US || missed > 0) {
+      refreshStats.overruns++;
+   }
+   refreshStats.missed += missed;
+   portEXIT_CRITICAL(&refreshStatsMux);
+}
+
+static void display_refresh_task(void *pvParameter)
+{
+   pxmatrix *display = (pxmatrix *)pvParameter;
+   int64_t lastRefresh = 0;
+
+   // The interrupt lands on the core that registers it, so set the timer up here
+   timer_config_t config = {
+      .alarm_en = TIMER_ALARM_EN,
+      .counter_en = TIMER_PAUSE,
+      .intr_type = TIMER_INTR_LEVEL,
+      .counter_dir = TIMER_COUNT_UP,
+      .auto_reload = TIMER_AUTORELOAD_EN,
+      .divider = DISPLAY_REFRESH_TIMER_DIVIDER
+   };
+   ESP_ERROR_CHECK( timer_init(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER, &config) );
+   timer_set_counter_value(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER, 0);
+   timer_set_alarm_value(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER, DISPLAY_TIMER_PERIOD_US);
+   timer_enable_intr(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER);
+   timer_isr_register(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER, _display_refresh_isr, NULL, ESP_INTR_FLAG_IRAM, NULL);
+   timer_start(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER);
+
+   while (true) {
+      uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      int64_t start = esp_timer_get_time();
+
+      pxmatrix_displayNs(display, (uint32_t)currentBrightness * 1000 / 30);
 
-   pxmatrix_display(display, currentBrightness / 30);
-   cnt++;
+      // The gap while the display was off is not jitter
+      if (refreshRestart) {
+         refreshRestart = false;
+      } else {
+         _display_record_refresh(start - lastRefresh, esp_timer_get_time() - start, ticks - 1);
+      }
+      lastRefresh = start;
+   }
 }
 
 void draw_anim(pxmatrix *display, size_t animation)
@@ -221,16 +324,7 @@ void draw_anim(pxmatrix *display, size_t animation)
       frame_offset += animation_lengths[idx];
 
    const uint8_t *ptr = animations + (frame_offset + currentFrame) * frameSize;
-   uint16_t val;
-   for (size_t yy = 0; yy < MATRIX_HEIGHT; yy++)
-   {
-      for (size_t xx = 0; xx < MATRIX_WIDTH; xx++)
-      {
-         val = ptr[0] | (ptr[1] << 8);
-         pxmatrix_drawPixelRGB565(display, xx, yy, val);
-         ptr += 2;
-      }
-   }
+   pxmatrix_drawFrameRGB565(display, (const uint16_t *)ptr, MATRIX_WIDTH);
    currentFrame++;
    if (currentFrame >= totalFrames)
       currentFrame = 0;
@@ -238,22 +332,12 @@ void draw_anim(pxmatrix *display, size_t animation)
 
 void draw_colour(pxmatrix *display, uint32_t colour)
 {
-   uint8_t r,g,b;
-   r = (uint8_t)(colour >> 16);
-   g = (uint8_t)(colour >> 8);
-   b = (uint8_t)colour;
-   for (size_t yy = 0; yy < MATRIX_HEIGHT; yy++)
-   {
-      for (size_t xx = 0; xx < MATRIX_WIDTH; xx++)
-      {
-         pxmatrix_drawPixelRGB888(display, xx, yy, r, g, b);
-      }
-   }
+   pxmatrix_fillScreen(display, (uint8_t)(colour >> 16), (uint8_t)(colour >> 8), (uint8_t)colour);
 }
 
-void draw_file(pxmatrix *display, const char *file)
+// True once the next frame of the file has been drawn
+bool draw_file(pxmatrix *display, const char *file)
 {
-   char data[3];
    // Draw The Next Frame Of The File
    if (-1 == currentFd) {
       struct stat sd;
@@ -263,7 +347,7 @@ void draw_file(pxmatrix *display, const char *file)
       currentFrame = 0;
       //totalFrames ==> read the file size
       if (-1 == currentFd)
-         return;  // There Was An Error Loading The File
+         return false;  // There Was An Error Loading The File
 
       // Check The File Type / Extension
       const char *dot = strrchr(file, '.');
@@ -287,29 +371,32 @@ void draw_file(pxmatrix *display, const char *file)
    lseek(currentFd, pos, SEEK_SET);
 
    // Now We Need To Load Pixels
-   for (size_t yy = 0; yy < MATRIX_HEIGHT; yy++)
+   switch(currentFileType) {
+   case FILE_TYPE_RGB:
    {
-      for (size_t xx = 0; xx < MATRIX_WIDTH; xx++)
-      {
-         switch(currentFileType) {
-         case FILE_TYPE_RGB:
-         {
-            if (-1 == read(currentFd, data, sizeof(data))) {
-               printf("error: %d\n", errno);
-            }
-         
-            pxmatrix_drawPixelRGB888(display, xx, yy, data[0], data[1], data[2]);
-            break;
-         }
-         default:
-            break;
-         }
+      // A short read is a truncated last frame or an error, don't show
+      // what is left of the one before
+      ssize_t got = read(currentFd, fileFrame, MATRIX_WIDTH * MATRIX_HEIGHT * 3);
+      if (got != MATRIX_WIDTH * MATRIX_HEIGHT * 3) {
+         if (-1 == got)
+            printf("error: %d\n", errno);
+         else
+            printf("short frame: %d of %d bytes\n", (int)got, MATRIX_WIDTH * MATRIX_HEIGHT * 3);
+         currentFrame = 0;
+         return false;
       }
+
+      pxmatrix_drawFrameRGB888(display, fileFrame, MATRIX_WIDTH);
+      break;
+   }
+   default:
+      return false;
    }
 
    currentFrame++;
    if (currentFrame >= totalFrames)
       currentFrame = 0;
+   return true;
 }
 
 void _drawPixel(ssize_t x, ssize_t y, uint8_t r, uint8_t g, uint8_t b) {
@@ -318,10 +405,10 @@ void _drawPixel(ssize_t x, ssize_t y, uint8_t r, uint8_t g, uint8_t b) {
    if (y < 0 || y >= MATRIX_HEIGHT)
       return;
 
-   size_t offset = y * MATRIX_WIDTH + x;
+   size_t offset = (y * MATRIX_WIDTH + x) * 3;
    nextFrame[offset] = r;
-   nextFrame[MATRIX_HEIGHT*MATRIX_WIDTH + offset] = g;
-   nextFrame[2*MATRIX_HEIGHT*MATRIX_WIDTH + offset] = b;
+   nextFrame[offset + 1] = g;
+   nextFrame[offset + 2] = b;
 }
 
 void _fillRect(display_fill_t *fill)
@@ -331,10 +418,6 @@ void _fillRect(display_fill_t *fill)
       for (size_t xx = fill->x; xx < (fill->x + fill->w); xx++)
       {
          _drawPixel(xx, yy, fill->r, fill->g, fill->b);
-         //size_t offset = yy * MATRIX_WIDTH + xx;
-         //nextFrame[offset] = fill->r;
-         //nextFrame[MATRIX_HEIGHT*MATRIX_WIDTH + offset] = fill->g;
-         //nextFrame[2*MATRIX_HEIGHT*MATRIX_WIDTH + offset] = fill->b;
       }
    }
 }
@@ -347,10 +430,6 @@ void _drawLine(display_line_t *line) {
       for (size_t yy = line->y0; yy <= line->y1; yy++)
       {
          _drawPixel(line->x0, yy, line->r, line->g, line->b);
-         //size_t offset = yy * MATRIX_WIDTH + line->x0;
-         //nextFrame[offset] = line->r;
-         //nextFrame[MATRIX_HEIGHT*MATRIX_WIDTH + offset] = line->g;
-         //nextFrame[2*MATRIX_HEIGHT*MATRIX_WIDTH + offset] = line->b;
       }
    } else if (line->y0 == line->y1) {
       // Horizontal Line
@@ -358,10 +437,6 @@ void _drawLine(display_line_t *line) {
       for (size_t xx = line->x0; xx <= line->x1; xx++)
       {
          _drawPixel(xx, line->y0, line->r, line->g, line->b);
-         //size_t offset = line->y0 * MATRIX_WIDTH + xx;
-         //nextFrame[offset] = line->r;
-         //nextFrame[MATRIX_HEIGHT*MATRIX_WIDTH + offset] = line->g;
-         //nextFrame[2*MATRIX_HEIGHT*MATRIX_WIDTH + offset] = line->b;
       }
    } else {
       // Line With Some Slope
@@ -384,10 +459,6 @@ void _drawLine(display_line_t *line) {
       for (size_t xx = line->x0; xx < line->x1; xx++)
       {
          _drawPixel(xx, y, line->r, line->g, line->b);
-         //size_t offset = y * MATRIX_WIDTH + xx;
-         //nextFrame[offset] = line->r;
-         //nextFrame[MATRIX_HEIGHT*MATRIX_WIDTH + offset] = line->g;
-         //nextFrame[2*MATRIX_HEIGHT*MATRIX_WIDTH + offset] = line->b;
 
          // Next Pixel
          if (D > 0) {
@@ -560,16 +631,83 @@ void _drawText(display_text_t *text) {
    }
 }
 
-//#define DISPLAY_TIMER_PERIOD_US        500
-#define DISPLAY_TIMER_PERIOD_US        1000
-//#define DISPLAY_TIMER_PERIOD_US        2000
+// With double buffering the display has to let go of a buffer before it is
+// drawn, with triple buffering a frame is drawn first and handed over after
+static void _frame_start()
+{
+#ifndef CONFIG_DISPLAY_TRIPLE_BUFFER
+   pxmatrix_swapBuffer(display);
+#endif
+}
+
+static void _frame_done()
+{
+#ifdef CONFIG_DISPLAY_TRIPLE_BUFFER
+   int64_t now = esp_timer_get_time();
+   uint32_t frameId = pxmatrix_present(display);
+   presentedTime = now;
+   presentedFrame = frameId;
+#endif
+}
+
+// How long the last frame took from being handed over to reaching the LEDs
+static void _frame_shown(uint32_t frameId, int64_t shownTime, void *arg)
+{
+   if (frameId == presentedFrame) {
+      frameLatency = shownTime - presentedTime;
+   }
+}
 
 void display_task(void *pvParameter)
 {
-   esp_timer_handle_t timer_handle;
-   display = Create_PxMatrix3(MATRIX_WIDTH, MATRIX_HEIGHT, P_LAT, P_OE, P_A, P_B, P_C);
-   nextFrame = calloc(MATRIX_WIDTH * MATRIX_HEIGHT, 3);  //Every Pixel Has 24 bits of data
-   pxmatrix_begin(display, CONFIG_DISPLAY_SCAN);
+   display = Create_PxMatrixFixed(MATRIX_WIDTH, MATRIX_HEIGHT, CONFIG_DISPLAY_SCAN, DISPLAY_SCAN_PATTERN, P_LAT, P_OE, P_A, P_B, P_C, P_D, P_E);
+#ifdef CONFIG_DISPLAY_PSRAM_THRESHOLD
+   pxmatrix_setPsramThreshold(display, CONFIG_DISPLAY_PSRAM_THRESHOLD);
+#endif
+   nextFrame = pxmatrix_allocFrame(display, MATRIX_WIDTH * MATRIX_HEIGHT * 3);  //Every Pixel Has 24 bits of data
+   fileFrame = pxmatrix_allocFrame(display, MATRIX_WIDTH * MATRIX_HEIGHT * 3);
+#if defined(CONFIG_DISPLAY_OUTPUT_PIPELINED)
+   pxmatrix_setOutputMode(display, SPI_PIPELINED);
+#elif defined(CONFIG_DISPLAY_OUTPUT_DMA_CHAIN)
+   pxmatrix_setOutputMode(display, SPI_DMA_CHAIN);
+#elif defined(CONFIG_DISPLAY_OUTPUT_I2S_PARALLEL)
+   pxmatrix_setParallelPins(display, CONFIG_DISPLAY_GPIO_R0, CONFIG_DISPLAY_GPIO_G0, CONFIG_DISPLAY_GPIO_B0,
+                            CONFIG_DISPLAY_GPIO_R1, CONFIG_DISPLAY_GPIO_G1, CONFIG_DISPLAY_GPIO_B1,
+                            CONFIG_DISPLAY_GPIO_CLK);
+   pxmatrix_setOutputMode(display, I2S_PARALLEL);
+#endif
+   pxmatrix_setPowerPin(display, P_POWER);
+#ifdef CONFIG_DISPLAY_SPI_QUAD
+   pxmatrix_setQuadSpiPins(display, CONFIG_DISPLAY_GPIO_QSPI_WP, CONFIG_DISPLAY_GPIO_QSPI_HD);
+   pxmatrix_setQuadSpi(display, true);
+#endif
+#ifdef CONFIG_DISPLAY_RMT_OE
+   pxmatrix_setRmtOe(display, true);
+#endif
+#ifdef CONFIG_DISPLAY_TRIPLE_BUFFER
+   pxmatrix_setTripleBuffer(display, true);
+   pxmatrix_setPresentCallback(display, _frame_shown, NULL);
+#endif
+#ifdef CONFIG_DISPLAY_STREAMING
+   pxmatrix_setStreaming(display, true);
+#endif
+#ifdef CONFIG_DISPLAY_DITHER
+   pxmatrix_setDither(display, true);
+#endif
+#ifdef CONFIG_DISPLAY_SHADOW
+   pxmatrix_setShadow(display, true);
+#endif
+#ifdef CONFIG_DISPLAY_COLOR_BCM
+   bool begun = pxmatrix_beginColorMode(display, CONFIG_DISPLAY_SCAN, BCM);
+#else
+   bool begun = pxmatrix_begin(display, CONFIG_DISPLAY_SCAN);
+#endif
+   if (!begun) {
+      ESP_LOGE(TAG, "not enough memory for the display buffers\n");
+      return;
+   }
+   // begin picks ZIGZAG for 4 scan panels, put the configured pattern back
+   pxmatrix_setScanPattern(display, DISPLAY_SCAN_PATTERN);
    pxmatrix_clearDisplay(display);
    pxmatrix_setFastUpdate(display, false);
    currentRate = DEFAULT_RATE;
@@ -583,26 +721,19 @@ void display_task(void *pvParameter)
    // Set Up The Command Queue
    xCommandQueue = xQueueCreate( 10, sizeof( display_cmd_t ) );
 
-   // GPIO22
+   // Panel power
    gpio_pad_select_gpio(P_POWER);
    gpio_set_direction(P_POWER, GPIO_MODE_INPUT_OUTPUT);
    gpio_set_level(P_POWER, 1);
 
    //xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT, false, true, portMAX_DELAY);
 
-   // Init the Timer
-   esp_timer_create_args_t timer_conf = {
-        .callback = _display_timer_cb,
-        .arg = display,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "display_timer"
-    };
-    esp_err_t err = esp_timer_create(&timer_conf, &timer_handle);
-    if (err) {
-        ESP_LOGE(TAG, "error starting esp_timer: %d\n", err);
-        return;
-    }
-    esp_timer_start_periodic(timer_handle, DISPLAY_TIMER_PERIOD_US);
+   // Start the refresh, it outranks everything else so WiFi load can't make the display flicker
+   if (pdPASS != xTaskCreatePinnedToCore(display_refresh_task, "display_refresh", 3072, display,
+                                         configMAX_PRIORITIES - 1, &refreshTask, DISPLAY_REFRESH_CORE)) {
+      ESP_LOGE(TAG, "error starting the refresh task\n");
+      return;
+   }
 
    int taskCore = xPortGetCoreID();
    printf("display task running on %d\n", taskCore);
@@ -631,13 +762,14 @@ void display_task(void *pvParameter)
                break;
             }
             case DISPLAY_POWER:
-               // GPIO22
+               // Panel power
                if (display_getPower() != cmd.b) {
                   gpio_set_level(P_POWER, cmd.b);
                   if (cmd.b) {
-                     esp_timer_start_periodic(timer_handle, DISPLAY_TIMER_PERIOD_US);
+                     refreshRestart = true;
+                     timer_start(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER);
                   } else {
-                     esp_timer_stop(timer_handle);
+                     timer_pause(DISPLAY_REFRESH_TIMER_GROUP, DISPLAY_REFRESH_TIMER);
                   }
                }
                break;
@@ -672,18 +804,19 @@ void display_task(void *pvParameter)
                break;
             case DISPLAY_UPDATE:
                if (DISPLAY_MODE_MANUAL == currentMode) {
-                  uint8_t r,g,b;
-                  for (size_t yy = 0; yy < MATRIX_HEIGHT; yy++)
-                  {
-                     for (size_t xx = 0; xx < MATRIX_WIDTH; xx++)
-                     {
-                        size_t offset = yy * MATRIX_WIDTH + xx;
-                        r = nextFrame[offset];
-                        g = nextFrame[MATRIX_HEIGHT*MATRIX_WIDTH + offset];
-                        b = nextFrame[2*MATRIX_HEIGHT*MATRIX_WIDTH + offset];
-                        pxmatrix_drawPixelRGB888(display, xx, yy, r, g, b);
-                     }
-                  }
+                  pxmatrix_drawFrameRGB888(display, nextFrame, MATRIX_WIDTH);
+                  _frame_done();
+               }
+               break;
+            case DISPLAY_DEPTH:
+               if (!pxmatrix_setColorDepth(display, (uint8_t)cmd.u)) {
+                  printf("colour depth %u not supported\n", cmd.u);
+                  break;
+               }
+               // The other modes redraw on their next frame
+               if (DISPLAY_MODE_MANUAL == currentMode) {
+                  pxmatrix_drawFrameRGB888(display, nextFrame, MATRIX_WIDTH);
+                  _frame_done();
                }
                break;
             case DISPLAY_FILL_RECT:
@@ -752,17 +885,21 @@ void display_task(void *pvParameter)
 
       switch (currentMode) {
          case DISPLAY_MODE_ANIMATION:
-            pxmatrix_swapBuffer(display);
+            _frame_start();
             draw_anim(display, currentAnimation);
+            _frame_done();
             break;
          case DISPLAY_MODE_COLOUR:
-            pxmatrix_swapBuffer(display);
+            _frame_start();
             draw_colour(display, currentColour);
+            _frame_done();
             break;
          case DISPLAY_MODE_FILE:
             // Somehow Draw The Frames
-            pxmatrix_swapBuffer(display);
-            draw_file(display, currentFile);
+            // Nothing new was drawn after a read error, don't present it
+            _frame_start();
+            if (draw_file(display, currentFile))
+               _frame_done();
             break;
          case DISPLAY_MODE_MANUAL:
             // Flip Is Done By A Command
@@ -897,6 +1034,80 @@ void display_setFile(const char *file) {
 
 }
 
+void display_setColorDepth(uint8_t depth) {
+   if (NULL != xCommandQueue) {
+      display_cmd_t cmd = {
+         .command = DISPLAY_DEPTH,
+         .u = depth
+      };
+      xQueueSend( xCommandQueue, &cmd, (TickType_t) 0 );
+   }
+}
+
+uint8_t display_getColorDepth() {
+   if (NULL == display)
+      return 0;
+   return pxmatrix_getColorDepth(display);
+}
+
+void display_getRefreshStats(refresh_stats_t *stats) {
+   portENTER_CRITICAL(&refreshStatsMux);
+   *stats = refreshStats;
+   portEXIT_CRITICAL(&refreshStatsMux);
+
+   stats->frameLatency = frameLatency;
+   stats->droppedFrames = (NULL != display) ? pxmatrix_getDroppedFrames(display) : 0;
+}
+
+void display_resetRefreshStats() {
+   portENTER_CRITICAL(&refreshStatsMux);
+   memset(&refreshStats, 0, sizeof(refreshStats));
+   portEXIT_CRITICAL(&refreshStatsMux);
+   refreshRestart = true;
+
+   if (NULL != display)
+      pxmatrix_resetTimings(display);
+}
+
+bool display_getTiming(display_timing_e timing, display_timing_t *stats) {
+   memset(stats, 0, sizeof(display_timing_t));
+   if (NULL == display)
+      return false;
+
+   struct pxmatrix_timing summary;
+   if (!pxmatrix_getTiming(display, (enum pxmatrix_timings)timing, &summary))
+      return false;
+
+   stats->count = summary.count;
+   stats->min = summary.min;
+   stats->avg = summary.avg;
+   stats->max = summary.max;
+   stats->p50 = summary.p50;
+   stats->p90 = summary.p90;
+   stats->p99 = summary.p99;
+   return true;
+}
+
+void display_getMemory(display_memory_t *memory) {
+   memset(memory, 0, sizeof(display_memory_t));
+   if (NULL == display)
+      return;
+
+   struct pxmatrix_memory usage;
+   pxmatrix_getMemoryUsage(display, &usage);
+   memory->dma = usage.dma;
+   memory->other = usage.other;
+   memory->psram = usage.psram;
+   memory->internalFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+   memory->psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+   // A colour cycle sends every row once per plane
+   memory->rowTime = pxmatrix_getRowTime(display);
+   uint32_t cycleTime = memory->rowTime * CONFIG_DISPLAY_SCAN * pxmatrix_getColorDepth(display);
+   if (0 != cycleTime)
+      memory->cycleRate = 1000000 / cycleTime;
+}
+
 void display_update() {
    if (NULL != xCommandQueue) {
       display_cmd_t cmd = {
@@ -1020,6 +1231,18 @@ void display_setPixel(size_t x, size_t y, uint8_t r, uint8_t g, uint8_t b) {
    xQueueSend( xCommandQueue, &cmd, (TickType_t) 0 );
 }
 
+bool display_readPixel(size_t x, size_t y, uint8_t *r, uint8_t *g, uint8_t *b) {
+   if (NULL == display)
+      return false;
+   return pxmatrix_readPixel(display, x, y, r, g, b);
+}
+
+uint16_t display_getPixel(size_t x, size_t y) {
+   if (NULL == display)
+      return 0;
+   return pxmatrix_getPixel(display, x, y);
+}
+
 void display_setFont(GFXfont *font) {
    if (NULL == xCommandQueue)
       return;
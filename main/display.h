@@ -44,6 +44,64 @@ size_t display_getAnimation();
 
 void display_setFile(const char *file);
 
+#define COLOR_DEPTH_MIN 1
+#define COLOR_DEPTH_MAX 8
+
+void display_setColorDepth(uint8_t depth);
+uint8_t display_getColorDepth();
+
+// Refresh period jitter, bucket 0 counts periods under 1us off, bucket n
+// those from 2^(n-1) up to 2^n us off. An overrun is a refresh that ran
+// past the next timer tick, missed counts the ticks lost to them
+#define REFRESH_JITTER_BUCKETS 10
+
+typedef struct {
+   uint32_t periods;
+   uint32_t overruns;
+   uint32_t missed;
+   uint32_t maxJitter;
+   uint32_t buckets[REFRESH_JITTER_BUCKETS];
+   uint32_t frameLatency;     // us from handing the last frame over to showing it
+   uint32_t droppedFrames;    // frames replaced before they were shown
+} refresh_stats_t;
+
+void display_getRefreshStats(refresh_stats_t *stats);
+void display_resetRefreshStats();
+
+// Timings measured by the driver on every refresh, see pxmatrix_timings
+typedef enum {
+   DISPLAY_TIMING_ROW,        // sending and latching one row
+   DISPLAY_TIMING_LATCH,      // latch and OE
+   DISPLAY_TIMING_CYCLE,      // from one colour cycle to the next
+   DISPLAY_TIMING_SWAP_WAIT,  // waiting to swap buffers
+   DISPLAY_TIMING_END	/* Needs To Be The Last One */
+} display_timing_e;
+
+typedef struct {
+   uint32_t count;
+   uint32_t min;              // ns
+   uint32_t avg;
+   uint32_t max;
+   uint32_t p50;
+   uint32_t p90;
+   uint32_t p99;
+} display_timing_t;
+
+// False if the timing has no samples yet, display_resetRefreshStats clears them
+bool display_getTiming(display_timing_e timing, display_timing_t *stats);
+
+typedef struct {
+   uint32_t dma;              // bytes of internal DMA capable memory held by the driver
+   uint32_t other;            // bytes of other internal memory held by the driver
+   uint32_t psram;            // bytes of PSRAM held by the driver
+   uint32_t internalFree;     // bytes of internal memory left
+   uint32_t psramFree;        // bytes of PSRAM left
+   uint32_t rowTime;          // us to send and show one row
+   uint32_t cycleRate;        // colour cycles per second at that row time
+} display_memory_t;
+
+void display_getMemory(display_memory_t *memory);
+
 // Manual Mode Commands
 void display_update();
 
@@ -58,6 +116,12 @@ void display_fillCircle(size_t x0, size_t y0, size_t radius, uint8_t r, uint8_t
 
 void display_setPixel(size_t x, size_t y, uint8_t r, uint8_t g, uint8_t b);
 
+// The colour the LEDs show for a pixel, decoded from what is sent to the panel
+bool display_readPixel(size_t x, size_t y, uint8_t *r, uint8_t *g, uint8_t *b);
+
+// The RGB565 colour last drawn to a pixel, needs DISPLAY_SHADOW or streaming
+uint16_t display_getPixel(size_t x, size_t y);
+
 void display_setFont(GFXfont *font);
 
 void display_print(char *text);
@@ -962,6 +962,7 @@ static void websocketBcast(void *arg) {
 static void myApiRecv(Websock *ws, char *data, int len, int flags) {
    int status = 0;
    int sequence = -1;
+   cJSON *stats = NULL;
    //cgiWebsocketSend(&httpdInstance.httpdInstance,
    //                 ws, buff, strlen(buff), WEBSOCK_FLAG_NONE);
 
@@ -1165,6 +1166,42 @@ static void myApiRecv(Websock *ws, char *data, int len, int flags) {
 
       display_print(textJson->valuestring);
       display_update();
+   } else if (strncmp(item->valuestring, "depth", 6) == 0) {
+      const cJSON *depthJson = cJSON_GetObjectItemCaseSensitive(cmd, "depth");
+      if (!cJSON_IsNumber(depthJson) ||
+          COLOR_DEPTH_MIN > depthJson->valueint ||
+          COLOR_DEPTH_MAX < depthJson->valueint)
+      {
+         status = -17;
+         goto finish;
+      }
+      display_setColorDepth(depthJson->valueint);
+   } else if (strncmp(item->valuestring, "stats", 6) == 0) {
+      // Refresh timings in ns, cleared afterwards if reset is true
+      static const char *names[DISPLAY_TIMING_END] = {"row", "latch", "cycle", "swapWait"};
+      stats = cJSON_CreateObject();
+      for (int timing = 0; timing < DISPLAY_TIMING_END; timing++) {
+         display_timing_t timingStats;
+         display_getTiming((display_timing_e)timing, &timingStats);
+
+         cJSON *timingJson = cJSON_AddObjectToObject(stats, names[timing]);
+         cJSON_AddNumberToObject(timingJson, "count", timingStats.count);
+         cJSON_AddNumberToObject(timingJson, "min", timingStats.min);
+         cJSON_AddNumberToObject(timingJson, "avg", timingStats.avg);
+         cJSON_AddNumberToObject(timingJson, "max", timingStats.max);
+         cJSON_AddNumberToObject(timingJson, "p50", timingStats.p50);
+         cJSON_AddNumberToObject(timingJson, "p90", timingStats.p90);
+         cJSON_AddNumberToObject(timingJson, "p99", timingStats.p99);
+      }
+
+      refresh_stats_t refresh;
+      display_getRefreshStats(&refresh);
+      cJSON_AddNumberToObject(stats, "periods", refresh.periods);
+      cJSON_AddNumberToObject(stats, "missed", refresh.missed);
+
+      const cJSON *resetJson = cJSON_GetObjectItemCaseSensitive(cmd, "reset");
+      if (cJSON_IsTrue(resetJson))
+         display_resetRefreshStats();
    }
 
 finish:
@@ -1175,6 +1212,9 @@ finish:
    cJSON *result = cJSON_CreateObject();
    cJSON_AddNumberToObject(result, "status", status);
    cJSON_AddNumberToObject(result, "sequence", sequence);
+   if (NULL != stats) {
+      cJSON_AddItemToObject(result, "refresh", stats);
+   }
    char *sResult = cJSON_PrintUnformatted(result);
    cJSON_Delete(result);
    cgiWebsocketSend(&httpdInstance.httpdInstance,